@@ -0,0 +1,786 @@
+/**
+  *@file ldf2root_bench.cpp
+  *@brief Benchmark suite covering every stage of the ldf2root pipeline
+  *@details
+  * Microbenchmarks time each stage in isolation on synthetic data produced with the ldfgen library:
+  * parsing an LDF file, unpacking the raw hit words per module type and hit layout, sorting,
+  * event building with every window type, filling the lean event with and without reuse, and
+  * filling/reading the output tree in the default and lean layouts. Macrobenchmarks generate LDF
+  * files of the requested sizes and time the ldf2root executable converting them end to end.
+  * Every benchmark runs --repeat times, the JSON report holds the median, min, max and mean
+  * wall time of each one together with the derived throughput.
+  *@param json_file Path of the JSON report (optional)
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <RVersion.h>
+
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include "DataParser.h"
+#include "DataWriter.h"
+#include "DDASFlatEvent.h"
+#include "DDASRootEvent.h"
+#include "DDASRootHit.h"
+#include "EventBuilder.h"
+#include "InputParser.h"
+#include "Pipeline.h"
+#include "LDFGenerator.h"
+
+#ifndef LDF2ROOT_EXECUTABLE
+#define LDF2ROOT_EXECUTABLE "ldf2root"
+#endif
+#ifndef LDF2ROOT_VERSION
+#define LDF2ROOT_VERSION "unknown"
+#endif
+
+namespace bench {
+
+struct BenchOptions {
+  std::string json_file;
+  std::string filter; // regular expression on the benchmark name
+  std::filesystem::path scratch = std::filesystem::temp_directory_path() / "ldf2root_bench";
+  std::string ldf2root = LDF2ROOT_EXECUTABLE;
+  unsigned int repeat = 5;
+  uint64_t hits = 1000000; // hits per microbenchmark
+  double parse_mb = 256.0; // size of the files for the parse benchmarks
+  std::vector<double> macro_sizes = {100.0}; // MB
+  bool micro = true;
+  bool macro = true;
+  bool list = false;
+  bool keep = false; // keep the generated files
+  uint64_t seed = 1;
+};
+
+/// One timed run of a benchmark
+struct Sample {
+  double seconds = 0.0;
+  uint64_t items = 0;
+  uint64_t bytes = 0;
+};
+
+struct Result {
+  std::string name;
+  std::string category;
+  std::string unit; // what an item is
+  std::vector<Sample> samples;
+
+  double Median() const {
+    std::vector<double> t;
+    for (const auto& s : samples) {
+      t.push_back(s.seconds);
+    }
+    std::sort(t.begin(), t.end());
+    const size_t n = t.size();
+    return n == 0 ? 0.0 : (n % 2 ? t[n/2] : 0.5*(t[n/2 - 1] + t[n/2]));
+  }
+  double Min() const {
+    double m = samples.empty() ? 0.0 : samples.front().seconds;
+    for (const auto& s : samples) {
+      m = std::min(m, s.seconds);
+    }
+    return m;
+  }
+  double Max() const {
+    double m = 0.0;
+    for (const auto& s : samples) {
+      m = std::max(m, s.seconds);
+    }
+    return m;
+  }
+  double Mean() const {
+    double sum = 0.0;
+    for (const auto& s : samples) {
+      sum += s.seconds;
+    }
+    return samples.empty() ? 0.0 : sum/samples.size();
+  }
+  uint64_t Items() const { return samples.empty() ? 0 : samples.back().items; }
+  uint64_t Bytes() const { return samples.empty() ? 0 : samples.back().bytes; }
+};
+
+using BenchFunction = std::function<Sample()>;
+
+struct Benchmark {
+  std::string name;
+  std::string category;
+  std::string unit;
+  BenchFunction run;
+  std::function<void()> setup; // untimed, once before the runs
+  std::function<void()> teardown; // untimed, once after the runs
+};
+
+/// Hit layouts of the unpack benchmarks
+struct Layout {
+  std::string name;
+  unsigned int trace_length;
+  bool energy_sums;
+  bool qdc_sums;
+  bool ext_ts;
+};
+
+const std::vector<Layout> LAYOUTS = {
+  {"plain", 0, false, false, false},
+  {"trace250", 250, false, false, false},
+  {"esums", 0, true, false, false},
+  {"qdc", 0, false, true, false},
+  {"extts", 0, false, false, true},
+  {"all", 250, true, true, true}
+};
+
+const unsigned int HARDWARE_REVISION = 0xF;
+
+double Seconds(std::chrono::steady_clock::duration d) {
+  return std::chrono::duration<double>(d).count();
+}
+
+ldfgen::ModuleInfo MakeModule(unsigned int msps, unsigned int slot) {
+  return {0, slot, msps, (msps == 250 ? 16u : 14u)};
+}
+
+/// Raw words the way the translator hands them to the unpacker, each hit behind the two DDAS words
+void EncodeRawHits(const ldfgen::GenOptions& gen, const std::vector<ldfgen::ModuleInfo>& modules, const std::vector<ldfgen::GenHit>& hits, uint64_t seed, RawDataVector& out) {
+  std::mt19937_64 rng(seed);
+  std::vector<uint32_t> words;
+  out.clear();
+  for (const auto& hit : hits) {
+    const auto& mod = modules[hit.module];
+    words.clear();
+    ldfgen::EncodeHit(gen, mod, hit, rng, words);
+    out.push_back((words.size() + 2)*2);
+    out.push_back((mod.msps & 0xFFFF) | ((mod.resolution << 16) & 0x00FF0000) | ((HARDWARE_REVISION << 24) & 0xFF000000));
+    out.insert(out.end(), words.begin(), words.end());
+  }
+}
+
+/// Time ordered hits spread over the modules at 1e5 hits/s
+std::vector<ldfgen::GenHit> MakeHits(uint64_t n, unsigned int nmodules, uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  std::exponential_distribution<double> gap(1.0e-4); // ns
+  std::vector<ldfgen::GenHit> hits(n);
+  double t = 1.0e9;
+  for (auto& hit : hits) {
+    t += gap(rng);
+    hit = {t, static_cast<unsigned int>(rng() % nmodules), static_cast<unsigned int>(rng() % 16)};
+  }
+  return hits;
+}
+
+/// Hits in the order a spill delivers them, every module block in time order but the blocks one after the other
+void SpillOrder(std::vector<ldfgen::GenHit>& hits, size_t hitsPerSpill) {
+  for (size_t start = 0; start < hits.size(); start += hitsPerSpill) {
+    auto end = hits.begin() + std::min(hits.size(), start + hitsPerSpill);
+    std::stable_sort(hits.begin() + start, end, [](const ldfgen::GenHit& a, const ldfgen::GenHit& b) { return a.module < b.module; });
+  }
+}
+
+ldf2root::CmdOptions MakeCmdOptions(const std::vector<ldfgen::ModuleInfo>& modules) {
+  ldf2root::CmdOptions opts;
+  for (const auto& mod : modules) {
+    opts.mod_params_map[{mod.crate, mod.slot}] = {mod.msps, mod.resolution, HARDWARE_REVISION};
+  }
+  opts.tree_name = "ddas";
+  return opts;
+}
+
+/// Crate configuration ldfgen writes next to an LDF file
+std::string ConfigPath(const std::filesystem::path& ldf) {
+  ldfgen::GenOptions gen;
+  gen.output_file = ldf.string();
+  return ldfgen::ConfigFilePath(gen);
+}
+
+uint64_t FileSize(const std::filesystem::path& p) {
+  std::error_code ec;
+  const auto size = std::filesystem::file_size(p, ec);
+  return ec ? 0 : size;
+}
+
+class Suite {
+  public:
+    Suite(const BenchOptions& opts, const std::string& logname) : Opts(opts), LogName(logname), Filter(opts.filter.empty() ? ".*" : opts.filter) {}
+
+    void Add(Benchmark b) {
+      if (std::regex_search(b.name, Filter)) {
+        Benchmarks.push_back(std::move(b));
+      }
+    }
+
+    void Run() {
+      for (auto& b : Benchmarks) {
+        if (Opts.list) {
+          std::cout << b.name << std::endl;
+          continue;
+        }
+        Result r{b.name, b.category, b.unit, {}};
+        try {
+          if (b.setup) {
+            b.setup();
+          }
+          for (unsigned int ii = 0; ii < Opts.repeat; ++ii) {
+            r.samples.push_back(b.run());
+          }
+          if (b.teardown) {
+            b.teardown();
+          }
+        } catch (std::runtime_error const& e) {
+          std::cerr << b.name << " failed: " << e.what() << std::endl;
+          Failed = true;
+          continue;
+        }
+        Print(r);
+        Results.push_back(std::move(r));
+      }
+    }
+
+    void WriteJSON(const std::string& filename) const {
+      std::ofstream ofs(filename);
+      if (!ofs) {
+        throw std::runtime_error("Failed to create " + filename);
+      }
+      char host[256] = {0};
+      gethostname(host, sizeof(host) - 1);
+      const std::time_t now = std::time(nullptr);
+      char date[64];
+      std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+      ofs << std::setprecision(9);
+      ofs << "{\n";
+      ofs << "  \"context\": {\n";
+      ofs << "    \"version\": \"" << LDF2ROOT_VERSION << "\",\n";
+      ofs << "    \"root_version\": \"" << ROOT_RELEASE << "\",\n";
+      ofs << "    \"compiler\": \"" << __VERSION__ << "\",\n";
+      ofs << "    \"host\": \"" << host << "\",\n";
+      ofs << "    \"date\": \"" << date << "\",\n";
+      ofs << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+      ofs << "    \"repeat\": " << Opts.repeat << ",\n";
+      ofs << "    \"seed\": " << Opts.seed << "\n";
+      ofs << "  },\n";
+      ofs << "  \"benchmarks\": [";
+      for (size_t ii = 0; ii < Results.size(); ++ii) {
+        const auto& r = Results[ii];
+        const double t = r.Median();
+        ofs << (ii == 0 ? "\n" : ",\n");
+        ofs << "    {\"name\": \"" << r.name << "\", \"category\": \"" << r.category << "\", \"unit\": \"" << r.unit << "\""
+            << ", \"iterations\": " << r.samples.size() << ", \"items\": " << r.Items() << ", \"bytes\": " << r.Bytes()
+            << ", \"seconds\": " << t << ", \"min_seconds\": " << r.Min() << ", \"max_seconds\": " << r.Max() << ", \"mean_seconds\": " << r.Mean()
+            << ", \"items_per_second\": " << (t > 0 ? r.Items()/t : 0.0) << ", \"bytes_per_second\": " << (t > 0 ? r.Bytes()/t : 0.0)
+            << ", \"ns_per_item\": " << (r.Items() > 0 ? t*1.0e9/r.Items() : 0.0) << "}";
+      }
+      ofs << "\n  ]\n}\n";
+    }
+
+    bool HasFailures() const { return Failed; }
+
+  private:
+    void Print(const Result& r) const {
+      const double t = r.Median();
+      std::cout << std::left << std::setw(36) << r.name << std::right << std::fixed
+                << std::setw(12) << std::setprecision(4) << t << " s"
+                << std::setw(14) << std::setprecision(3) << (t > 0 ? r.Items()/t/1.0e6 : 0.0) << " M" << r.unit << "/s"
+                << std::setw(12) << std::setprecision(1) << (t > 0 ? r.Bytes()/t/(1024.0*1024.0) : 0.0) << " MB/s"
+                << std::setw(10) << std::setprecision(1) << (r.Items() > 0 ? t*1.0e9/r.Items() : 0.0) << " ns/" << r.unit
+                << std::defaultfloat << std::endl;
+    }
+
+    const BenchOptions& Opts;
+    std::string LogName;
+    std::regex Filter;
+    std::vector<Benchmark> Benchmarks;
+    std::vector<Result> Results;
+    bool Failed = false;
+};
+
+/// DataParser::Parse over a generated file, ReadNextBuffer, ParseDataBuffer and TransferRawDataWords together
+void AddParseBenchmarks(Suite& suite, const BenchOptions& opts, const std::string& logname) {
+  for (const auto& layout : {LAYOUTS[0], LAYOUTS[1]}) {
+    auto file = std::make_shared<std::filesystem::path>(opts.scratch / ("parse_" + layout.name + ".ldf"));
+    auto cmdopts = std::make_shared<ldf2root::CmdOptions>();
+    Benchmark b;
+    b.name = "parse/" + layout.name;
+    b.category = "micro";
+    b.unit = "word";
+    b.setup = [=, &opts]() {
+      ldfgen::GenOptions gen;
+      gen.output_file = file->string();
+      gen.max_size_mb = opts.parse_mb;
+      gen.modules = 6;
+      gen.msps = {100, 250, 500};
+      gen.trace_length = layout.trace_length;
+      gen.seed = opts.seed;
+      ldfgen::GenerateFile(gen);
+      *cmdopts = MakeCmdOptions(ldfgen::MakeModules(gen));
+      cmdopts->input_files = {file->string()};
+    };
+    b.run = [=]() {
+      RawDataVector raw;
+      DataParser parser(DataParser::DataFileType::LDF_PIXIE, logname, *cmdopts);
+      std::vector<std::string> files = cmdopts->input_files;
+      parser.SetInputFiles(files);
+      const auto start = std::chrono::steady_clock::now();
+      Translator::TRANSLATORSTATE state;
+      do {
+        state = parser.Parse(&raw);
+      } while (state == Translator::TRANSLATORSTATE::PARSING);
+      return Sample{Seconds(std::chrono::steady_clock::now() - start), raw.size(), parser.GetBytesRead()};
+    };
+    b.teardown = [=, &opts]() {
+      if (!opts.keep) {
+        std::filesystem::remove(*file);
+        std::filesystem::remove(ConfigPath(*file));
+      }
+    };
+    suite.Add(std::move(b));
+  }
+}
+
+/// ldf2root::UnpackEvents for every module type and hit layout
+void AddUnpackBenchmarks(Suite& suite, const BenchOptions& opts) {
+  for (unsigned int msps : {100u, 250u, 500u}) {
+    for (const auto& layout : LAYOUTS) {
+      auto raw = std::make_shared<RawDataVector>();
+      auto nhits = std::make_shared<uint64_t>(0);
+      Benchmark b;
+      b.name = "unpack/" + std::to_string(msps) + "/" + layout.name;
+      b.category = "micro";
+      b.unit = "hit";
+      b.setup = [=, &opts]() {
+        ldfgen::GenOptions gen;
+        gen.trace_length = layout.trace_length;
+        gen.energy_sums = layout.energy_sums;
+        gen.qdc_sums = layout.qdc_sums;
+        gen.ext_ts = layout.ext_ts;
+        // Keep the traces from taking all the memory
+        *nhits = layout.trace_length > 0 ? std::max<uint64_t>(opts.hits/10, 1) : opts.hits;
+        const std::vector<ldfgen::ModuleInfo> modules = {MakeModule(msps, 2)};
+        EncodeRawHits(gen, modules, MakeHits(*nhits, 1, opts.seed), opts.seed, *raw);
+      };
+      b.run = [=]() {
+        RawDataVector copy(*raw);
+        UnpackedHitVector hits;
+        hits.reserve(*nhits);
+        const auto t = ldf2root::UnpackEvents(&copy, &hits);
+        return Sample{t.count(), hits.size(), raw->size()*sizeof(uint32_t)};
+      };
+      b.teardown = [=]() {
+        RawDataVector().swap(*raw);
+      };
+      suite.Add(std::move(b));
+    }
+  }
+}
+
+/// Hits as the unpacker leaves them, in spill order
+struct HitSource {
+  ldfgen::GenOptions Gen;
+  std::vector<ldfgen::ModuleInfo> Modules;
+  RawDataVector Raw;
+  uint64_t NumHits = 0;
+
+  void Generate(uint64_t n, uint64_t seed, bool shuffle) {
+    Modules.clear();
+    for (unsigned int ii = 0; ii < 6; ++ii) {
+      Modules.push_back(MakeModule((ii % 3 == 0) ? 100 : (ii % 3 == 1) ? 250 : 500, ii + 2));
+    }
+    auto hits = MakeHits(n, Modules.size(), seed);
+    if (shuffle) {
+      std::mt19937_64 rng(seed);
+      std::shuffle(hits.begin(), hits.end(), rng);
+    } else {
+      SpillOrder(hits, 10000);
+    }
+    EncodeRawHits(Gen, Modules, hits, seed, Raw);
+    NumHits = n;
+  }
+
+  void Unpack(UnpackedHitVector& out) const {
+    RawDataVector copy(Raw);
+    out.clear();
+    out.reserve(NumHits);
+    ldf2root::UnpackEvents(&copy, &out);
+  }
+
+  void Sorted(UnpackedHitVector& out) const {
+    Unpack(out);
+    ldf2root::SortEvents(&out);
+  }
+};
+
+/// ldf2root::SortEvents on hits in spill order and in random order
+void AddSortBenchmarks(Suite& suite, const BenchOptions& opts) {
+  for (bool shuffle : {false, true}) {
+    auto source = std::make_shared<HitSource>();
+    Benchmark b;
+    b.name = std::string("sort/") + (shuffle ? "random" : "spill_order");
+    b.category = "micro";
+    b.unit = "hit";
+    b.setup = [=, &opts]() { source->Generate(opts.hits, opts.seed, shuffle); };
+    b.run = [=]() {
+      UnpackedHitVector hits;
+      source->Unpack(hits);
+      const auto t = ldf2root::SortEvents(&hits);
+      return Sample{t.count(), hits.size(), 0};
+    };
+    b.teardown = [=]() { RawDataVector().swap(source->Raw); };
+    suite.Add(std::move(b));
+  }
+}
+
+/// EventBuilder with every window type on the CFD and the coarse times, the events go to a sink that only counts them
+void AddBuildBenchmarks(Suite& suite, const BenchOptions& opts, const std::string& logname) {
+  auto source = std::make_shared<HitSource>();
+  const std::vector<std::pair<std::string, ldf2root::WindowType>> windows = {
+    {"flat", ldf2root::WindowType::FLAT},
+    {"fixed", ldf2root::WindowType::FIXED},
+    {"rolling", ldf2root::WindowType::ROLLING},
+    {"triggered", ldf2root::WindowType::TRIGGERED}
+  };
+  for (const auto& window : windows) {
+    for (const bool coarse : {false, true}) {
+      Benchmark b;
+      b.name = "build/" + window.first + (coarse ? "/coarse" : "");
+      b.category = "micro";
+      b.unit = "hit";
+      b.setup = [=, &opts]() {
+        if (source->Raw.empty()) {
+          source->Generate(opts.hits, opts.seed, false);
+        }
+      };
+      b.run = [=]() {
+        UnpackedHitVector hits;
+        source->Sorted(hits);
+        ldf2root::CmdOptions cmdopts = MakeCmdOptions(source->Modules);
+        cmdopts.build_window_type = window.second;
+        cmdopts.coarse_windows = coarse;
+        // Triggered on channel 0 of the first module, most hits are dropped
+        cmdopts.trigger_channels = {{source->Modules.front().crate, source->Modules.front().slot, 0}};
+        const size_t nhits = hits.size();
+        uint64_t events = 0;
+        EventBuilder builder(logname, cmdopts, [&events](DDASRootEvent&) { ++events; });
+        const auto t = builder.Build(&hits);
+        return Sample{t.count(), nhits, 0};
+      };
+      suite.Add(std::move(b));
+    }
+  }
+}
+
+/// DDASFlatEvent filled with events of random multiplicity, reused from event to event as the
+/// lean writer does and built anew for every event, the difference is the cost of reallocating
+/// the sum and trace vectors of the hits
+void AddFillBenchmarks(Suite& suite, const BenchOptions& opts) {
+  auto source = std::make_shared<HitSource>();
+  for (const bool reuse : {true, false}) {
+    Benchmark b;
+    b.name = std::string("fill/lean_event/") + (reuse ? "reused" : "fresh");
+    b.category = "micro";
+    b.unit = "hit";
+    b.setup = [=, &opts]() {
+      if (source->Raw.empty()) {
+        source->Gen.energy_sums = true;
+        source->Gen.trace_length = 64;
+        source->Generate(std::max<uint64_t>(opts.hits/4, 1), opts.seed, false);
+      }
+    };
+    b.run = [=, &opts]() {
+      UnpackedHitVector hits;
+      source->Unpack(hits);
+      std::mt19937_64 rng(opts.seed);
+      std::uniform_int_distribution<size_t> multiplicity(1, 16);
+      DDASFlatEvent reused;
+      uint64_t filled = 0;
+      const auto start = std::chrono::steady_clock::now();
+      for (size_t pos = 0; pos < hits.size();) {
+        const size_t end = std::min(hits.size(), pos + multiplicity(rng));
+        DDASFlatEvent fresh;
+        DDASFlatEvent& evt = reuse ? reused : fresh;
+        evt.Reset();
+        for (; pos < end; ++pos) {
+          evt.AddChannelData(*hits[pos], true);
+        }
+        evt.Trim();
+        filled += evt.GetNHits();
+      }
+      return Sample{Seconds(std::chrono::steady_clock::now() - start), filled, 0};
+    };
+    b.teardown = [=]() { RawDataVector().swap(source->Raw); };
+    suite.Add(std::move(b));
+  }
+}
+
+/// DataWriter filling the output tree in the default and lean layouts, and reading it back
+void AddWriteBenchmarks(Suite& suite, const BenchOptions& opts, const std::string& logname) {
+  auto source = std::make_shared<HitSource>();
+  struct WriteMode {
+    std::string name;
+    ldf2root::OutputFormat format;
+    bool lean;
+  };
+  std::vector<WriteMode> modes = {
+    {"ttree", ldf2root::OutputFormat::TTREE, false},
+    {"ttree_lean", ldf2root::OutputFormat::TTREE, true}
+  };
+#ifdef LDF2ROOT_HAS_RNTUPLE
+  modes.push_back({"rntuple", ldf2root::OutputFormat::RNTUPLE, false});
+#endif
+  for (const auto& mode : modes) {
+    auto file = std::make_shared<std::filesystem::path>(opts.scratch / ("write_" + mode.name + ".root"));
+    auto cmdopts = std::make_shared<ldf2root::CmdOptions>();
+    auto setup = [=, &opts]() {
+      if (source->Raw.empty()) {
+        source->Gen.energy_sums = true;
+        source->Gen.trace_length = 64;
+        source->Generate(std::max<uint64_t>(opts.hits/4, 1), opts.seed, false);
+      }
+      *cmdopts = MakeCmdOptions(source->Modules);
+      cmdopts->output_format = mode.format;
+      cmdopts->lean_hits = mode.lean;
+      cmdopts->build_window_type = ldf2root::WindowType::FIXED;
+      cmdopts->output_file = file->string();
+    };
+
+    Benchmark w;
+    w.name = "write/" + mode.name;
+    w.category = "micro";
+    w.unit = "hit";
+    w.setup = setup;
+    w.run = [=]() {
+      UnpackedHitVector hits;
+      source->Sorted(hits);
+      DataWriter writer(cmdopts->output_format, logname, *cmdopts);
+      EventBuilder builder(logname, *cmdopts, [&writer](DDASRootEvent& evt) { writer.Fill(evt); });
+      builder.Build(&hits);
+      writer.Close();
+      return Sample{writer.GetWriteTime().count(), builder.GetHitsBuilt(), FileSize(*file)};
+    };
+    w.teardown = [=, &opts]() {
+      if (!opts.keep) {
+        std::filesystem::remove(*file);
+      }
+    };
+    suite.Add(std::move(w));
+
+    if (mode.format != ldf2root::OutputFormat::TTREE) {
+      continue;
+    }
+    // Reading back needs a file, write one if the write benchmark was filtered out
+    Benchmark r;
+    r.name = "read/" + mode.name;
+    r.category = "micro";
+    r.unit = "event";
+    r.setup = [=]() {
+      setup();
+      UnpackedHitVector hits;
+      source->Sorted(hits);
+      DataWriter writer(cmdopts->output_format, logname, *cmdopts);
+      EventBuilder builder(logname, *cmdopts, [&writer](DDASRootEvent& evt) { writer.Fill(evt); });
+      builder.Build(&hits);
+      writer.Close();
+    };
+    r.run = [=]() {
+      const auto start = std::chrono::steady_clock::now();
+      std::unique_ptr<TFile> input(TFile::Open(file->c_str(), "READ"));
+      if (!input || input->IsZombie()) {
+        throw std::runtime_error("Unable to open " + file->string());
+      }
+      TTree* tree = input->Get<TTree>(cmdopts->tree_name.c_str());
+      if (!tree) {
+        throw std::runtime_error("No tree " + cmdopts->tree_name + " in " + file->string());
+      }
+      uint64_t bytes = 0;
+      const Long64_t entries = tree->GetEntries();
+      for (Long64_t ii = 0; ii < entries; ++ii) {
+        bytes += tree->GetEntry(ii);
+      }
+      input->Close();
+      return Sample{Seconds(std::chrono::steady_clock::now() - start), static_cast<uint64_t>(entries), bytes};
+    };
+    r.teardown = w.teardown;
+    suite.Add(std::move(r));
+  }
+}
+
+/// The ldf2root executable converting generated files end to end, with the default read ahead and with synchronous reads
+void AddMacroBenchmarks(Suite& suite, const BenchOptions& opts) {
+  const std::vector<std::pair<std::string, std::string>> variants = {{"", ""}, {"/sync-read", " --read-ahead 0"}};
+  for (double size : opts.macro_sizes) {
+    for (const auto& variant : variants) {
+      const std::string suffix = variant.first;
+      const std::string extra = variant.second;
+      std::ostringstream tag;
+      tag << size << "MB";
+      auto file = std::make_shared<std::filesystem::path>(opts.scratch / ("macro_" + tag.str() + ".ldf"));
+      auto stats = std::make_shared<ldfgen::GenStats>();
+      Benchmark b;
+      b.name = "convert/" + tag.str() + suffix;
+      b.category = "macro";
+      b.unit = "hit";
+      b.setup = [=, &opts]() {
+        ldfgen::GenOptions gen;
+        gen.output_file = file->string();
+        gen.max_size_mb = size;
+        gen.modules = 6;
+        gen.msps = {100, 250, 500};
+        gen.energy_sums = true;
+        gen.trace_length = 100;
+        gen.seed = opts.seed;
+        *stats = ldfgen::GenerateFile(gen);
+      };
+      b.run = [=, &opts]() {
+        std::filesystem::path output = *file;
+        output.replace_extension(".root");
+        const std::string cmd = "\"" + opts.ldf2root + "\" --silent -i \"" + file->string() + "\" -c \"" + ConfigPath(*file) +
+                                "\" -o \"" + output.string() + "\"" + extra + " > /dev/null 2>&1";
+        const auto start = std::chrono::steady_clock::now();
+        const int rc = std::system(cmd.c_str());
+        const double t = Seconds(std::chrono::steady_clock::now() - start);
+        if (rc != 0) {
+          throw std::runtime_error("\"" + cmd + "\" returned " + std::to_string(rc));
+        }
+        return Sample{t, stats->hits, FileSize(*file)};
+      };
+      b.teardown = [=, &opts]() {
+        if (!opts.keep) {
+          std::filesystem::path stem = *file;
+          stem.replace_extension();
+          for (const char* ext : {".ldf", ".root", ".log", ".err", ".dbg"}) {
+            std::filesystem::remove(stem.string() + ext);
+          }
+          std::filesystem::remove(ConfigPath(*file));
+        }
+      };
+      suite.Add(std::move(b));
+    }
+  }
+}
+
+} // namespace bench
+
+void PrintUsageString(std::ostream& os = std::cout) {
+  os << "Usage: ldf2root_bench [options]\n";
+  os << "Options:\n";
+  os << "  --help, -h              Show this help message\n";
+  os << "  --json <file>           Write the results as JSON to this file\n";
+  os << "  --filter <regex>        Only run the benchmarks whose name matches\n";
+  os << "  --list                  List the benchmarks and exit\n";
+  os << "  --repeat <n>            Runs per benchmark, the median is reported (default: 5)\n";
+  os << "  --hits <n>              Hits per microbenchmark (default: 1000000)\n";
+  os << "  --parse-size <MB>       Size of the files for the parse benchmarks (default: 256)\n";
+  os << "  --macro-sizes <list>    Comma separated sizes in MB of the end to end conversions (default: 100)\n";
+  os << "  --no-micro              Skip the microbenchmarks\n";
+  os << "  --no-macro              Skip the end to end conversions\n";
+  os << "  --ldf2root <path>       ldf2root executable for the end to end conversions (default: the one built with the suite)\n";
+  os << "  --scratch <dir>         Directory for the generated files (default: <tmp>/ldf2root_bench)\n";
+  os << "  --keep                  Keep the generated files\n";
+  os << "  --seed <n>              Random seed (default: 1)\n";
+}
+
+void parse_args(int argc, char* argv[], bench::BenchOptions& opts) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") {
+      PrintUsageString();
+      exit(0);
+    } else if (arg == "--json" && i + 1 < argc) {
+      opts.json_file = argv[++i];
+    } else if (arg == "--filter" && i + 1 < argc) {
+      opts.filter = argv[++i];
+    } else if (arg == "--list") {
+      opts.list = true;
+    } else if (arg == "--repeat" && i + 1 < argc) {
+      opts.repeat = std::max(1ul, std::stoul(argv[++i]));
+    } else if (arg == "--hits" && i + 1 < argc) {
+      opts.hits = std::max(1ull, std::stoull(argv[++i]));
+    } else if (arg == "--parse-size" && i + 1 < argc) {
+      opts.parse_mb = std::stod(argv[++i]);
+    } else if (arg == "--macro-sizes" && i + 1 < argc) {
+      opts.macro_sizes.clear();
+      std::stringstream ss(argv[++i]);
+      std::string item;
+      while (std::getline(ss, item, ',')) {
+        opts.macro_sizes.push_back(std::stod(item));
+      }
+    } else if (arg == "--no-micro") {
+      opts.micro = false;
+    } else if (arg == "--no-macro") {
+      opts.macro = false;
+    } else if (arg == "--ldf2root" && i + 1 < argc) {
+      opts.ldf2root = argv[++i];
+    } else if (arg == "--scratch" && i + 1 < argc) {
+      opts.scratch = argv[++i];
+    } else if (arg == "--keep") {
+      opts.keep = true;
+    } else if (arg == "--seed" && i + 1 < argc) {
+      opts.seed = std::stoull(argv[++i]);
+    } else {
+      std::cerr << "Unknown option: " << arg << std::endl << std::endl;
+      PrintUsageString(std::cerr);
+      exit(1);
+    }
+  }
+}
+
+int main(int argc, char* argv[]) {
+  bench::BenchOptions opts;
+  parse_args(argc, argv, opts);
+
+  // The pipeline classes clone their loggers from this one, only warnings and errors get through
+  const std::string logname = "ldf2root_bench";
+  auto console = spdlog::stderr_color_mt(logname);
+  console->set_level(spdlog::level::warn);
+
+  std::error_code ec;
+  std::filesystem::create_directories(opts.scratch, ec);
+  if (ec) {
+    std::cerr << "Unable to create scratch directory " << opts.scratch << " : " << ec.message() << std::endl;
+    return 1;
+  }
+
+  bench::Suite suite(opts, logname);
+  if (opts.micro) {
+    bench::AddParseBenchmarks(suite, opts, logname);
+    bench::AddUnpackBenchmarks(suite, opts);
+    bench::AddSortBenchmarks(suite, opts);
+    bench::AddBuildBenchmarks(suite, opts, logname);
+    bench::AddFillBenchmarks(suite, opts);
+    bench::AddWriteBenchmarks(suite, opts, logname);
+  }
+  if (opts.macro) {
+    bench::AddMacroBenchmarks(suite, opts);
+  }
+  suite.Run();
+
+  if (!opts.json_file.empty() && !opts.list) {
+    try {
+      suite.WriteJSON(opts.json_file);
+      std::cout << "Wrote " << opts.json_file << std::endl;
+    } catch (std::runtime_error const& e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+  }
+  return suite.HasFailures() ? 1 : 0;
+}
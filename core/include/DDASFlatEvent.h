@@ -0,0 +1,108 @@
+/**
+ * @file DDASFlatEvent.h
+ * @brief Built DDAS event storing its hits by value.
+ */
+
+#ifndef DDASFLATEVENT_H
+#define DDASFLATEVENT_H
+
+#include <cstdint>
+#include <vector>
+
+#include <RtypesCore.h>
+
+#include "DDASFlatHit.h"
+
+/**
+ * @addtogroup libddasrootformat libddasrootformat.so
+ * @{
+ */
+
+/**
+ * @class DDASFlatEvent
+ * @brief Contiguous-storage variant of DDASRootEvent.
+ * @details
+ * DDASRootEvent owns a vector of pointers to DDASRootHit objects, so every
+ * hit is a separate allocation in memory and a separate object on disk.
+ * DDASFlatEvent keeps the hits by value in one contiguous vector of
+ * DDASFlatHit and the traces in a parallel vector (trace i belongs to
+ * hit i). Written with split level 99 every hit member ends up in its own
+ * sub-branch. Reset() only rewinds a fill count, AddChannelData()
+ * overwrites the hits and traces already in place and Trim() moves the
+ * slots left over from a larger event into a transient spare pool just
+ * before the event is written, from where AddChannelData() takes them back
+ * when a later event grows again. Filling the same object event after
+ * event therefore reuses the sum and trace vectors of the slots whatever
+ * the multiplicity of the events, instead of reallocating them for every
+ * hit.
+ *
+ * Like DDASFlatHit the class has no TObject base and no `ClassDef()`.
+ */
+class DDASFlatEvent
+{
+private:
+    std::vector<DDASFlatHit> m_hits;                 //!< Hits in time order.
+    std::vector<std::vector<uint16_t>> m_traces;     //!< Trace of each hit.
+    UInt_t m_nHits;   //! Hits filled since the last Reset(), not written.
+    UInt_t m_nTraces; //! Traces filled since the last Reset(), not written.
+    std::vector<DDASFlatHit> m_spareHits;               //! Trimmed hit slots, not written.
+    std::vector<std::vector<uint16_t>> m_spareTraces;   //! Trimmed trace slots, not written.
+
+public:
+    /** @brief Default constructor. */
+    DDASFlatEvent();
+
+    /**
+     * @brief Access the hits of the event.
+     * @return Vector of hits. Holds unused slots until Trim() is called.
+     */
+    std::vector<DDASFlatHit>& GetData() { return m_hits; }
+    /**
+     * @brief Access the hits of the event.
+     * @return Vector of hits.
+     */
+    const std::vector<DDASFlatHit>& GetData() const { return m_hits; }
+    /**
+     * @brief Access the traces of the event, one per hit.
+     * @return Vector of traces. Empty if the traces are not stored.
+     */
+    std::vector<std::vector<uint16_t>>& GetTraces() { return m_traces; }
+    /**
+     * @brief Access the traces of the event, one per hit.
+     * @return Vector of traces. Empty if the traces are not stored.
+     */
+    const std::vector<std::vector<uint16_t>>& GetTraces() const {
+	return m_traces;
+    }
+    /**
+     * @brief Return the number of hits in this event.
+     * @return The number of hits in the event.
+     */
+    UInt_t GetNHits() const { return m_nHits; }
+    /**
+     * @brief Append a copy of a hit to the event.
+     * @param hit       The hit to copy.
+     * @param withTrace Also copy the trace of the hit.
+     */
+    void AddChannelData(const ddasfmt::DDASHit& hit, bool withTrace = true);
+    /**
+     * @brief Get timestamp of first hit.
+     * @return Timestamp of the first hit, 0 if the event is empty.
+     */
+    Double_t GetFirstTime() const;
+    /**
+     * @brief Get timestamp of last hit.
+     * @return Timestamp of the last hit, 0 if the event is empty.
+     */
+    Double_t GetLastTime() const;
+    /** @brief Get time difference between first and last hit. */
+    Double_t GetTimeWidth() const;
+    /** @brief Remove all hits but keep the slots for reuse. */
+    void Reset();
+    /** @brief Set the unused slots aside, call before the event is written. */
+    void Trim();
+};
+
+/** @} */
+
+#endif
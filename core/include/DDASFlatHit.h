@@ -0,0 +1,97 @@
+/**
+ * @file DDASFlatHit.h
+ * @brief Plain, TObject-free copy of a DDAS hit for columnar output.
+ */
+
+#ifndef DDASFLATHIT_H
+#define DDASFLATHIT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "DDASHit.h"
+
+/**
+ * @addtogroup libddasrootformat libddasrootformat.so
+ * @{
+ */
+
+/**
+ * @class DDASFlatHit
+ * @brief Flat record of the scalar data of a single DDAS hit.
+ * @details
+ * DDASFlatHit carries the same information as ddasfmt::DDASHit except for
+ * the ADC trace. It has no virtual functions, no TObject base and no
+ * `ClassDef()`, so every member maps directly onto a column in an RNTuple
+ * or a split TTree branch. The trace is written alongside the hits as a
+ * separate collection indexed in the same order as the hits of the event.
+ */
+struct DDASFlatHit
+{
+    double   time;              //!< Assembled time including CFD.
+    uint64_t coarseTime;        //!< Assembled time without CFD.
+    uint64_t externalTimestamp; //!< External timestamp.
+    uint32_t timeHigh;          //!< Bits 32-47 of timestamp.
+    uint32_t timeLow;           //!< Bits 0-31 of timestamp.
+    uint32_t timeCFD;           //!< Raw cfd time.
+    uint32_t energy;            //!< Energy of event.
+    uint32_t finishCode;        //!< Indicates whether pile-up occurred.
+    uint32_t channelLength;     //!< Number of 32-bit words of raw data.
+    uint32_t channelHeaderLength; //!< Length of header.
+    uint32_t chanID;            //!< Channel index.
+    uint32_t slotID;            //!< Slot index.
+    uint32_t crateID;           //!< Crate index.
+    uint32_t cfdTrigSourceBit;  //!< ADC clock cycle for CFD ZCP.
+    uint32_t cfdFailBit;        //!< Indicates whether the CFD failed.
+    uint32_t traceLength;       //!< Length of stored trace.
+    uint32_t modMSPS;           //!< Sampling rate of the module (MSPS).
+    int      hdwrRevision;      //!< Hardware revision.
+    int      adcResolution;     //!< ADC resolution.
+    bool     adcOverflowUnderflow; //!< =1 if over- or under-flow.
+
+    std::vector<uint32_t> energySums; //!< Energy sum data.
+    std::vector<uint32_t> qdcSums;    //!< QDC sum data.
+
+    /** @brief Default constructor, all members are zero-initialized. */
+    DDASFlatHit() :
+	time(0), coarseTime(0), externalTimestamp(0), timeHigh(0), timeLow(0),
+	timeCFD(0), energy(0), finishCode(0), channelLength(0),
+	channelHeaderLength(0), chanID(0), slotID(0), crateID(0),
+	cfdTrigSourceBit(0), cfdFailBit(0), traceLength(0), modMSPS(0),
+	hdwrRevision(0), adcResolution(0), adcOverflowUnderflow(false),
+	energySums(), qdcSums()
+	{}
+
+    /**
+     * @brief Copy the scalar and sum data out of a DDASHit.
+     * @param hit The hit to copy from. The trace is not copied.
+     */
+    void Set(const ddasfmt::DDASHit& hit) {
+	time = hit.getTime();
+	coarseTime = hit.getCoarseTime();
+	externalTimestamp = hit.getExternalTimestamp();
+	timeHigh = hit.getTimeHigh();
+	timeLow = hit.getTimeLow();
+	timeCFD = hit.getTimeCFD();
+	energy = hit.getEnergy();
+	finishCode = hit.getFinishCode();
+	channelLength = hit.getChannelLength();
+	channelHeaderLength = hit.getChannelHeaderLength();
+	chanID = hit.getChannelID();
+	slotID = hit.getSlotID();
+	crateID = hit.getCrateID();
+	cfdTrigSourceBit = hit.getCFDTrigSource();
+	cfdFailBit = hit.getCFDFailBit();
+	traceLength = hit.getTraceLength();
+	modMSPS = hit.getModMSPS();
+	hdwrRevision = hit.getHardwareRevision();
+	adcResolution = hit.getADCResolution();
+	adcOverflowUnderflow = hit.getADCOverflowUnderflow();
+	energySums.assign(hit.getEnergySums().begin(), hit.getEnergySums().end());
+	qdcSums.assign(hit.getQDCSums().begin(), hit.getQDCSums().end());
+    }
+};
+
+/** @} */
+
+#endif
@@ -26,6 +26,9 @@
 
 #include <stdint.h>
 
+#include <cmath>
+#include <compare>
+#include <limits>
 #include <vector>
 
 /** @namespace ddasfmt */
@@ -75,6 +78,89 @@ namespace ddasfmt {
      */
     class DDASHit {
 	    
+    public:
+	/**
+	 * @brief Fractional bits of the fixed point time.
+	 * @details
+	 * The CFD correction of every module type is a whole multiple of 
+	 * 2^-14 ns, so the fixed point time is exact and the double time 
+	 * derived from it is the same as coarse time + CFD correction.
+	 */
+	static constexpr int TIME_FRACTION_BITS = 14;
+	
+	/**
+	 * @struct FixedTime
+	 * @brief Exact hit time as whole nanoseconds and a fraction of a 
+	 * nanosecond in 2^-14 ns.
+	 * @details
+	 * The 48-bit timestamp in 8 or 10 ns clock ticks reaches 2^51 ns, 
+	 * which does not fit in one int64_t together with the 14 fractional
+	 * bits. The two parts are therefore kept apart and compared in 
+	 * turn. Intervals between two times are plain int64_t in 2^-14 ns, 
+	 * they saturate beyond 2^48 ns which is far longer than any build 
+	 * window or reorder horizon.
+	 */
+	struct FixedTime {
+	    int64_t  ns;       //!< Whole nanoseconds, rounded down.
+	    uint32_t fraction; //!< Remainder in 2^-14 ns, below 2^14.
+	    
+	    auto operator<=>(const FixedTime&) const = default;
+	    
+	    /** @brief The time shifted by an interval in 2^-14 ns. */
+	    FixedTime operator+(int64_t interval) const {
+		const int64_t frac = static_cast<int64_t>(fraction)
+		    + (interval & FRACTION_MASK);
+		return {ns + (interval >> TIME_FRACTION_BITS)
+			+ (frac >> TIME_FRACTION_BITS),
+			static_cast<uint32_t>(frac & FRACTION_MASK)};
+	    }
+	    /** @brief The time shifted back by an interval in 2^-14 ns. */
+	    FixedTime operator-(int64_t interval) const {
+		return *this + (-interval);
+	    }
+	    /** @brief The interval to an earlier time in 2^-14 ns. */
+	    int64_t operator-(const FixedTime& rhs) const {
+		const int64_t dns = ns - rhs.ns;
+		if (dns >= MAX_INTERVAL_NS) {
+		    return std::numeric_limits<int64_t>::max();
+		}
+		if (dns <= -MAX_INTERVAL_NS) {
+		    return std::numeric_limits<int64_t>::min();
+		}
+		return dns*(int64_t(1) << TIME_FRACTION_BITS)
+		    + (static_cast<int64_t>(fraction) - rhs.fraction);
+	    }
+	    /** @brief The time in nanoseconds. */
+	    double toNs() const {
+		return static_cast<double>(ns)
+		    + std::ldexp(fraction, -TIME_FRACTION_BITS);
+	    }
+	    
+	    /** @brief A time before every hit. */
+	    static constexpr FixedTime min() {
+		return {std::numeric_limits<int64_t>::min(), 0};
+	    }
+	    /** @brief A time after every hit. */
+	    static constexpr FixedTime max() {
+		return {std::numeric_limits<int64_t>::max(),
+			static_cast<uint32_t>(FRACTION_MASK)};
+	    }
+	    
+	    static constexpr int64_t FRACTION_MASK
+	    = (int64_t(1) << TIME_FRACTION_BITS) - 1;
+	    static constexpr int64_t MAX_INTERVAL_NS = int64_t(1) << 48;
+	};
+	
+	/** @brief Convert an interval in nanoseconds to 2^-14 ns. */
+	static int64_t toFixedInterval(double ns) {
+	    return std::llround(std::ldexp(ns, TIME_FRACTION_BITS));
+	}
+	/** @brief Convert an interval in 2^-14 ns to nanoseconds. */
+	static double fromFixedInterval(int64_t interval) {
+	    return std::ldexp(static_cast<double>(interval), 
+			      -TIME_FRACTION_BITS);
+	}
+
     private:
 	    
 	// Channel events always have the following info:
@@ -182,6 +268,24 @@ namespace ddasfmt {
 	 * @return double The timestamp in units of nanoseconds.
 	 */
 	double getTime() const { return m_time; }
+	/**
+	 * @brief Retrieve the computed time as an exact fixed point number.
+	 * @details
+	 * The same time as getTime() assembled from the coarse timestamp 
+	 * and the raw CFD data, so it is also right for hits read back 
+	 * from a file. Sorting and event building compare this exact 
+	 * time, the double is only needed for the output.
+	 *
+	 * The CFD correction in units of 2^-14 ns is:
+	 * - 100 MSPS: timeCFD/2^15*10 ns = 5*timeCFD
+	 * - 250 MSPS: (timeCFD/2^14 - cfdTrigSourceBit)*4 ns 
+	 *   = 4*(timeCFD - 2^14*cfdTrigSourceBit)
+	 * - 500 MSPS: (timeCFD/2^13 + cfdTrigSourceBit - 1)*2 ns 
+	 *   = 4*(timeCFD + 2^13*(cfdTrigSourceBit - 1))
+	 *
+	 * @return The timestamp including the CFD correction.
+	 */
+	FixedTime getFixedTime() const;
 	/** 
 	 * @brief Retrieve the raw timestamp in nanoseconds without 
 	 * any CFD correction.
@@ -11,5 +11,9 @@
 #pragma link C++ class std::vector<DDASRootHit*>!;
 #pragma link C++ class DDASRootHit+;
 #pragma link C++ class ddasfmt::DDASHit+;
+#pragma link C++ class DDASFlatHit+;
+#pragma link C++ class std::vector<DDASFlatHit>+;
+#pragma link C++ class std::vector<std::vector<unsigned short>>+;
+#pragma link C++ class DDASFlatEvent+;
 
 #endif
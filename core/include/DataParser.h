@@ -30,9 +30,14 @@ class DataParser{
 		};
 		DataParser(DataFileType,const std::string&, ldf2root::CmdOptions cmdopts);
 		~DataParser() = default;
-		void SetInputFiles(std::vector<std::string>&);
+		void SetInputFiles(const std::vector<std::string>&);
 		
 		Translator::TRANSLATORSTATE Parse(std::vector<uint32_t>* RawEvents);
+		/// Bytes read from the input files so far
+		uint64_t GetBytesRead() const { return this->DataTranslator->GetBytesRead(); }
+		Translator::ParseStats GetParseStats() const { return this->DataTranslator->GetParseStats(); }
+		/// The spills finished since the last call
+		std::vector<Translator::SpillInfo> TakeSpills() { return this->DataTranslator->TakeSpills(); }
 
 	private:
 		DataFileType DataType;
@@ -0,0 +1,80 @@
+#ifndef __DATA_WRITER_HPP__
+#define __DATA_WRITER_HPP__
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <spdlog/common.h>
+#include <spdlog/spdlog.h>
+
+#include "EventWriter.h"
+#include "InputParser.h"
+#include "PipelineMetrics.h"
+#include "Translator.h"
+
+class TFile;
+class TTree;
+class DDASRootEvent;
+
+class DataWriter{
+	public:
+		DataWriter(ldf2root::OutputFormat,const std::string&, ldf2root::CmdOptions cmdopts);
+		~DataWriter();
+
+		void Fill(DDASRootEvent&);
+		/// Add the spills to the '<tree_name>_spills' tree, created with the first spill
+		void FillSpills(const std::vector<Translator::SpillInfo>&);
+		/// Finalize the backend, write and close the output file, and report the write throughput.
+		/// Does nothing once the file is closed.
+		void Close();
+		/// Make the events written so far readable by other processes while the file stays open
+		void Save();
+
+		TFile* GetFile() const { return this->OutputFile; }
+		/// Report the write stage to these metrics, nullptr disables it
+		void SetMetrics(PipelineMetrics* metrics) { this->Metrics = metrics; }
+		/// Time spent in Fill() and Close() so far
+		std::chrono::duration<double> GetWriteTime() const { return this->WriteTime; }
+
+	private:
+		// Branch buffers of the spill tree
+		struct SpillEntry{
+			ULong64_t Spill;
+			UInt_t File;
+			ULong64_t Offset;
+			UInt_t Words;
+			UInt_t Chunks;
+			UInt_t MissingChunks;
+			UInt_t Flags;
+			ULong64_t Hits;
+			ULong64_t FirstTime;
+			ULong64_t LastTime;
+			std::vector<UShort_t> Crate;
+			std::vector<UShort_t> Slot;
+			std::vector<UInt_t> ModuleHits;
+		};
+		void CreateSpillTree();
+		/// Bytes written to the output file and the separate trace file, if any
+		Long64_t BytesWritten() const;
+
+		ldf2root::OutputFormat Format;
+		std::shared_ptr<spdlog::logger> console;
+		std::string LogName;
+		std::string WriterName;
+		ldf2root::CmdOptions CmdOpts;
+
+		TFile* OutputFile;
+		TFile* TraceFile;
+		std::unique_ptr<EventWriter> Writer;
+		TTree* SpillTree; // owned by the output file
+		SpillEntry CurrSpill;
+		uint64_t SpillsWritten;
+		uint64_t SpillsFlagged;
+
+		std::chrono::duration<double> WriteTime;
+		PipelineMetrics* Metrics;
+};
+
+#endif
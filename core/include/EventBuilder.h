@@ -0,0 +1,102 @@
+#ifndef __EVENT_BUILDER_HPP__
+#define __EVENT_BUILDER_HPP__
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <spdlog/common.h>
+#include <spdlog/spdlog.h>
+
+#include "DDASRootEvent.h"
+#include "InputParser.h"
+#include "Pipeline.h"
+
+class DDASRootHit;
+class PipelineMetrics;
+class TimeDifferences;
+template<class Window> class WindowEngine;
+
+/// @addtogroup Building
+/// @{
+/// @class EventBuilder
+/// @brief Groups time ordered hits into DDASRootEvents according to the build window
+/// @details
+/// Hits are handed over one at a time with AddHit(), so the builder can be fed from a sorted
+/// vector, a merge or a reorder buffer alike. A finished event is passed to the sink and reset.
+/// - FLAT : every hit is its own event
+/// - FIXED : an event holds all hits within build_window of its first hit
+/// - ROLLING : an event continues as long as the next hit is within build_window of the previous one
+/// - TRIGGERED : an event holds the hits from pre_window before to post_window after a hit of a
+///   trigger channel. Hits that are in no trigger window are dropped, so they never reach the writer.
+///   A hit belongs to one event at most, a trigger inside the post window of another is a hit of that event.
+///
+/// Each window type is a policy in WindowEngine.h and the building loop is compiled once per policy
+/// and time representation, the exact fixed point CFD corrected time or the integer coarse timestamp
+/// (coarse_windows).
+/// The engine is picked once in the constructor, so no hit goes through a switch on the window type.
+/// A new window type is a new policy and a case in the constructor.
+class EventBuilder{
+	public:
+		using EventSink = std::function<void(DDASRootEvent&)>;
+
+		/// The building loop of one window type, see WindowEngine
+		class Engine{
+			public:
+				virtual ~Engine() = default;
+				virtual void AddHit(std::unique_ptr<DDASRootHit>) = 0;
+				/// Add the hits [begin,end) of a time ordered list
+				virtual void AddHits(UnpackedHitVector*,size_t,size_t) = 0;
+				/// Emit the open event and drop what the policy still holds back
+				virtual void Flush() = 0;
+		};
+
+		EventBuilder(const std::string&,const ldf2root::CmdOptions&,EventSink);
+		~EventBuilder();
+
+		/// Add the next hit in time order, the builder takes ownership
+		void AddHit(std::unique_ptr<DDASRootHit>);
+		/// Emit the event that is still open
+		void Flush();
+		/// Build every hit of a time ordered list with progress messages and flush, returns the time taken
+		std::chrono::duration<double> Build(UnpackedHitVector*);
+
+		void SetMetrics(PipelineMetrics* metrics) { this->Metrics = metrics; }
+		/// Hand every hit to these time difference histograms before it is built, nullptr disables it
+		void SetTimeDifferences(TimeDifferences* differences) { this->Differences = differences; }
+
+		uint64_t GetEventsBuilt() const { return this->EventsBuilt; }
+		/// Hits put into events
+		uint64_t GetHitsBuilt() const { return this->HitsBuilt; }
+		/// Hits outside of every trigger window
+		uint64_t GetHitsDropped() const { return this->HitsDropped; }
+
+	private:
+		template<class Window> friend class WindowEngine;
+
+		void Emit();
+
+		std::string LogName;
+		ldf2root::WindowType Window;
+		Double_t BuildWindow;
+		Double_t PreWindow;
+		Double_t PostWindow;
+		Bool_t CoarseWindows;
+		EventSink Sink;
+
+		std::unique_ptr<Engine> BuildEngine;
+		DDASRootEvent CurrEvent;
+
+		uint64_t EventsBuilt;
+		uint64_t HitsBuilt;
+		uint64_t HitsDropped;
+		PipelineMetrics* Metrics;
+		TimeDifferences* Differences;
+
+		std::shared_ptr<spdlog::logger> console;
+};
+/// @}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef __EVENT_DIGEST_HPP__
+#define __EVENT_DIGEST_HPP__
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <spdlog/common.h>
+#include <spdlog/spdlog.h>
+
+#include "DDASFlatHit.h"
+#include "InputParser.h"
+
+class DDASRootEvent;
+
+/// @addtogroup Verification
+/// @{
+/// @class EventDigest
+/// @brief Streams a digest of every built event to a text file, so two conversions can be compared without their ROOT files
+/// @details
+/// Each event is written as an event line followed by one line per hit:
+///
+///     E <event> <hits> <event hash>
+///     H <crate> <slot> <channel> <time> <energy> <trace hash> <hit hash>
+///
+/// The hit hash is a 64 bit FNV-1a over every field of the hit, including the trace, energy sums,
+/// QDC sums and the external timestamp, and the event hash combines the hit hashes in order.
+/// A final line `T <events> <hits> <run hash>` closes the stream. By default the digest is taken
+/// from the built event before it is handed to the writer, so it does not depend on the output
+/// format. With --digest-output OutputDigest reads the written tree or ntuple back and adds its
+/// entries instead, the hashes are the same for every layout that stores the same hits.
+class EventDigest{
+	public:
+		EventDigest(const std::string&,const ldf2root::CmdOptions&);
+		~EventDigest();
+
+		void Add(DDASRootEvent&);
+		/// Add an event of the lean layout, the traces are empty or one per hit
+		void Add(const std::vector<DDASFlatHit>&,const std::vector<std::vector<uint16_t>>&);
+		/// Write the trailer and close the file. An incomplete digest of a failed conversion is
+		/// closed with a comment line instead of the trailer, so it never compares as finished.
+		void Close(bool complete = true);
+
+		static uint64_t HashHit(const DDASFlatHit&,const std::vector<uint16_t>&);
+		static uint64_t HashTrace(const std::vector<uint16_t>&);
+
+		uint64_t GetEvents() const { return this->Events; }
+		uint64_t GetHits() const { return this->Hits; }
+		uint64_t GetRunHash() const { return this->RunHash; }
+
+	private:
+		void AddHit(const DDASFlatHit&,const std::vector<uint16_t>&,uint64_t&);
+		void EndEvent(size_t,uint64_t);
+		void FlushBuffer();
+
+		std::string LogName;
+		std::string FileName;
+		std::ofstream Output;
+		std::string Buffer;
+		std::string HitLines; // hit lines of the current event, written after its event line
+		DDASFlatHit FlatHit; // hit of a DDASRootEvent being hashed, its sum vectors are reused
+
+		uint64_t Events;
+		uint64_t Hits;
+		uint64_t RunHash;
+
+		std::shared_ptr<spdlog::logger> console;
+};
+/// @}
+
+#endif
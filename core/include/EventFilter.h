@@ -0,0 +1,80 @@
+#ifndef __EVENT_FILTER_HPP__
+#define __EVENT_FILTER_HPP__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <spdlog/common.h>
+#include <spdlog/spdlog.h>
+
+#include "InputParser.h"
+
+class DDASRootEvent;
+
+/// @addtogroup Building
+/// @{
+/// @class EventFilter
+/// @brief Selects the built events that are written, from the --filter expressions
+/// @details
+/// An expression combines predicates with `&&`, `||`, `!` and parentheses, several --filter
+/// options must all be true:
+/// - `mult <op> N` : number of hits in the event
+/// - `width <op> T` : time between the first and the last hit in nanoseconds
+/// - `energy <op> E` : any hit with an energy passing the comparison
+/// - `energy(crate:slot:chan) <op> E` : any hit of that channel with an energy passing the comparison
+/// - `has(crate:slot:chan)` : the event has a hit of that channel
+///
+/// where `<op>` is one of `>`, `>=`, `<`, `<=`, `==` and `!=`. The expression is compiled once into
+/// a list of predicates and a postfix program over their results. Every predicate is evaluated for
+/// every event, so the pass count reported for each of them does not depend on the others.
+class EventFilter{
+	public:
+		EventFilter(const std::string&,const ldf2root::CmdOptions&);
+
+		/// True if the event passes the filter
+		bool Accept(DDASRootEvent&);
+		/// Log the events accepted and the pass count of every predicate
+		void Report() const;
+
+		/// The expression of all --filter options, combined with &&
+		const std::string& GetExpression() const { return this->Expression; }
+		uint64_t GetEventsIn() const { return this->EventsIn; }
+		uint64_t GetEventsAccepted() const { return this->EventsAccepted; }
+
+	private:
+		enum class Compare{ GT, GE, LT, LE, EQ, NE };
+		struct Predicate{
+			enum Kind{ MULT, WIDTH, ENERGY, HAS } Type;
+			Compare Op = Compare::GT;
+			double Value = 0.0;
+			int Channel = -1; // crate*256 + slot*16 + channel, -1 for any channel
+			std::string Text;
+			uint64_t Passed = 0;
+		};
+		// Postfix program: a predicate result, or an operator on the results before it
+		struct Instruction{
+			enum Code{ PREDICATE, NOT, AND, OR } Op;
+			size_t Index = 0;
+		};
+		class Parser;
+
+		static bool Test(Compare,double,double);
+		bool Evaluate(const Predicate&,DDASRootEvent&) const;
+
+		std::string LogName;
+		std::string Expression;
+		std::vector<Predicate> Predicates;
+		std::vector<Instruction> Program;
+		std::vector<char> Results; // result of every predicate for the current event
+		std::vector<char> Stack;
+
+		uint64_t EventsIn;
+		uint64_t EventsAccepted;
+
+		std::shared_ptr<spdlog::logger> console;
+};
+/// @}
+
+#endif
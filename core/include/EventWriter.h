@@ -0,0 +1,53 @@
+#ifndef __EVENT_WRITER_HPP__
+#define __EVENT_WRITER_HPP__
+
+#include <memory>
+#include <string>
+
+#include <spdlog/common.h>
+#include <spdlog/spdlog.h>
+
+#include "InputParser.h"
+
+class TFile;
+class DDASRootEvent;
+
+/// @addtogroup Output
+/// @{
+/// @class EventWriter
+/// @brief Base class for the output backends that store built DDASRootEvents in a ROOT file
+class EventWriter{
+	public:
+		EventWriter(const std::string&,const std::string&,const ldf2root::CmdOptions&);
+		virtual ~EventWriter();
+		/// Create the output containers inside the (already open) output file.
+		/// The second file receives the split traces, nullptr when traces stay in the events.
+		virtual bool Initialize(TFile*,TFile*);
+		/// Store one built event
+		virtual void Fill(DDASRootEvent&);
+		/// Flush everything still buffered into the output file
+		virtual void Finalize();
+		/// Make the events written so far readable while the file stays open, used in follow mode
+		virtual void Save();
+
+		uint64_t GetEventsWritten() const { return this->EventsWritten; }
+		uint64_t GetHitsWritten() const { return this->HitsWritten; }
+
+	protected:
+		std::string LogName;
+		std::string WriterName;
+		ldf2root::CmdOptions CmdOpts;
+
+		TFile* OutputFile;
+		TFile* TraceFile;
+		uint64_t EventsWritten;
+		uint64_t HitsWritten;
+
+		/// Name of the tree/ntuple holding the split traces
+		std::string GetTraceTreeName() const { return this->CmdOpts.tree_name+"_traces"; }
+
+		std::shared_ptr<spdlog::logger> console;
+};
+/// @}
+
+#endif
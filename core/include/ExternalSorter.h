@@ -0,0 +1,104 @@
+#ifndef __EXTERNAL_SORTER_HPP__
+#define __EXTERNAL_SORTER_HPP__
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <spdlog/common.h>
+#include <spdlog/spdlog.h>
+
+#include "DDASHitUnpacker.h"
+#include "DDASRootHit.h"
+#include "InputParser.h"
+#include "Pipeline.h"
+
+class EventBuilder;
+
+/// @addtogroup Sorting
+/// @{
+/// @class ExternalSorter
+/// @brief Time orders runs that do not fit in memory, with sorted runs on scratch disk and a k-way merge
+/// @details
+/// Every block of raw hit words from the translator is sorted by hit time and written to a run
+/// file in the scratch directory. The runs hold the raw words (with the two DDAS words in front),
+/// the most compact form of a hit, and the hits are only unpacked into DDASRootHits while the
+/// runs are merged straight into the EventBuilder. Ties in time keep the order the hits were
+/// parsed in, like the in-memory SortEvents, so both sort modes build the same events.
+///
+/// Memory is bounded by sort_memory_mb: the translator hands over blocks of 2/5 of it in a raw
+/// buffer reserved up front at half of it (the spill crossing the block limit only grows the
+/// buffer if it is larger than a quarter block), the sort keys take 24 bytes per hit on top (a
+/// third of the block for hits of 18 words, more for shorter hits), and the merge splits half
+/// of it over the read buffers of the runs.
+///
+/// Every run needs a read buffer of at least MIN_READ_BUFFER and an open file, so the final merge
+/// takes at most MemoryLimit/2/MIN_READ_BUFFER runs, and no more than the open file limit allows.
+/// With more runs, groups of consecutive runs are first merged into longer runs, pass after pass,
+/// until the rest fits. Consecutive groups keep the earlier run first on ties.
+class ExternalSorter{
+	public:
+		ExternalSorter(const std::string&,const ldf2root::CmdOptions&);
+		~ExternalSorter();
+
+		/// Sort a block of raw hit words and spill it as a run, the block is cleared, returns the time taken
+		std::chrono::duration<double> AddBlock(RawDataVector*);
+		/// Merge all runs into the builder and flush it, returns the time taken
+		std::chrono::duration<double> Merge(EventBuilder&);
+
+		size_t GetNumRuns() const { return this->Runs.size(); }
+		uint64_t GetHits() const { return this->TotalHits; }
+		uint64_t GetBytesSpilled() const { return this->BytesSpilled; }
+
+	private:
+		struct SortKey{
+			DDASRootHit::FixedTime Time;
+			uint64_t Offset; // word offset of the hit in the block
+		};
+
+		/// Sequential reader of one run, unpacks one hit at a time
+		class RunReader{
+			public:
+				RunReader(const std::filesystem::path&,size_t);
+				/// Unpack the next hit into a new DDASRootHit, returns false at the end of the run
+				bool Next(ddasfmt::DDASHitUnpacker&);
+				/// Read the next hit as raw words and decode only its time, returns false at the end of the run
+				bool NextRaw(ddasfmt::DDASHitUnpacker&);
+
+				std::unique_ptr<DDASRootHit> Hit;
+				DDASRootHit::FixedTime Time; // time of the hit read by NextRaw()
+				std::vector<uint32_t> Words; // raw words of the last hit, the event length first
+			private:
+				bool ReadWords();
+
+				std::ifstream Input;
+				std::vector<char> StreamBuffer;
+				ddasfmt::DDASHit Scratch;
+		};
+
+		void RemoveRuns();
+		/// Number of runs one merge can read at once, bounded by the memory limit and the open file limit
+		size_t MaxFanIn() const;
+		/// Merge the runs [first,last) into one new run and remove them, returns the new run
+		std::filesystem::path MergeRuns(size_t,size_t,unsigned int);
+
+		std::string LogName;
+		ldf2root::CmdOptions CmdOpts;
+		std::filesystem::path ScratchDir;
+		uint64_t MemoryLimit;
+
+		ddasfmt::DDASHitUnpacker Unpacker;
+		std::vector<SortKey> Keys;
+		std::vector<std::filesystem::path> Runs;
+		uint64_t TotalHits;
+		uint64_t BytesSpilled;
+
+		std::shared_ptr<spdlog::logger> console;
+};
+/// @}
+
+#endif
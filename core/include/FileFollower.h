@@ -0,0 +1,55 @@
+#ifndef __FILE_FOLLOWER_HPP__
+#define __FILE_FOLLOWER_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <spdlog/common.h>
+#include <spdlog/spdlog.h>
+
+#include "InputParser.h"
+
+/// @addtogroup Decoding
+/// @{
+/// @class FileFollower
+/// @brief Waits for an input file that is still being written to grow, used by the translator in follow mode
+/// @details
+/// WaitForSize() blocks until the file holds the requested number of bytes, so the translator
+/// only ever reads complete buffers. On Linux the file is watched with inotify, everywhere else
+/// (and on file systems that do not report remote writes, e.g. NFS) the size is polled.
+/// Following stops when the file has not grown for follow_timeout seconds, or when RequestStop()
+/// is called, e.g. from a SIGINT handler. A stopped follower stays stopped.
+class FileFollower{
+	public:
+		FileFollower(const std::string&,const ldf2root::CmdOptions&);
+		~FileFollower();
+
+		/// Block until the file has at least this many bytes, returns false if following stopped first
+		bool WaitForSize(const std::string&,uint64_t);
+		bool IsStopped() const { return this->Stopped; }
+
+		/// Stop every follower in the process, only touches an atomic flag so it is safe in a signal handler
+		static void RequestStop() { StopRequested.store(true,std::memory_order_relaxed); }
+
+	private:
+		void Watch(const std::string&);
+		void WaitForChange();
+
+		std::string LogName;
+		std::chrono::seconds Timeout; // without growth before giving up, 0 waits forever
+		bool Stopped;
+
+		int InotifyFD;
+		int WatchFD;
+		std::string WatchedFile;
+
+		static std::atomic<bool> StopRequested;
+
+		std::shared_ptr<spdlog::logger> console;
+};
+/// @}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef __HIT_REORDER_BUFFER_HPP__
+#define __HIT_REORDER_BUFFER_HPP__
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <spdlog/common.h>
+#include <spdlog/spdlog.h>
+
+#include "DDASRootHit.h"
+#include "InputParser.h"
+#include "LogRateLimiter.h"
+#include "Pipeline.h"
+
+/// @addtogroup Sorting
+/// @{
+/// @class HitReorderBuffer
+/// @brief Streaming time ordering of hits with a bounded horizon, replaces the whole-dataset sort for streaming use
+/// @details
+/// Pixie modules are read out once per spill, every module hands over its FIFO in time order, so
+/// hits are only out of order across modules and only within about one spill. The buffer keeps the
+/// hits in a min-heap keyed on time (ties keep the order they were pushed in) and remembers the
+/// latest time seen from every module. The oldest of these latest times is the point every module
+/// FIFO has been read up to, and the watermark trails it by the reorder horizon, so a hit a module
+/// delivers up to one horizon late is still put in order. Buffered hits up to the watermark can no
+/// longer be overtaken and are released to the sink in time order.
+///
+/// A module that stops delivering would hold the watermark back forever. Modules whose latest
+/// time is more than the horizon behind the newest hit are therefore left out, which bounds the
+/// buffer to about two horizons of data. A hit that arrives before the last released time can not
+/// be put in order anymore, it is counted, reported and handed to the sink as it is, so no data
+/// is lost.
+///
+/// All times are compared as the exact fixed point hit times, see DDASHit::getFixedTime().
+class HitReorderBuffer{
+	public:
+		using HitSink = std::function<void(std::unique_ptr<DDASRootHit>)>;
+
+		HitReorderBuffer(const std::string&,const ldf2root::CmdOptions&,HitSink);
+		~HitReorderBuffer();
+
+		/// Buffer a hit, nothing is released until Release() or Flush()
+		void Push(std::unique_ptr<DDASRootHit>);
+		/// Buffer all unpacked hits, the vector is cleared
+		void Push(UnpackedHitVector*);
+		/// Release every hit up to the watermark, returns the time taken
+		std::chrono::duration<double> Release();
+		/// Release every remaining hit at the end of the input, returns the time taken
+		std::chrono::duration<double> Flush();
+		/// Log the late hit totals
+		void Report();
+
+		/// Release limit in nanoseconds
+		double GetWatermark() const { return this->Watermark.toNs(); }
+		size_t GetSize() const { return this->Heap.size(); }
+		size_t GetPeakSize() const { return this->PeakSize; }
+		uint64_t GetHitsIn() const { return this->HitsIn; }
+		uint64_t GetHitsOut() const { return this->HitsOut; }
+		uint64_t GetLateHits() const { return this->LateHits; }
+		double GetMaxLateness() const { return this->MaxLateness; }
+
+	private:
+		struct Entry{
+			DDASRootHit::FixedTime Time;
+			uint64_t Sequence; // push order, breaks ties in time
+			std::unique_ptr<DDASRootHit> Hit;
+		};
+		/// Heap order, the earliest entry is at the front
+		static bool Later(const Entry& a,const Entry& b){ return a.Time > b.Time or (a.Time == b.Time and a.Sequence > b.Sequence); }
+
+		void UpdateWatermark();
+		void ReleaseUpTo(DDASRootHit::FixedTime);
+
+		std::string LogName;
+		ldf2root::CmdOptions CmdOpts;
+		HitSink Sink;
+		double Horizon; // ns
+		int64_t FixedHorizon; // in 2^-14 ns, the interval unit of the fixed point hit times
+
+		std::vector<Entry> Heap;
+		// Latest time seen per module, indexed by crate*16 + slot
+		static const size_t MAX_MODULES = 256;
+		std::array<DDASRootHit::FixedTime,MAX_MODULES> ModuleLatest;
+		std::array<bool,MAX_MODULES> ModuleSeen;
+		DDASRootHit::FixedTime NewestTime;
+		DDASRootHit::FixedTime Watermark;
+		DDASRootHit::FixedTime LastReleased;
+		bool Released;
+
+		uint64_t Sequence;
+		uint64_t HitsIn;
+		uint64_t HitsOut;
+		uint64_t LateHits;
+		double MaxLateness;
+		size_t PeakSize;
+
+		LogRateLimiter LogLimiter;
+		std::shared_ptr<spdlog::logger> console;
+};
+/// @}
+
+#endif
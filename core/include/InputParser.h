@@ -11,7 +11,20 @@ namespace ldf2root {
 enum WindowType {
   FLAT = 0,
   FIXED = 1,
-  ROLLING = 2
+  ROLLING = 2,
+  TRIGGERED = 3
+};
+
+// A single channel given as crate:slot:channel on the command line
+struct ChannelID {
+  unsigned int crate = 0;
+  unsigned int slot = 0;
+  unsigned int channel = 0;
+};
+
+enum OutputFormat {
+  TTREE = 0,
+  RNTUPLE = 1
 };
 
 struct CmdOptions {
@@ -23,9 +36,54 @@ struct CmdOptions {
   std::string tree_name;
   Double_t build_window = 3000; // Default build window in nanoseconds
   WindowType build_window_type = WindowType::FLAT; // Default to fixed window
+  std::vector<ChannelID> trigger_channels; // Channels opening an event in the triggered window type
+  Double_t pre_window = 0; // Nanoseconds before a trigger hit that belong to its event
+  Double_t post_window = -1; // Nanoseconds after a trigger hit that belong to its event, negative uses the build window
+  Bool_t coarse_windows = false; // Compare build windows on the integer coarse timestamps, without the CFD correction
   Bool_t log_file = false;
   Bool_t silent = false;
   Bool_t legacy = false;
+  OutputFormat output_format = OutputFormat::TTREE; // Default to TTree output
+  Bool_t write_traces = true; // Keep the ADC traces in the output
+  Bool_t spill_tree = true; // Write the bookkeeping of every spill to the '<tree_name>_spills' tree
+  Bool_t split_traces = false; // Write the traces to a separate friend tree/ntuple
+  std::string trace_file; // Optional separate file for the split traces, empty means the output file
+  Bool_t lean_hits = false; // Write DDASFlatEvent/DDASFlatHit instead of DDASRootEvent/DDASRootHit to the TTree
+  size_t log_queue_size = 8192; // Number of messages the async logger can hold before producers block
+  unsigned int log_burst = 10; // Messages per category let through per log interval on the hot path
+  unsigned int log_interval = 30; // Seconds between summaries of suppressed hot path messages
+  std::string metrics_file; // JSON file receiving the per-stage metrics, empty disables it
+  std::string metrics_prom_file; // Prometheus textfile receiving the per-stage metrics, empty disables it
+  unsigned int metrics_interval = 10; // Seconds between metrics snapshots, 0 only writes them at the end
+  std::string trace_timeline_file; // Chrome trace-event JSON timeline of the conversion, empty disables tracing
+  size_t sort_memory_mb = 0; // Memory limit of the external sort, 0 sorts all hits in memory
+  std::string sort_scratch; // Directory for the sorted runs of the external sort, empty uses the system temporary directory
+  size_t parse_block_words = 0; // Parse() returns once this many raw words are buffered, 0 parses all input files in one call
+  Bool_t stream_sort = false; // Time order the hits spill by spill with a bounded reorder buffer instead of sorting all of them
+  Double_t reorder_horizon = 1.0e9; // Lateness in nanoseconds the streaming time ordering still puts in order
+  Bool_t follow = false; // Keep reading the input file while the DAQ writes it, until its double EOF buffer
+  unsigned int follow_timeout = 0; // Seconds without the followed file growing before giving up, 0 waits forever
+  unsigned int follow_save = 10; // Seconds between saves of the output file while following
+  Bool_t batch = false; // Convert every input file into its own output file instead of concatenating them
+  unsigned int jobs = 1; // Runs of a batch converted at the same time, 0 uses one per hardware thread
+  std::string output_dir; // Directory for the output files of a batch or the watcher, empty writes each next to its input
+  std::string watch_dir; // Directory the watcher converts finished runs from, empty disables the watcher
+  unsigned int watch_interval = 10; // Seconds between scans of the watch directory
+  std::string state_file; // Files the watcher started or finished converting, they are never converted again
+  unsigned int read_ahead = 4; // Blocks of the input file read ahead at the same time by the pread workers, 0 reads synchronously
+  size_t read_block_kb = 4096; // Size of a read ahead block in KB
+  unsigned int decompress_threads = 0; // Workers decompressing a zstd or xz compressed input file, 0 uses one per hardware thread
+  Bool_t histos = false; // Fill energy, rate and multiplicity spectra while building and write them to histos/ in the output file
+  unsigned int histo_energy_bins = 4096; // Bins of the raw energy spectra over the 16 bit range
+  Double_t histo_rate_bin = 1.0; // Seconds per bin of the hit rate histograms
+  std::vector<ChannelID> dt_references; // Channels the builder histograms the time differences of all other channels to
+  Double_t dt_range = 5000; // Largest time difference to a reference channel in nanoseconds
+  Double_t dt_bin = 2; // Bin width of the time difference histograms in nanoseconds
+  std::vector<std::string> filters; // Expressions a built event has to pass to be written, see EventFilter
+  Bool_t scan = false; // Only collect the run statistics from the raw hit words, no output file is written
+  std::string scan_json; // JSON file receiving the run statistics of the scan, empty only logs them
+  std::string digest_file; // Per-event digest stream of the built events for comparing conversions, empty disables it
+  Bool_t digest_output = false; // Take the digest from the written output file instead of the built events
 };
 }
 
@@ -0,0 +1,65 @@
+#ifndef __INPUT_STREAM_HPP__
+#define __INPUT_STREAM_HPP__
+
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <string>
+
+class StreamDecoder;
+
+/// @addtogroup Decoding
+/// @{
+/// @class InputStream
+/// @brief Binary input stream over a plain, zstd or xz compressed LDF file, a drop-in for the std::ifstream of the translator
+/// @details
+/// open() looks at the magic bytes of the file, not its name. A plain file is read ahead in large
+/// blocks by a pool of pread workers, or through a std::filebuf when read ahead is off. A
+/// compressed file is decoded as a stream by a producer thread running ahead of the reader, so
+/// the LDF file is never written out: zstd frames that fit in memory (files written by pzstd) are
+/// decompressed in parallel by up to decompress_threads workers and handed over in order, one big
+/// frame is decompressed in the producer itself. xz files are decoded with the multithreaded
+/// liblzma decoder, which works on the blocks of files written with xz -T.
+///
+/// A read ahead or decompressed stream can only be read forwards: seeking ahead decodes and skips, seeking
+/// back is only possible into the previous decoded block, which covers the few words the
+/// translator steps back after a look ahead. Decoding errors are thrown as std::runtime_error
+/// out of the read that hits them.
+class InputStream : public std::istream{
+	public:
+		enum class Compression{
+			NONE,
+			ZSTD,
+			XZ
+		};
+
+		InputStream();
+		~InputStream();
+
+		void open(const std::string&,std::ios_base::openmode = std::ios_base::in | std::ios_base::binary);
+		bool is_open() const;
+		void close();
+
+		/// Workers decompressing zstd frames and xz blocks, 0 uses one per hardware thread
+		void SetDecompressThreads(unsigned int threads) { this->DecompressThreads = threads; }
+		/// Blocks of a plain file read ahead at the same time and their size in bytes, a depth of 0 reads synchronously
+		void SetReadAhead(unsigned int depth,size_t blocksize) { this->ReadAheadDepth = depth; this->ReadBlockSize = blocksize; }
+		Compression GetCompression() const { return this->FileCompression; }
+
+		/// Compression of a file from its magic bytes
+		static Compression Detect(const std::string&);
+		static const char* CompressionName(Compression);
+		/// Compression formats this build can decode
+		static bool IsSupported(Compression);
+
+	private:
+		std::filebuf File;
+		std::unique_ptr<StreamDecoder> Decoder; // nullptr for a plain file
+		Compression FileCompression;
+		unsigned int DecompressThreads;
+		unsigned int ReadAheadDepth;
+		size_t ReadBlockSize;
+};
+/// @}
+
+#endif
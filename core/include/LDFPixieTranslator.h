@@ -23,6 +23,8 @@ class LDFPixieTranslator : public Translator{
 		LDFPixieTranslator(const std::string&,const std::string&, const ldf2root::CmdOptions& cmdopts);
 		~LDFPixieTranslator();
 		Translator::TRANSLATORSTATE Parse(std::vector<uint32_t>* RawData);
+		Translator::ParseStats GetParseStats() const override;
+		std::vector<Translator::SpillInfo> TakeSpills() override;
 
 		enum HRIBF_TYPES{
 			HEAD = 1145128264,
@@ -86,6 +88,8 @@ class LDFPixieTranslator : public Translator{
 		unsigned int buffersRead;
 		
 		HRIBF_DIR_Buffer CurrDirBuff;
+		/// Open the next input file and parse its DIR and HEAD buffers, returns false when there is nothing left to read
+		bool StartNextFile();
 		int ParseDirBuffer();
 
 		HRIBF_HEAD_Buffer CurrHeadBuff;
@@ -116,6 +120,16 @@ class LDFPixieTranslator : public Translator{
 
 		uint64_t CurrSpillID;
 
+		/// Start the bookkeeping of the next spill
+		void BeginSpill();
+		/// Finish the bookkeeping of the spill just parsed
+		void EndSpill(uint32_t,bool);
+		bool KeepSpills; // collect the spill bookkeeping, only done for the spill tree
+		uint64_t SpillsRead;
+		uint64_t MissingBefore; // missing chunks before the current spill
+		Translator::SpillInfo CurrSpill;
+		std::vector<Translator::SpillInfo> Spills; // finished since the last TakeSpills()
+
 		ldf2root::CmdOptions CmdOpts;
 		void TransferRawDataWords(std::vector<uint32_t>* rawData, uint32_t& buffpos);
 
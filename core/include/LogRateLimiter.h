@@ -0,0 +1,57 @@
+#ifndef __LOG_RATE_LIMITER_HPP__
+#define __LOG_RATE_LIMITER_HPP__
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+
+#include <spdlog/spdlog.h>
+
+/// @class LogRateLimiter
+/// @brief Per-category throttle for log messages emitted on the hot path.
+/// @details
+/// Every call to Allow() counts one message of the given category. At most Burst messages of a
+/// category are let through per report interval, the rest are only counted. When a category's
+/// interval runs out, a single summary line with the number of suppressed messages is logged
+/// instead. The summary is logged by the next Allow() of the category or by Tick(), which the
+/// owner calls at a regular point (every spill) so a burst that stops is still summarised.
+/// Report() logs the totals of every category, it is meant for the end of a run.
+///
+/// Categories are keyed by string_view and are expected to be string literals. The class is not
+/// thread safe, each thread (translator) should own its own instance.
+class LogRateLimiter{
+	public:
+		LogRateLimiter(std::shared_ptr<spdlog::logger>,uint32_t,std::chrono::seconds);
+		~LogRateLimiter() = default;
+
+		/// @return true if a message of this category should be logged now
+		bool Allow(std::string_view);
+		/// Log the summary of every category whose interval ran out
+		void Tick();
+		/// Log the per-category totals
+		void Report();
+
+		void SetLogger(std::shared_ptr<spdlog::logger> logger) { this->console = logger; }
+		void SetLimits(uint32_t burst,std::chrono::seconds interval) { this->Burst = burst; this->Interval = interval; }
+
+	private:
+		struct CategoryState{
+			std::chrono::steady_clock::time_point WindowStart;
+			uint32_t AllowedInWindow = 0;
+			uint64_t SuppressedInWindow = 0;
+			uint64_t Total = 0;
+			uint64_t TotalSuppressed = 0;
+		};
+
+		/// Log the summary of the interval of a category and start the next one
+		void EndWindow(std::string_view,CategoryState&,std::chrono::steady_clock::time_point);
+
+		std::shared_ptr<spdlog::logger> console;
+		uint32_t Burst;
+		std::chrono::seconds Interval;
+		std::unordered_map<std::string_view,CategoryState> Categories;
+};
+
+#endif
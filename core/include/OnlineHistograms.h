@@ -0,0 +1,80 @@
+#ifndef __ONLINE_HISTOGRAMS_HPP__
+#define __ONLINE_HISTOGRAMS_HPP__
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <spdlog/common.h>
+#include <spdlog/spdlog.h>
+
+#include "InputParser.h"
+
+class TDirectory;
+class DDASRootEvent;
+
+/// @addtogroup Output
+/// @{
+/// @class OnlineHistograms
+/// @brief Standard spectra filled from the built events during the conversion, written to the histos/ directory of the output file
+/// @details
+/// - histos/energy/energy_c<crate>_s<slot>_ch<chan> : raw energy of every channel with hits
+/// - histos/rate/rate_c<crate>_s<slot> : hits per second of every module against the run time,
+///   histos/rate/rate_total : the same for all modules
+/// - histos/multiplicity : hits per built event
+///
+/// The spectra are plain counter arrays while they are filled, owned by the thread building the
+/// events of the run, so filling takes no lock and no ROOT call. They become TH1Ds only when they
+/// are written at the end. The rate histograms grow with the run, their time axis starts at the
+/// first hit and ends after MAX_RATE_BINS bins (1 MB of counters per module), later hits are
+/// counted in the overflow bin and reported when the histograms are written.
+class OnlineHistograms{
+	public:
+		OnlineHistograms(const std::string&,const ldf2root::CmdOptions&);
+
+		/// Count the hits of a built event, before the writer gets it
+		void Fill(DDASRootEvent&);
+		/// Write the spectra into histos/ of the directory, normally the output file
+		void Write(TDirectory*);
+
+		uint64_t GetHits() const { return this->Hits; }
+
+	private:
+		// Spectra are indexed by crate*256 + slot*16 + channel, the rates by crate*16 + slot
+		static const size_t MAX_CHANNELS = 4096;
+		static const size_t MAX_MODULES = 256;
+		// Time and multiplicity beyond these go to the overflow bin
+		static const size_t MAX_RATE_BINS = 1 << 17;
+		static const size_t MAX_MULTIPLICITY = 4096;
+
+		struct Counts{
+			std::vector<uint64_t> Bins;
+			uint64_t Underflow = 0;
+			uint64_t Overflow = 0;
+			uint64_t Entries = 0;
+		};
+		/// Count a value in a spectrum whose bins are added as they are needed
+		static void Count(Counts&,int64_t,size_t);
+		/// Write one spectrum as a TH1D, returns false if it is empty
+		static bool WriteHistogram(TDirectory*,const Counts&,const std::string&,const std::string&,size_t,double,double);
+
+		std::string LogName;
+		uint32_t EnergyBins;
+		uint64_t RateBinNs;
+
+		std::array<std::unique_ptr<Counts>,MAX_CHANNELS> Energy;
+		std::array<Counts,MAX_MODULES> ModuleRate;
+		Counts TotalRate;
+		Counts Multiplicity;
+
+		bool HaveStart;
+		uint64_t StartTime; // coarse time of the first hit in nanoseconds
+		uint64_t Hits;
+
+		std::shared_ptr<spdlog::logger> console;
+};
+/// @}
+
+#endif
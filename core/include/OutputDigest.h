@@ -0,0 +1,44 @@
+#ifndef __OUTPUT_DIGEST_HPP__
+#define __OUTPUT_DIGEST_HPP__
+
+#include <memory>
+#include <string>
+
+#include <spdlog/common.h>
+#include <spdlog/spdlog.h>
+
+#include "InputParser.h"
+
+class EventDigest;
+
+/// @addtogroup Verification
+/// @{
+/// @class OutputDigest
+/// @brief Streams the events of a closed output file into an EventDigest
+/// @details
+/// The tree or ntuple written by DataWriter is read back entry by entry, with the traces taken
+/// from the split trace tree/ntuple (in the output or the --trace-file) when there is one. Each
+/// entry is added to the digest as it is read, so memory use does not depend on the size of the
+/// output. Every layout (DDASRootEvent, lean DDASFlatEvent, RNTuple) gives the same digest for the
+/// same hits, so a difference between two conversions names the output path that diverged.
+class OutputDigest{
+	public:
+		OutputDigest(const std::string&,const ldf2root::CmdOptions&);
+
+		/// Add every event of the output file to the digest, returns the number of events read
+		uint64_t Read(EventDigest&);
+
+	private:
+		uint64_t ReadTree(EventDigest&);
+		uint64_t ReadNTuple(EventDigest&);
+		/// File holding the split traces, empty without them
+		std::string GetTraceFileName() const;
+
+		std::string LogName;
+		ldf2root::CmdOptions CmdOpts;
+
+		std::shared_ptr<spdlog::logger> console;
+};
+/// @}
+
+#endif
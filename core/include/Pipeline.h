@@ -0,0 +1,31 @@
+#ifndef __PIPELINE_HPP__
+#define __PIPELINE_HPP__
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DDASRootHit.h"
+#include "InputParser.h"
+
+typedef std::vector<std::unique_ptr<DDASRootHit>> UnpackedHitVector;
+typedef std::vector<uint32_t> RawDataVector;
+
+namespace ldf2root{
+	/// Unpack the raw hit words produced by the translator into DDASRootHits, the raw words are cleared afterwards
+	std::chrono::duration<double> UnpackEvents(RawDataVector*,UnpackedHitVector*);
+	/// Sort hits by time, hits with the same time keep their order
+	std::chrono::duration<double> SortEvents(UnpackedHitVector*);
+	/// Escape a string for use inside a JSON string literal (quotes, backslashes and control characters)
+	std::string EscapeJSON(const std::string&);
+	/// Convert the input files of one run into its output file, logging through the named logger.
+	/// The logger has to be registered, returns 0 on success and 1 if the conversion failed.
+	int RunConversion(const CmdOptions&,const std::string&);
+	/// Scan the input files of one run for its statistics without unpacking the hits or writing an output file.
+	/// The logger has to be registered, returns 0 on success and 1 if the scan failed.
+	int RunScan(const CmdOptions&,const std::string&);
+}
+
+#endif
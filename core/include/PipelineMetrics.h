@@ -0,0 +1,108 @@
+#ifndef __PIPELINE_METRICS_HPP__
+#define __PIPELINE_METRICS_HPP__
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <spdlog/common.h>
+#include <spdlog/spdlog.h>
+
+#include "InputParser.h"
+
+/// @addtogroup Metrics
+/// @{
+/// @class PipelineMetrics
+/// @brief Per-stage counters of the conversion pipeline, exported as JSON and Prometheus textfile
+/// @details
+/// Every stage (parse, unpack, sort, build, write) has counters for the bytes, hits and events it
+/// consumed and produced, the time it spent working (busy) and waiting for input (stall), and the
+/// depth of its input queue. The counters are atomics so the stages can update them from the
+/// processing thread while a background thread writes a snapshot every metrics_interval seconds.
+/// Rates are computed over the busy time of the stage, so they are the throughput of the stage
+/// itself rather than of the whole pipeline.
+class PipelineMetrics{
+	public:
+		enum STAGE{
+			PARSE,
+			UNPACK,
+			SORT,
+			BUILD,
+			WRITE,
+			NUMSTAGES
+		};
+
+		PipelineMetrics(const std::string&,const ldf2root::CmdOptions&);
+		~PipelineMetrics();
+
+		/// Mark the start of the pipeline and start the periodic writer if an interval is set
+		void Start();
+		/// Stop the periodic writer, write the final snapshot and log the per-stage summary
+		void Stop();
+
+		void AddBytesIn(STAGE stage,uint64_t n) { this->Stages[stage].BytesIn.fetch_add(n,std::memory_order_relaxed); }
+		void AddBytesOut(STAGE stage,uint64_t n) { this->Stages[stage].BytesOut.fetch_add(n,std::memory_order_relaxed); }
+		void AddHitsIn(STAGE stage,uint64_t n) { this->Stages[stage].HitsIn.fetch_add(n,std::memory_order_relaxed); }
+		void AddHitsOut(STAGE stage,uint64_t n) { this->Stages[stage].HitsOut.fetch_add(n,std::memory_order_relaxed); }
+		void AddEventsIn(STAGE stage,uint64_t n) { this->Stages[stage].EventsIn.fetch_add(n,std::memory_order_relaxed); }
+		void AddEventsOut(STAGE stage,uint64_t n) { this->Stages[stage].EventsOut.fetch_add(n,std::memory_order_relaxed); }
+		void AddBusyTime(STAGE,std::chrono::duration<double>);
+		void AddStallTime(STAGE,std::chrono::duration<double>);
+		/// Set the number of items waiting in front of the stage, the peak is kept
+		void SetQueueDepth(STAGE,uint64_t);
+		/// Record the stage becoming active, the time since Start() is counted as stall the first time
+		void StageStarted(STAGE);
+
+		/// Write the current snapshot to the JSON and Prometheus files
+		void Write(bool final = false);
+
+		static const char* StageName(STAGE);
+		/// Peak resident set size of the process in bytes
+		static uint64_t PeakRSS();
+
+	private:
+		struct StageCounters{
+			std::atomic<uint64_t> BytesIn{0};
+			std::atomic<uint64_t> BytesOut{0};
+			std::atomic<uint64_t> HitsIn{0};
+			std::atomic<uint64_t> HitsOut{0};
+			std::atomic<uint64_t> EventsIn{0};
+			std::atomic<uint64_t> EventsOut{0};
+			std::atomic<uint64_t> BusyNs{0};
+			std::atomic<uint64_t> StallNs{0};
+			std::atomic<uint64_t> QueueDepth{0};
+			std::atomic<uint64_t> QueueDepthPeak{0};
+			std::atomic<bool> Started{false};
+		};
+
+		void WriteJSON(const std::string&,bool) const;
+		void WritePrometheus(const std::string&) const;
+		void PeriodicWriter();
+
+		std::string LogName;
+		std::string JSONFile;
+		std::string PromFile;
+		std::string OutputFile;
+		std::chrono::seconds Interval;
+		bool SharedProcess; // concurrent runs share the process, its peak RSS is not the peak of this run
+
+		std::array<StageCounters,NUMSTAGES> Stages;
+		std::chrono::steady_clock::time_point StartTime;
+		std::atomic<bool> Running;
+
+		std::mutex WriteMutex;
+		std::mutex WakeMutex;
+		std::condition_variable Wake;
+		std::thread WriterThread;
+
+		std::shared_ptr<spdlog::logger> console;
+};
+/// @}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef __RNTUPLE_EVENT_WRITER_HPP__
+#define __RNTUPLE_EVENT_WRITER_HPP__
+
+#ifdef LDF2ROOT_HAS_RNTUPLE
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <RVersion.h>
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleWriter.hxx>
+
+#include "DDASFlatHit.h"
+#include "EventWriter.h"
+#include "InputParser.h"
+
+/// RNTuple classes left ROOT::Experimental with ROOT 6.36
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,36,0)
+namespace RNTupleNS = ROOT;
+#else
+namespace RNTupleNS = ROOT::Experimental;
+#endif
+
+/// Writes each DDASRootEvent as one entry of an RNTuple.
+/// The entry holds a collection "hits" of DDASFlatHit and, unless traces are disabled,
+/// a collection "traces" which holds the trace of hits[i] at traces[i].
+/// With split traces the "traces" collection moves to a second RNTuple "<name>_traces" with
+/// the same number of entries, plus an "event" field holding the entry number.
+class RNTupleEventWriter : public EventWriter{
+	public:
+		RNTupleEventWriter(const std::string&,const std::string&,const ldf2root::CmdOptions&);
+		~RNTupleEventWriter();
+		bool Initialize(TFile*,TFile*) override;
+		void Fill(DDASRootEvent&) override;
+		void Finalize() override;
+		void Save() override;
+
+	private:
+		std::unique_ptr<RNTupleNS::RNTupleWriter> Writer;
+		std::shared_ptr<std::vector<DDASFlatHit>> Hits;
+		std::shared_ptr<std::vector<std::vector<uint16_t>>> Traces;
+
+		std::unique_ptr<RNTupleNS::RNTupleWriter> TraceWriter;
+		std::shared_ptr<uint64_t> TraceEventID;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef __RUN_SCANNER_HPP__
+#define __RUN_SCANNER_HPP__
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <spdlog/common.h>
+#include <spdlog/spdlog.h>
+
+#include "InputParser.h"
+#include "Pipeline.h"
+#include "Translator.h"
+
+/// @addtogroup Metrics
+/// @{
+/// @class RunScanner
+/// @brief Quick look statistics of a run straight from the raw hit words, for --scan
+/// @details
+/// Only the module word and the four header words of every hit are decoded: the module and
+/// channel, the finish code (pile up), the coarse timestamp, the out of range flag and the trace
+/// length. No DDASRootHit is created and nothing is sorted or built, so a scan runs at about the
+/// speed the translator reassembles the spills. The summary adds the spill and chunk counters
+/// and the run header of the translator, it is logged and optionally written as JSON.
+class RunScanner{
+	public:
+		RunScanner(const std::string&,const ldf2root::CmdOptions&);
+
+		/// Count the hits of a block of raw hit words, the block is cleared
+		void AddBlock(RawDataVector*);
+		/// Take the translator counters and the bytes read at the end of the input
+		void Finish(const Translator::ParseStats&,uint64_t);
+		/// Log the summary
+		void Report() const;
+		/// Write the summary as JSON, replaced atomically
+		void WriteJSON(const std::string&) const;
+
+		uint64_t GetHits() const { return this->TotalHits; }
+
+	private:
+		struct ModuleStats{
+			uint64_t Hits = 0;
+			uint64_t PileUps = 0;
+			uint64_t OutOfRange = 0;
+			uint64_t TraceHits = 0;
+			uint64_t TraceSamples = 0;
+			uint64_t Backwards = 0; // hits earlier than the previous hit of the module
+			uint64_t PrevTime = 0; // time of the previous hit of the module
+			uint64_t FirstTime = 0; // earliest hit time, not the time of the first hit
+			uint64_t LastTime = 0; // latest hit time, not the time of the last hit
+			uint32_t MSPS = 0;
+			std::array<uint64_t,16> ChannelHits = {};
+		};
+		// Indexed by crate*16 + slot
+		static const size_t MAX_MODULES = 256;
+
+		/// Seconds between the first and the last hit of the run
+		double TimeSpan() const;
+
+		std::string LogName;
+		ldf2root::CmdOptions CmdOpts;
+		std::chrono::steady_clock::time_point StartTime;
+		double WallSeconds;
+
+		std::array<ModuleStats,MAX_MODULES> Modules;
+		uint64_t TotalHits;
+		uint64_t CorruptWords; // raw words skipped after a hit with an impossible length
+		uint64_t FirstTime;
+		uint64_t LastTime;
+
+		Translator::ParseStats Stats;
+		uint64_t BytesRead;
+
+		std::shared_ptr<spdlog::logger> console;
+};
+/// @}
+
+#endif
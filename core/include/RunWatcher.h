@@ -0,0 +1,99 @@
+#ifndef __RUN_WATCHER_HPP__
+#define __RUN_WATCHER_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include <spdlog/common.h>
+#include <spdlog/spdlog.h>
+
+#include "InputParser.h"
+
+/// @addtogroup Scheduling
+/// @{
+/// @class RunWatcher
+/// @brief Daemon converting every finished LDF file that shows up in a directory
+/// @details
+/// The watch directory is scanned every watch_interval seconds, and on Linux whenever inotify
+/// reports a file closed after writing or moved into it. A file is finished when it ends with the
+/// double ENDFILE buffer of a complete run, or when it was closed for writing (or moved in) and
+/// has not grown since. Finished files are queued for a pool of `jobs` workers which call the
+/// conversion function. The queue holds at most two files per worker, the rest stay on disk and
+/// are picked up by later scans, so the backlog is visible in the log instead of in memory.
+///
+/// Every file is converted at most once, also across restarts. A START line is appended to the
+/// state file before a conversion begins and a DONE line with its status once it ends. Files in
+/// the state file are skipped. A file whose conversion was interrupted has no DONE line, it is
+/// reported and not converted again.
+class RunWatcher{
+	public:
+		/// Converts one input file, returns 0 on success
+		using ConvertFunction = std::function<int(const std::string&)>;
+
+		RunWatcher(const std::string&,const ldf2root::CmdOptions&,ConvertFunction);
+		~RunWatcher();
+
+		/// Watch and convert until RequestStop(), returns 0 if every conversion succeeded
+		int Run();
+
+		/// Stop the watcher, only touches an atomic flag so it is safe in a signal handler
+		static void RequestStop() { StopRequested.store(true,std::memory_order_relaxed); }
+		/// true if the file ends with the two ENDFILE buffers written at the end of a run
+		static bool HasEndOfRun(const std::filesystem::path&);
+
+	private:
+		struct PendingFile{
+			uintmax_t Size = 0;
+			bool Closed = false; // closed after writing or moved in, at this size
+		};
+
+		void LoadState();
+		void AppendState(const std::string&);
+		void Scan();
+		void WaitForEvents();
+		void Worker(unsigned int);
+
+		std::string LogName;
+		ldf2root::CmdOptions CmdOpts;
+		ConvertFunction Convert;
+		std::filesystem::path WatchDir;
+		std::filesystem::path StateFile;
+		std::chrono::seconds Interval;
+		unsigned int NumWorkers;
+		size_t MaxQueue;
+
+		std::set<std::string> Known; // in the state file or queued
+		std::map<std::string,PendingFile> Pending;
+		size_t Backlog;
+
+		std::mutex QueueMutex;
+		std::condition_variable QueueCV;
+		std::deque<std::string> Queue;
+		bool Stopping;
+
+		std::mutex StateMutex;
+		std::ofstream State;
+
+		std::atomic<uint64_t> Converted;
+		std::atomic<uint64_t> Failed;
+		std::atomic<unsigned int> Busy;
+
+		int InotifyFD;
+		int WatchFD;
+		static std::atomic<bool> StopRequested;
+
+		std::shared_ptr<spdlog::logger> console;
+};
+/// @}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef __TTREE_EVENT_WRITER_HPP__
+#define __TTREE_EVENT_WRITER_HPP__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DDASFlatEvent.h"
+#include "EventWriter.h"
+#include "InputParser.h"
+
+class TTree;
+
+/// Writes each DDASRootEvent as one entry of a TTree, this is the historical ldf2root output.
+/// With split traces the waveforms go to a friend tree "<tree>_traces" instead, whose entry i
+/// holds the traces of the hits of entry i of the main tree, in the same order as the hits.
+/// With lean hits the "rawevents" branch holds a DDASFlatEvent split at level 99 instead of a
+/// DDASRootEvent. Every hit member becomes its own sub-branch, so nothing of TObject or the
+/// DDASRootHit pointers is written per hit.
+class TTreeEventWriter : public EventWriter{
+	public:
+		TTreeEventWriter(const std::string&,const std::string&,const ldf2root::CmdOptions&);
+		~TTreeEventWriter();
+		bool Initialize(TFile*,TFile*) override;
+		void Fill(DDASRootEvent&) override;
+		void Finalize() override;
+		void Save() override;
+
+	private:
+		TTree* OutputTree;
+		DDASRootEvent* CurrEvent;
+		DDASFlatEvent LeanEvent;
+
+		TTree* TraceTree;
+		uint64_t TraceEventID;
+		std::vector<std::vector<uint16_t>> TraceBuffer;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef __TIME_DIFFERENCES_HPP__
+#define __TIME_DIFFERENCES_HPP__
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <spdlog/common.h>
+#include <spdlog/spdlog.h>
+
+#include "InputParser.h"
+
+class TDirectory;
+class DDASRootHit;
+
+/// @addtogroup Building
+/// @{
+/// @class TimeDifferences
+/// @brief Time differences between reference channels and every other channel, independent of the build window
+/// @details
+/// The event builder hands over every hit in time order before it is put in an event. Each pair
+/// of a reference hit and any other hit less than dt_range apart is counted at
+/// t(other) - t(reference), so the histograms show what every build window up to dt_range would
+/// capture and how well the channels are aligned, from a single conversion. They are written to
+/// histos/dt/ref_c<crate>_s<slot>_ch<chan>/ as one histogram per channel and one over all channels.
+///
+/// The hits within dt_range of the newest one are kept in a short history, so the cost per hit is
+/// the number of hits in that range, which is small at the rates and ranges this is meant for.
+class TimeDifferences{
+	public:
+		TimeDifferences(const std::string&,const ldf2root::CmdOptions&);
+
+		/// Count the pairs of the next hit in time order with the hits before it
+		void AddHit(const DDASRootHit&);
+		/// Write the histograms into histos/dt of the directory, normally the output file
+		void Write(TDirectory*);
+
+		uint64_t GetPairs() const { return this->Pairs; }
+
+	private:
+		// Channels are indexed by crate*256 + slot*16 + channel
+		static const size_t MAX_CHANNELS = 4096;
+
+		struct RecentHit{
+			double Time;
+			uint16_t Channel;
+			int Reference; // index into References, -1 for other channels
+		};
+		struct ReferenceCounts{
+			ldf2root::ChannelID Channel;
+			std::array<std::unique_ptr<std::vector<uint64_t>>,MAX_CHANNELS> Pairs;
+			std::vector<uint64_t> All;
+		};
+
+		/// Count the pair of a reference hit and another hit dt nanoseconds after it
+		void Count(ReferenceCounts&,uint16_t,double);
+
+		std::string LogName;
+		double Range;
+		double BinWidth;
+		size_t NumBins;
+
+		std::vector<ReferenceCounts> References;
+		std::array<int,MAX_CHANNELS> ReferenceIndex; // -1 if the channel is not a reference
+		std::deque<RecentHit> Recent;
+		uint64_t Pairs;
+
+		std::shared_ptr<spdlog::logger> console;
+};
+/// @}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef __TRACE_RECORDER_HPP__
+#define __TRACE_RECORDER_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// @addtogroup Metrics
+/// @{
+/// @class TraceRecorder
+/// @brief Collects timed spans per thread and writes them as a Chrome trace-event JSON file
+/// @details
+/// The file can be opened in chrome://tracing or https://ui.perfetto.dev. Every thread records
+/// into its own buffer, so recording a span is two clock reads and a push_back without any locking.
+/// While the recorder is disabled (the default) a span costs a single relaxed atomic load.
+///
+/// Span names, categories and argument keys are stored as pointers and have to be string literals.
+/// Each thread keeps at most MaxEventsPerThread spans, further spans are counted as dropped.
+class TraceRecorder{
+	public:
+		struct Event{
+			const char* Name;
+			const char* Category;
+			int64_t StartNs;
+			int64_t DurationNs;
+			const char* ArgKey;
+			int64_t ArgValue;
+		};
+
+		static TraceRecorder& Instance();
+
+		void Enable() { this->Enabled.store(true,std::memory_order_relaxed); }
+		bool IsEnabled() const { return this->Enabled.load(std::memory_order_relaxed); }
+
+		/// Nanoseconds since the recorder was created
+		int64_t Now() const { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->Epoch).count(); }
+		void Record(const char*,const char*,int64_t,int64_t,const char* argkey = nullptr,int64_t argvalue = 0);
+		/// Name shown for the calling thread in the timeline
+		void SetThreadName(const std::string&);
+
+		/// Write every recorded span, call once all recording threads are done
+		void Write(const std::string&);
+
+		static constexpr size_t MaxEventsPerThread = 4000000;
+
+	private:
+		TraceRecorder();
+
+		struct ThreadBuffer{
+			uint32_t ThreadID;
+			std::string ThreadName;
+			std::vector<Event> Events;
+			uint64_t Dropped;
+		};
+		ThreadBuffer& LocalBuffer();
+
+		std::atomic<bool> Enabled;
+		std::chrono::steady_clock::time_point Epoch;
+		std::mutex Mutex;
+		std::vector<std::shared_ptr<ThreadBuffer>> Buffers;
+};
+
+/// @class TraceSpan
+/// @brief RAII span, recorded from construction to destruction when the TraceRecorder is enabled
+class TraceSpan{
+	public:
+		TraceSpan(const char* name,const char* category){
+			this->Active = TraceRecorder::Instance().IsEnabled();
+			this->Name = name;
+			this->Category = category;
+			this->ArgKey = nullptr;
+			this->ArgValue = 0;
+			this->Start = this->Active ? TraceRecorder::Instance().Now() : 0;
+		}
+		~TraceSpan(){
+			if( this->Active ){
+				auto& recorder = TraceRecorder::Instance();
+				recorder.Record(this->Name,this->Category,this->Start,recorder.Now(),this->ArgKey,this->ArgValue);
+			}
+		}
+		TraceSpan(const TraceSpan&) = delete;
+		TraceSpan& operator=(const TraceSpan&) = delete;
+
+		/// Attach a single numeric argument shown with the span
+		void SetArg(const char* key,int64_t value) { this->ArgKey = key; this->ArgValue = value; }
+		/// Rename the span, e.g. once it is known what the span turned out to be
+		void SetName(const char* name) { this->Name = name; }
+		bool IsActive() const { return this->Active; }
+
+	private:
+		const char* Name;
+		const char* Category;
+		const char* ArgKey;
+		int64_t ArgValue;
+		int64_t Start;
+		bool Active;
+};
+/// @}
+
+#endif
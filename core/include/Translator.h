@@ -1,6 +1,8 @@
 #ifndef __TRANSLATOR_HPP__
 #define __TRANSLATOR_HPP__
 
+#include <array>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <fstream>
@@ -13,6 +15,10 @@
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 
+#include "InputStream.h"
+#include "LogRateLimiter.h"
+
+class FileFollower;
 
 /// @addtogroup Decoding
 /// @{
@@ -24,6 +30,37 @@ class Translator{
 			COMPLETE,
 			UNKNOWN
 		};
+		/// Spill reassembly counters and run header of the input read so far
+		struct ParseStats{
+			uint64_t Spills = 0;
+			uint64_t GoodChunks = 0;
+			uint64_t MissingChunks = 0;
+			uint32_t RunNumber = 0;
+			std::string RunTitle;
+			std::string RunDate;
+		};
+		/// Bookkeeping of one spill read from the input
+		struct SpillInfo{
+			enum FlagBits : uint32_t{
+				INCOMPLETE = 1 << 0,     // the first chunk was not chunk 0
+				MISSING_CHUNKS = 1 << 1, // chunks missing or out of order, the rest of the spill was skipped
+				BAD_CHUNK = 1 << 2,      // a chunk with an invalid size
+				BAD_FOOTER = 1 << 3,     // the footer chunk has the wrong size
+				NOT_UNPACKED = 1 << 4,   // the words were left for the next spill instead of being unpacked
+				UNEXPECTED_VSN = 1 << 5  // a module number that is neither a Pixie module nor the end of readout
+			};
+			uint64_t Spill = 0;  // number of the spill in the input, counting the ones with errors
+			uint32_t File = 0;   // index of the input file
+			uint64_t Offset = 0; // byte offset of the first chunk in the (decompressed) file
+			uint32_t Words = 0;
+			uint32_t Chunks = 0;
+			uint32_t MissingChunks = 0;
+			uint32_t Flags = 0;
+			uint64_t Hits = 0;
+			uint64_t FirstTime = 0; // earliest and latest coarse timestamp of the hits in ns
+			uint64_t LastTime = 0;
+			std::array<uint32_t,256> ModuleHits{}; // indexed by crate*16 + slot
+		};
 		Translator(const std::string&,const std::string&);
 		virtual ~Translator();
 		virtual bool AddFile(const std::string&);
@@ -31,13 +68,19 @@ class Translator{
 		virtual void FinalizeFiles();
 		virtual bool OpenNextFile();
 
+		uint64_t GetBytesRead() const { return this->BytesRead; }
+		/// Only the translators that reassemble spills fill this in
+		virtual ParseStats GetParseStats() const { return ParseStats(); }
+		/// Hand over the spills finished since the last call, only the translators that reassemble spills fill them in
+		virtual std::vector<SpillInfo> TakeSpills() { return {}; }
+
 	protected:
 		std::string LogName;
 		std::string TranslatorName;
 
 		std::vector<std::string> InputFiles;
 		std::vector<int> FileSizes;
-		std::ifstream CurrentFile;
+		InputStream CurrentFile; // plain, zstd or xz compressed
 		size_t NumTotalFiles;
 		size_t NumFilesRemaining;
 		size_t CurrentFileIndex;
@@ -48,8 +91,17 @@ class Translator{
 		bool LastReadEvtWithin;
 
 		std::shared_ptr<spdlog::logger> console;
+		LogRateLimiter LogLimiter;
 
 		uint64_t CurrExtTS;
+		uint64_t BytesRead;
+
+		/// Waits for the input file to grow in follow mode, nullptr when the input files are complete
+		std::unique_ptr<FileFollower> Follower;
+		/// Make sure this many bytes past the read position are in the current file, returns false if following stopped
+		bool WaitForData(uint64_t);
+		/// Log the compression of the file just opened, throws if it can not be followed
+		void CheckCompression();
 };
 /// @}
 
@@ -0,0 +1,215 @@
+#ifndef __WINDOW_ENGINE_HPP__
+#define __WINDOW_ENGINE_HPP__
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+#include "DDASRootHit.h"
+#include "EventBuilder.h"
+#include "InputParser.h"
+#include "PipelineMetrics.h"
+#include "TimeDifferences.h"
+
+/// @addtogroup Building
+/// @{
+
+/// Time representations the build windows are compared in
+namespace windowtime{
+	/// Hit time with the CFD correction as the exact fixed point number, see DDASHit::getFixedTime(),
+	/// intervals are in 2^-14 ns
+	struct CFD{
+		using Type = DDASRootHit::FixedTime;
+		using Interval = int64_t;
+		static Type Of(const DDASRootHit& hit) { return hit.getFixedTime(); }
+		static Interval FromNs(double ns) { return DDASRootHit::toFixedInterval(ns); }
+		static Interval Distance(Type a,Type b) { return a > b ? a - b : b - a; }
+	};
+	/// Integer coarse timestamp in nanoseconds, without the CFD correction, like the NSCLDAQ event builder
+	struct Coarse{
+		using Type = int64_t;
+		using Interval = int64_t;
+		static Type Of(const DDASRootHit& hit) { return static_cast<Type>(hit.getCoarseTime()); }
+		static Interval FromNs(double ns) { return std::llround(ns); }
+		static Interval Distance(Type a,Type b) { return a > b ? a - b : b - a; }
+	};
+}
+
+/// Window policies, each decides where its events end. The engine E provides HasEvent(),
+/// Append() and Emit(), a policy only keeps the times it needs.
+namespace window{
+	/// Every hit is its own event
+	template<class TimeRep>
+	struct Flat{
+		using Time = TimeRep;
+		explicit Flat(const ldf2root::CmdOptions&) {}
+
+		template<class E>
+		void Add(E& engine,std::unique_ptr<DDASRootHit>& hit,typename Time::Type){
+			engine.Append(hit);
+			engine.Emit();
+		}
+		template<class E>
+		void Flush(E&) {}
+	};
+
+	/// An event holds all hits within the build window of its first hit
+	template<class TimeRep>
+	struct Fixed{
+		using Time = TimeRep;
+		explicit Fixed(const ldf2root::CmdOptions& opts) : Width(Time::FromNs(opts.build_window)) {}
+
+		template<class E>
+		void Add(E& engine,std::unique_ptr<DDASRootHit>& hit,typename Time::Type time){
+			if( engine.HasEvent() and Time::Distance(time,this->Start) >= this->Width ){
+				engine.Emit();
+			}
+			if( not engine.HasEvent() ){
+				this->Start = time;
+			}
+			engine.Append(hit);
+		}
+		template<class E>
+		void Flush(E& engine){
+			if( engine.HasEvent() ){
+				engine.Emit();
+			}
+		}
+
+		typename Time::Interval Width;
+		typename Time::Type Start{};
+	};
+
+	/// An event continues as long as the next hit is within the build window of the previous one
+	template<class TimeRep>
+	struct Rolling{
+		using Time = TimeRep;
+		explicit Rolling(const ldf2root::CmdOptions& opts) : Width(Time::FromNs(opts.build_window)) {}
+
+		template<class E>
+		void Add(E& engine,std::unique_ptr<DDASRootHit>& hit,typename Time::Type time){
+			if( engine.HasEvent() and Time::Distance(time,this->Last) >= this->Width ){
+				engine.Emit();
+			}
+			this->Last = time;
+			engine.Append(hit);
+		}
+		template<class E>
+		void Flush(E& engine){
+			if( engine.HasEvent() ){
+				engine.Emit();
+			}
+		}
+
+		typename Time::Interval Width;
+		typename Time::Type Last{};
+	};
+
+	/// An event holds the hits from the pre window before to the post window after a trigger hit,
+	/// hits in no trigger window are dropped
+	template<class TimeRep>
+	struct Triggered{
+		using Time = TimeRep;
+		explicit Triggered(const ldf2root::CmdOptions& opts) :
+			Pre(Time::FromNs(opts.pre_window)),
+			Post(Time::FromNs(opts.post_window < 0.0 ? opts.build_window : opts.post_window))
+		{
+			this->Triggers.fill(false);
+			for( const auto& trigger : opts.trigger_channels ){
+				this->Triggers[((trigger.crate & 0xF) << 8) | ((trigger.slot & 0xF) << 4) | (trigger.channel & 0xF)] = true;
+			}
+		}
+
+		template<class E>
+		void Add(E& engine,std::unique_ptr<DDASRootHit>& hit,typename Time::Type time){
+			// The open event ends with the first hit past the post window of its trigger
+			if( engine.HasEvent() ){
+				if( time - this->Start <= this->Post ){
+					engine.Append(hit);
+					return;
+				}
+				engine.Emit();
+			}
+			// Hits too old for the pre window of this or any later trigger will never be in an event
+			while( not this->Pending.empty() and time - this->Pending.front().first > this->Pre ){
+				this->Pending.pop_front();
+				engine.Dropped(1);
+			}
+			if( not this->Triggers[((hit->getCrateID() & 0xF) << 8) | ((hit->getSlotID() & 0xF) << 4) | (hit->getChannelID() & 0xF)] ){
+				this->Pending.emplace_back(time,std::move(hit));
+				return;
+			}
+			this->Start = time;
+			for( auto& pending : this->Pending ){
+				engine.Append(pending.second);
+			}
+			this->Pending.clear();
+			engine.Append(hit);
+		}
+		template<class E>
+		void Flush(E& engine){
+			if( engine.HasEvent() ){
+				engine.Emit();
+			}
+			engine.Dropped(this->Pending.size());
+			this->Pending.clear();
+		}
+
+		typename Time::Interval Pre;
+		typename Time::Interval Post;
+		typename Time::Type Start{};
+		std::array<bool,4096> Triggers; // indexed by crate*256 + slot*16 + channel
+		std::deque<std::pair<typename Time::Type,std::unique_ptr<DDASRootHit>>> Pending; // hits that may still fall in the pre window of a trigger
+	};
+}
+
+/// @class WindowEngine
+/// @brief The event building loop of one window policy, compiled for it so the hot loop has no switch or virtual call per hit
+template<class Window>
+class WindowEngine : public EventBuilder::Engine{
+	public:
+		WindowEngine(EventBuilder& builder,const ldf2root::CmdOptions& opts) : Builder(builder), Policy(opts) {}
+
+		void AddHit(std::unique_ptr<DDASRootHit> hit) override{
+			if( this->Builder.Metrics ){
+				this->Builder.Metrics->AddHitsIn(PipelineMetrics::BUILD,1);
+			}
+			this->Add(hit);
+		}
+
+		void AddHits(UnpackedHitVector* hits,size_t begin,size_t end) override{
+			if( this->Builder.Metrics ){
+				this->Builder.Metrics->AddHitsIn(PipelineMetrics::BUILD,end - begin);
+			}
+			auto* data = hits->data();
+			for( size_t ii = begin; ii < end; ++ii ){
+				this->Add(data[ii]);
+			}
+		}
+
+		void Flush() override{
+			this->Policy.Flush(*this);
+		}
+
+		// Called back by the policy
+		bool HasEvent() const { return this->Builder.CurrEvent.GetNHits() > 0; }
+		void Append(std::unique_ptr<DDASRootHit>& hit) { this->Builder.CurrEvent.AddChannelData(hit.release()); }
+		void Emit() { this->Builder.Emit(); }
+		void Dropped(uint64_t n) { this->Builder.HitsDropped += n; }
+
+	private:
+		inline void Add(std::unique_ptr<DDASRootHit>& hit){
+			if( this->Builder.Differences ){
+				this->Builder.Differences->AddHit(*hit);
+			}
+			this->Policy.Add(*this,hit,Window::Time::Of(*hit));
+		}
+
+		EventBuilder& Builder;
+		Window Policy;
+};
+/// @}
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ * @file DDASFlatEvent.cpp
+ * @brief Implementation of the contiguous-storage DDAS event.
+ */
+
+#include <utility>
+
+#include "DDASFlatEvent.h"
+
+DDASFlatEvent::DDASFlatEvent() :
+    m_hits(), m_traces(), m_nHits(0), m_nTraces(0), m_spareHits(),
+    m_spareTraces()
+{}
+
+/**
+ * @details
+ * The scalar data and the sums are copied into the next slot of the hit
+ * vector. A slot left from an earlier event is overwritten and a new slot 
+ * is taken from the spare pool when there is one, so their sum vectors keep 
+ * their storage. When withTrace is set the trace is copied into the slot 
+ * of the same index of the trace vector in the same way, otherwise the 
+ * trace vector is left alone and stays empty.
+ */
+void DDASFlatEvent::AddChannelData(const ddasfmt::DDASHit& hit, bool withTrace)
+{
+    if (m_nHits == m_hits.size()) {
+	if (m_spareHits.empty()) {
+	    m_hits.emplace_back();
+	} else {
+	    m_hits.push_back(std::move(m_spareHits.back()));
+	    m_spareHits.pop_back();
+	}
+    }
+    m_hits[m_nHits++].Set(hit);
+    if (withTrace) {
+	if (m_nTraces == m_traces.size()) {
+	    if (m_spareTraces.empty()) {
+		m_traces.emplace_back();
+	    } else {
+		m_traces.push_back(std::move(m_spareTraces.back()));
+		m_spareTraces.pop_back();
+	    }
+	}
+	const auto& trace = hit.getTrace();
+	m_traces[m_nTraces++].assign(trace.begin(), trace.end());
+    }
+}
+
+/**
+ * @details
+ * If data exists return timestamp of first element in the array. This should 
+ * be the earliest hit of the event. If no data exists, returns 0.
+ */ 
+Double_t DDASFlatEvent::GetFirstTime() const
+{
+    Double_t time = 0;
+    if (m_nHits > 0) { 
+        time = m_hits.front().time;
+    }
+    
+    return time;
+}
+
+/**
+ * @details
+ * If data exists return timestamp of last element in the array. This should 
+ * be the latest hit of the event. If no data exists, returns 0.
+ */
+Double_t DDASFlatEvent::GetLastTime() const
+{
+    Double_t time = 0;
+    if (m_nHits > 0) { 
+        time = m_hits[m_nHits - 1].time;
+    }
+    
+    return time;
+}
+
+/**
+ * @details
+ * Calculate and return the timestamp difference between the last and first
+ * hits. If the event is empty, returns 0.
+ */
+Double_t DDASFlatEvent::GetTimeWidth() const
+{
+    return GetLastTime() - GetFirstTime();
+}
+
+/**
+ * @details
+ * Unlike DDASRootEvent::Reset() there is nothing to delete. The hits and 
+ * traces stay in place and are overwritten by the next AddChannelData().
+ */
+void DDASFlatEvent::Reset()
+{
+    m_nHits = 0;
+    m_nTraces = 0;
+}
+
+/**
+ * @details
+ * The vectors are written whole, so the slots beyond the fill count that 
+ * are left over from a larger event are moved into the spare pools. Moving 
+ * hands over the storage of their sum and trace vectors, only the empty 
+ * shells are destroyed. The slots in use are untouched.
+ */
+void DDASFlatEvent::Trim()
+{
+    while (m_hits.size() > m_nHits) {
+	m_spareHits.push_back(std::move(m_hits.back()));
+	m_hits.pop_back();
+    }
+    while (m_traces.size() > m_nTraces) {
+	m_spareTraces.push_back(std::move(m_traces.back()));
+	m_traces.pop_back();
+    }
+}
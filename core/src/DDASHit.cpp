@@ -83,9 +83,38 @@ ddasfmt::DDASHit::Reset() {
 ddasfmt::DDASHit::~DDASHit()
 {}
 
+/**
+ * @details
+ * The coarse time is a whole number of nanoseconds, the CFD correction 
+ * (between -4 and 10 ns) carries into it or borrows from it.
+ */
+ddasfmt::DDASHit::FixedTime
+ddasfmt::DDASHit::getFixedTime() const
+{
+    static_assert(TIME_FRACTION_BITS == 14,
+		  "The CFD steps below are in units of 2^-14 ns");
+    const int64_t timeCFD = m_timeCFD;
+    const int64_t cfdTrigSource = m_cfdTrigSourceBit;
+    int64_t correction;
+    switch (m_modMSPS) {
+    case 100:
+	correction = 5*timeCFD;
+	break;
+    case 250:
+	correction = 4*(timeCFD - 16384*cfdTrigSource);
+	break;
+    case 500:
+	correction = 4*(timeCFD + 8192*(cfdTrigSource - 1));
+	break;
+    default:
+	correction = 0;
+	break;
+    }
+    return FixedTime{static_cast<int64_t>(m_coarseTime), 0} + correction;
+}
 
 bool ddasfmt::DDASHit::operator<(const ddasfmt::DDASHit& rhs) const{
-    return this->m_time < rhs.m_time;
+    return this->getFixedTime() < rhs.getFixedTime();
 }
 
 bool ddasfmt::DDASHit::operator>(const ddasfmt::DDASHit& rhs) const{
@@ -280,12 +280,13 @@ ddasfmt::DDASHitUnpacker::parseHeaderWords1And2(
     uint32_t adcFrequency = hit.getModMSPS();
     
     uint64_t coarseTime = computeCoarseTime(adcFrequency, timeLow, timeHigh) ;
-    double cfdCorrection = parseAndComputeCFD(hit, datum1);
+    parseAndComputeCFD(hit, datum1);
 
     hit.setTimeLow(timeLow);
     hit.setTimeHigh(timeHigh);
     hit.setCoarseTime(coarseTime); 
-    hit.setTime(static_cast<double>(coarseTime) + cfdCorrection);
+    // The double time is derived from the exact fixed point time
+    hit.setTime(hit.getFixedTime().toNs());
 
     return data;
 }
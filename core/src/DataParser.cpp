@@ -65,7 +65,7 @@ DataParser::DataParser(DataParser::DataFileType dft, const std::string& log, ldf
 	}
 }
 
-void DataParser::SetInputFiles(std::vector<std::string>& filelist){
+void DataParser::SetInputFiles(const std::vector<std::string>& filelist){
 	for(const auto& file : filelist){
 		if( not this->DataTranslator->AddFile(file) ){
 			throw std::runtime_error("Unable to Add File : "+file+" to the Translator");
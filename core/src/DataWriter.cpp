@@ -0,0 +1,223 @@
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <Compression.h>
+#include <TFile.h>
+#include <TTree.h>
+
+#include "DataWriter.h"
+#include "DDASRootEvent.h"
+#include "TraceRecorder.h"
+
+#include "TTreeEventWriter.h"
+#include "RNTupleEventWriter.h"
+
+DataWriter::DataWriter(ldf2root::OutputFormat fmt, const std::string& log, ldf2root::CmdOptions _cmdopts) {
+	this->Format = fmt;
+	this->LogName = log;
+	this->CmdOpts = _cmdopts;
+	this->OutputFile = nullptr;
+	this->TraceFile = nullptr;
+	this->SpillTree = nullptr;
+	this->SpillsWritten = 0;
+	this->SpillsFlagged = 0;
+	this->WriteTime = std::chrono::duration<double>::zero();
+	this->Metrics = nullptr;
+	switch(this->Format){
+		case ldf2root::OutputFormat::RNTUPLE:
+			this->WriterName = "RNTUPLE";
+			break;
+		case ldf2root::OutputFormat::TTREE:
+		default:
+			this->WriterName = "TTREE";
+			break;
+	}
+	this->console = spdlog::get(this->LogName)->clone("DataWriter");
+
+	switch(this->Format){
+		case ldf2root::OutputFormat::TTREE:
+			this->Writer.reset(new TTreeEventWriter(this->LogName,this->WriterName,this->CmdOpts));
+			break;
+		case ldf2root::OutputFormat::RNTUPLE:
+#ifdef LDF2ROOT_HAS_RNTUPLE
+			this->Writer.reset(new RNTupleEventWriter(this->LogName,this->WriterName,this->CmdOpts));
+			break;
+#else
+			throw std::runtime_error("ldf2root was built without RNTuple support, unable to use output format "+this->WriterName);
+#endif
+		default:
+			throw std::runtime_error("UNKNOWN WRITER OF TYPE "+this->WriterName);
+	}
+
+	this->OutputFile = TFile::Open(this->CmdOpts.output_file.c_str(), "RECREATE","",ROOT::RCompressionSetting::EDefaults::kUseAnalysis);
+	if (!this->OutputFile || this->OutputFile->IsZombie()) {
+		throw std::runtime_error("Failed to create output ROOT file: "+this->CmdOpts.output_file);
+	}
+	if( this->CmdOpts.split_traces and this->CmdOpts.write_traces ){
+		if( this->CmdOpts.trace_file.empty() ){
+			this->TraceFile = this->OutputFile;
+		}else{
+			this->TraceFile = TFile::Open(this->CmdOpts.trace_file.c_str(), "RECREATE","",ROOT::RCompressionSetting::EDefaults::kUseAnalysis);
+			if (!this->TraceFile || this->TraceFile->IsZombie()) {
+				throw std::runtime_error("Failed to create trace ROOT file: "+this->CmdOpts.trace_file);
+			}
+		}
+	}
+	if( not this->Writer->Initialize(this->OutputFile,this->TraceFile) ){
+		throw std::runtime_error("Unable to initialize "+this->WriterName+" writer for : "+this->CmdOpts.output_file);
+	}
+}
+
+DataWriter::~DataWriter(){
+	if( this->OutputFile ){
+		this->console->error("DataWriter destroyed before the output file was closed");
+	}
+}
+
+void DataWriter::Fill(DDASRootEvent& event){
+	auto start = std::chrono::steady_clock::now();
+	if( this->Metrics ){
+		this->Metrics->StageStarted(PipelineMetrics::WRITE);
+	}
+	// Only the fills that ended up compressing and writing baskets go on the timeline
+	auto& recorder = TraceRecorder::Instance();
+	const bool tracing = recorder.IsEnabled();
+	const int64_t traceStart = tracing ? recorder.Now() : 0;
+	const Long64_t bytesBefore = tracing ? this->BytesWritten() : 0;
+	this->Writer->Fill(event);
+	if( tracing ){
+		const Long64_t bytesWritten = this->BytesWritten() - bytesBefore;
+		if( bytesWritten > 0 ){
+			recorder.Record("BasketFlush","write",traceStart,recorder.Now(),"bytes",bytesWritten);
+		}
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	this->WriteTime += elapsed;
+	if( this->Metrics ){
+		this->Metrics->AddEventsIn(PipelineMetrics::WRITE,1);
+		this->Metrics->AddHitsIn(PipelineMetrics::WRITE,event.GetNHits());
+		this->Metrics->AddBusyTime(PipelineMetrics::WRITE,elapsed);
+	}
+}
+
+Long64_t DataWriter::BytesWritten() const{
+	Long64_t bytes = this->OutputFile->GetBytesWritten();
+	if( this->TraceFile and this->TraceFile != this->OutputFile ){
+		bytes += this->TraceFile->GetBytesWritten();
+	}
+	return bytes;
+}
+
+void DataWriter::CreateSpillTree(){
+	const std::string name = this->CmdOpts.tree_name+"_spills";
+	this->OutputFile->cd();
+	this->SpillTree = new TTree(name.c_str(),"Spill bookkeeping");
+	this->SpillTree->Branch("spill",&(this->CurrSpill.Spill));
+	this->SpillTree->Branch("file",&(this->CurrSpill.File));
+	this->SpillTree->Branch("offset",&(this->CurrSpill.Offset));
+	this->SpillTree->Branch("words",&(this->CurrSpill.Words));
+	this->SpillTree->Branch("chunks",&(this->CurrSpill.Chunks));
+	this->SpillTree->Branch("missing_chunks",&(this->CurrSpill.MissingChunks));
+	this->SpillTree->Branch("flags",&(this->CurrSpill.Flags));
+	this->SpillTree->Branch("hits",&(this->CurrSpill.Hits));
+	this->SpillTree->Branch("first_time",&(this->CurrSpill.FirstTime));
+	this->SpillTree->Branch("last_time",&(this->CurrSpill.LastTime));
+	this->SpillTree->Branch("crate",&(this->CurrSpill.Crate));
+	this->SpillTree->Branch("slot",&(this->CurrSpill.Slot));
+	this->SpillTree->Branch("module_hits",&(this->CurrSpill.ModuleHits));
+	this->console->info("Created spill TTree {}",name);
+}
+
+void DataWriter::FillSpills(const std::vector<Translator::SpillInfo>& spills){
+	if( spills.empty() or not this->CmdOpts.spill_tree ){
+		return;
+	}
+	if( not this->SpillTree ){
+		this->CreateSpillTree();
+	}
+	auto& entry = this->CurrSpill;
+	for( const auto& spill : spills ){
+		entry.Spill = spill.Spill;
+		entry.File = spill.File;
+		entry.Offset = spill.Offset;
+		entry.Words = spill.Words;
+		entry.Chunks = spill.Chunks;
+		entry.MissingChunks = spill.MissingChunks;
+		entry.Flags = spill.Flags;
+		entry.Hits = spill.Hits;
+		entry.FirstTime = spill.FirstTime;
+		entry.LastTime = spill.LastTime;
+		entry.Crate.clear();
+		entry.Slot.clear();
+		entry.ModuleHits.clear();
+		for( size_t ii = 0; ii < spill.ModuleHits.size(); ++ii ){
+			if( spill.ModuleHits[ii] > 0 ){
+				entry.Crate.push_back(ii >> 4);
+				entry.Slot.push_back(ii & 0xF);
+				entry.ModuleHits.push_back(spill.ModuleHits[ii]);
+			}
+		}
+		this->SpillTree->Fill();
+		++this->SpillsWritten;
+		this->SpillsFlagged += (spill.Flags != 0);
+	}
+}
+
+void DataWriter::Save(){
+	TraceSpan span("Save","write");
+	auto start = std::chrono::steady_clock::now();
+	this->Writer->Save();
+	if( this->SpillTree ){
+		this->OutputFile->cd();
+		this->SpillTree->AutoSave("SaveSelf");
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	this->WriteTime += elapsed;
+	if( this->Metrics ){
+		this->Metrics->AddBusyTime(PipelineMetrics::WRITE,elapsed);
+	}
+	this->console->info("Saved {} events to {}",this->Writer->GetEventsWritten(),this->CmdOpts.output_file);
+}
+
+void DataWriter::Close(){
+	if( not this->OutputFile ){
+		return;
+	}
+	TraceSpan span("Close","write");
+	auto start = std::chrono::steady_clock::now();
+	this->Writer->Finalize();
+	if( this->SpillTree ){
+		this->OutputFile->cd();
+		this->SpillTree->Write("",TObject::kOverwrite);
+		this->console->info("Wrote {} spills to {}_spills, {} of them with errors",this->SpillsWritten,this->CmdOpts.tree_name,this->SpillsFlagged);
+	}
+	if( this->TraceFile and this->TraceFile != this->OutputFile ){
+		this->TraceFile->Close();
+		delete this->TraceFile;
+	}
+	this->TraceFile = nullptr;
+	this->OutputFile->Close();
+	delete this->OutputFile;
+	this->OutputFile = nullptr;
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	this->WriteTime += elapsed;
+
+	// Report enough to compare the output formats against each other on the same input
+	const double seconds = this->WriteTime.count();
+	const uint64_t nevents = this->Writer->GetEventsWritten();
+	const uint64_t nhits = this->Writer->GetHitsWritten();
+	uintmax_t nbytes = std::filesystem::file_size(this->CmdOpts.output_file);
+	if( this->CmdOpts.split_traces and this->CmdOpts.write_traces and not this->CmdOpts.trace_file.empty() ){
+		nbytes += std::filesystem::file_size(this->CmdOpts.trace_file);
+	}
+	if( this->Metrics ){
+		this->Metrics->AddBusyTime(PipelineMetrics::WRITE,elapsed);
+		this->Metrics->AddBytesOut(PipelineMetrics::WRITE,nbytes);
+	}
+	this->console->info("{} output : {} events written in {} seconds ({} events/s), file size {} bytes ({} bytes/event)",
+		this->WriterName,nevents,seconds,(seconds > 0.0 ? nevents/seconds : 0.0),nbytes,(nevents > 0 ? nbytes/nevents : 0));
+	this->console->info("{} output : {} hits, {} ns/hit, {} bytes/hit",
+		this->WriterName,nhits,(nhits > 0 ? 1.0e9*seconds/nhits : 0.0),(nhits > 0 ? static_cast<double>(nbytes)/nhits : 0.0));
+}
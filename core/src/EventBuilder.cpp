@@ -0,0 +1,132 @@
+#include <algorithm>
+
+#include "EventBuilder.h"
+#include "DDASRootHit.h"
+#include "PipelineMetrics.h"
+#include "TraceRecorder.h"
+#include "WindowEngine.h"
+
+namespace{
+	template<template<class> class Window>
+	std::unique_ptr<EventBuilder::Engine> MakeEngine(EventBuilder& builder,const ldf2root::CmdOptions& cmdopts){
+		if( cmdopts.coarse_windows ){
+			return std::make_unique<WindowEngine<Window<windowtime::Coarse>>>(builder,cmdopts);
+		}
+		return std::make_unique<WindowEngine<Window<windowtime::CFD>>>(builder,cmdopts);
+	}
+}
+
+EventBuilder::EventBuilder(const std::string& log,const ldf2root::CmdOptions& cmdopts,EventSink sink){
+	this->LogName = log;
+	this->Window = cmdopts.build_window_type;
+	this->BuildWindow = cmdopts.build_window;
+	this->PreWindow = cmdopts.pre_window;
+	this->PostWindow = cmdopts.post_window < 0.0 ? cmdopts.build_window : cmdopts.post_window;
+	this->CoarseWindows = cmdopts.coarse_windows;
+	this->Sink = std::move(sink);
+	this->EventsBuilt = 0;
+	this->HitsBuilt = 0;
+	this->HitsDropped = 0;
+	this->Metrics = nullptr;
+	this->Differences = nullptr;
+	this->console = spdlog::get(this->LogName)->clone("EventBuilder");
+
+	switch(this->Window){
+		case ldf2root::WindowType::ROLLING:
+			this->BuildEngine = MakeEngine<window::Rolling>(*this,cmdopts);
+			break;
+		case ldf2root::WindowType::FIXED:
+			this->BuildEngine = MakeEngine<window::Fixed>(*this,cmdopts);
+			break;
+		case ldf2root::WindowType::TRIGGERED:
+			this->BuildEngine = MakeEngine<window::Triggered>(*this,cmdopts);
+			break;
+		case ldf2root::WindowType::FLAT:
+		default:
+			this->BuildEngine = MakeEngine<window::Flat>(*this,cmdopts);
+			break;
+	}
+}
+
+EventBuilder::~EventBuilder(){
+	if( this->CurrEvent.GetNHits() > 0 ){
+		this->console->error("EventBuilder destroyed with {} hits in an unflushed event",this->CurrEvent.GetNHits());
+	}
+}
+
+void EventBuilder::AddHit(std::unique_ptr<DDASRootHit> hit){
+	this->BuildEngine->AddHit(std::move(hit));
+}
+
+void EventBuilder::Flush(){
+	this->BuildEngine->Flush();
+	if( this->Window == ldf2root::WindowType::TRIGGERED ){
+		this->console->info("Triggered building kept {} hits in {} events, {} hits outside of the trigger windows were dropped.",this->HitsBuilt,this->EventsBuilt,this->HitsDropped);
+	}
+}
+
+void EventBuilder::Emit(){
+	this->HitsBuilt += this->CurrEvent.GetNHits();
+	this->Sink(this->CurrEvent);
+	this->CurrEvent.Reset();
+	++this->EventsBuilt;
+	if( this->Metrics ){
+		this->Metrics->AddEventsOut(PipelineMetrics::BUILD,1);
+	}
+}
+
+std::chrono::duration<double> EventBuilder::Build(UnpackedHitVector* hitList){
+	auto start_time = std::chrono::high_resolution_clock::now();
+	const size_t numHits = hitList->size();
+	if( this->Metrics ){
+		this->Metrics->StageStarted(PipelineMetrics::BUILD);
+		this->Metrics->SetQueueDepth(PipelineMetrics::BUILD,numHits);
+	}
+	switch(this->Window){
+		case ldf2root::WindowType::ROLLING:
+			this->console->info("Building events with rolling window type and build window of {} nanoseconds.",this->BuildWindow);
+			break;
+		case ldf2root::WindowType::FIXED:
+			this->console->info("Building events with fixed window type and build window of {} nanoseconds.",this->BuildWindow);
+			break;
+		case ldf2root::WindowType::TRIGGERED:
+			this->console->info("Building events with triggered window type, {} nanoseconds before and {} nanoseconds after every trigger.",this->PreWindow,this->PostWindow);
+			break;
+		case ldf2root::WindowType::FLAT:
+		default:
+			this->console->info("Building events with flat window type.");
+			break;
+	}
+
+	if( this->CoarseWindows ){
+		this->console->info("Comparing the build windows on the coarse timestamps, without the CFD correction.");
+	}
+
+	// The hits go to the engine in batches, progress, metrics and one timeline span are updated per batch
+	const size_t batchSize = 16384;
+	auto& recorder = TraceRecorder::Instance();
+	const bool tracing = recorder.IsEnabled();
+
+	int prog = 10;
+	const size_t interval = std::max<size_t>(numHits/10,1);
+	for( size_t begin = 0; begin < numHits; begin += batchSize ){
+		const size_t end = std::min(begin + batchSize,numHits);
+		const int64_t batchStart = tracing ? recorder.Now() : 0;
+		this->BuildEngine->AddHits(hitList,begin,end);
+		if( tracing ){
+			recorder.Record("EventBatch","build",batchStart,recorder.Now(),"hits",end - begin);
+		}
+		if( this->Metrics ){
+			this->Metrics->SetQueueDepth(PipelineMetrics::BUILD,numHits - end);
+		}
+		for( ; prog < 100 and end >= (prog/10)*interval and end < numHits; prog += 10 ){
+			this->console->info("Progress: {}%",prog);
+		}
+	}
+	this->Flush();
+
+	if( this->Metrics ){
+		this->Metrics->SetQueueDepth(PipelineMetrics::BUILD,0);
+	}
+	return std::chrono::high_resolution_clock::now() - start_time;
+}
@@ -0,0 +1,163 @@
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+#include "EventDigest.h"
+#include "DDASHit.h"
+#include "DDASRootEvent.h"
+#include "DDASRootHit.h"
+
+namespace{
+	const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+	const uint64_t FNV_PRIME = 1099511628211ULL;
+	const size_t FLUSH_SIZE = 1 << 20;
+
+	inline void Mix(uint64_t& h,const void* data,size_t n){
+		const unsigned char* p = static_cast<const unsigned char*>(data);
+		for( size_t ii = 0; ii < n; ++ii ){
+			h ^= p[ii];
+			h *= FNV_PRIME;
+		}
+	}
+
+	template<typename T>
+	inline void Mix(uint64_t& h,T value){
+		Mix(h,&value,sizeof(T));
+	}
+
+	template<typename T>
+	inline void MixVector(uint64_t& h,const std::vector<T>& v){
+		Mix(h,static_cast<uint64_t>(v.size()));
+		if( not v.empty() ){
+			Mix(h,v.data(),v.size()*sizeof(T));
+		}
+	}
+}
+
+EventDigest::EventDigest(const std::string& log,const ldf2root::CmdOptions& cmdopts){
+	this->LogName = log;
+	this->FileName = cmdopts.digest_file;
+	this->Events = 0;
+	this->Hits = 0;
+	this->RunHash = FNV_OFFSET;
+	this->console = spdlog::get(this->LogName)->clone("EventDigest");
+
+	this->Output.open(this->FileName);
+	if( not this->Output.is_open() ){
+		throw std::runtime_error("Unable to open digest file "+this->FileName);
+	}
+	this->Buffer.reserve(FLUSH_SIZE + 4096);
+	this->Output << "# ldf2root event digest v1\n";
+	for( const auto& input : cmdopts.input_files ){
+		this->Output << "# input " << input << "\n";
+	}
+	this->console->info("Writing event digest to {}",this->FileName);
+}
+
+EventDigest::~EventDigest(){
+	if( this->Output.is_open() ){
+		this->console->error("EventDigest destroyed before {} was closed, the digest has no trailer",this->FileName);
+		this->FlushBuffer();
+	}
+}
+
+uint64_t EventDigest::HashTrace(const std::vector<uint16_t>& trace){
+	uint64_t h = FNV_OFFSET;
+	MixVector(h,trace);
+	return h;
+}
+
+uint64_t EventDigest::HashHit(const DDASFlatHit& hit,const std::vector<uint16_t>& trace){
+	uint64_t h = FNV_OFFSET;
+	// The time is compared bit for bit, a faster path has to reproduce it exactly
+	Mix(h,hit.time);
+	Mix(h,hit.coarseTime);
+	Mix(h,hit.energy);
+	Mix(h,hit.timeHigh);
+	Mix(h,hit.timeLow);
+	Mix(h,hit.timeCFD);
+	Mix(h,hit.finishCode);
+	Mix(h,hit.channelLength);
+	Mix(h,hit.channelHeaderLength);
+	Mix(h,hit.crateID);
+	Mix(h,hit.slotID);
+	Mix(h,hit.chanID);
+	Mix(h,hit.modMSPS);
+	Mix(h,hit.hdwrRevision);
+	Mix(h,hit.adcResolution);
+	Mix(h,hit.cfdTrigSourceBit);
+	Mix(h,hit.cfdFailBit);
+	Mix(h,hit.traceLength);
+	Mix(h,hit.externalTimestamp);
+	Mix(h,static_cast<uint8_t>(hit.adcOverflowUnderflow));
+	MixVector(h,hit.energySums);
+	MixVector(h,hit.qdcSums);
+	MixVector(h,trace);
+	return h;
+}
+
+void EventDigest::Add(DDASRootEvent& event){
+	const auto& data = event.GetData();
+	uint64_t eventHash = FNV_OFFSET;
+	this->HitLines.clear();
+	for( const auto* hit : data ){
+		// The hits are hashed in the lean layout, so the digest of a written lean event is the same
+		this->FlatHit.Set(*hit);
+		this->AddHit(this->FlatHit,hit->getTrace(),eventHash);
+	}
+	this->EndEvent(data.size(),eventHash);
+}
+
+void EventDigest::Add(const std::vector<DDASFlatHit>& hits,const std::vector<std::vector<uint16_t>>& traces){
+	static const std::vector<uint16_t> notrace;
+	uint64_t eventHash = FNV_OFFSET;
+	this->HitLines.clear();
+	for( size_t ii = 0; ii < hits.size(); ++ii ){
+		this->AddHit(hits[ii],ii < traces.size() ? traces[ii] : notrace,eventHash);
+	}
+	this->EndEvent(hits.size(),eventHash);
+}
+
+void EventDigest::AddHit(const DDASFlatHit& hit,const std::vector<uint16_t>& trace,uint64_t& eventHash){
+	const uint64_t hitHash = HashHit(hit,trace);
+	Mix(eventHash,hitHash);
+	fmt::format_to(std::back_inserter(this->HitLines),"H {} {} {} {} {} {:016x} {:016x}\n",
+		hit.crateID,hit.slotID,hit.chanID,hit.time,hit.energy,HashTrace(trace),hitHash);
+}
+
+void EventDigest::EndEvent(size_t nhits,uint64_t eventHash){
+	fmt::format_to(std::back_inserter(this->Buffer),"E {} {} {:016x}\n",this->Events,nhits,eventHash);
+	this->Buffer += this->HitLines;
+	Mix(this->RunHash,eventHash);
+	++this->Events;
+	this->Hits += nhits;
+	if( this->Buffer.size() >= FLUSH_SIZE ){
+		this->FlushBuffer();
+	}
+}
+
+void EventDigest::FlushBuffer(){
+	this->Output.write(this->Buffer.data(),this->Buffer.size());
+	this->Buffer.clear();
+}
+
+void EventDigest::Close(bool complete){
+	if( not this->Output.is_open() ){
+		return;
+	}
+	if( complete ){
+		fmt::format_to(std::back_inserter(this->Buffer),"T {} {} {:016x}\n",this->Events,this->Hits,this->RunHash);
+	}else{
+		fmt::format_to(std::back_inserter(this->Buffer),"# incomplete, the conversion failed after {} events\n",this->Events);
+	}
+	this->FlushBuffer();
+	this->Output.close();
+	if( this->Output.fail() ){
+		throw std::runtime_error("Failed writing digest file "+this->FileName);
+	}
+	if( complete ){
+		this->console->info("Event digest: {} events, {} hits, run hash {:016x}",this->Events,this->Hits,this->RunHash);
+	}else{
+		this->console->warn("Event digest closed incomplete after {} events, {} hits",this->Events,this->Hits);
+	}
+}
@@ -0,0 +1,275 @@
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "EventFilter.h"
+#include "DDASRootEvent.h"
+#include "DDASRootHit.h"
+
+namespace{
+	inline int ChannelIndex(uint32_t crate,uint32_t slot,uint32_t chan){
+		return ((crate & 0xF) << 8) | ((slot & 0xF) << 4) | (chan & 0xF);
+	}
+}
+
+// Recursive descent over the expression, appending the predicates and the postfix program to the filter
+class EventFilter::Parser{
+	public:
+		Parser(const std::string& text,EventFilter& filter) : Text(text), Pos(0), Filter(filter) {}
+
+		void Parse(){
+			this->Expression();
+			this->SkipSpace();
+			if( this->Pos != this->Text.size() ){
+				this->Fail("unexpected '"+this->Text.substr(this->Pos)+"'");
+			}
+		}
+
+	private:
+		void Expression(){
+			this->Conjunction();
+			while( this->Accept("||") ){
+				this->Conjunction();
+				this->Emit(Instruction::OR);
+			}
+		}
+
+		void Conjunction(){
+			this->Unary();
+			while( this->Accept("&&") ){
+				this->Unary();
+				this->Emit(Instruction::AND);
+			}
+		}
+
+		void Unary(){
+			if( this->Accept("!") ){
+				this->Unary();
+				this->Emit(Instruction::NOT);
+			}else if( this->Accept("(") ){
+				this->Expression();
+				this->Expect(")");
+			}else{
+				this->ParsePredicate();
+			}
+		}
+
+		void ParsePredicate(){
+			this->SkipSpace();
+			const size_t start = this->Pos;
+			const std::string name = this->Identifier();
+			Predicate pred;
+			if( name == "mult" ){
+				pred.Type = Predicate::MULT;
+				this->ParseComparison(pred);
+			}else if( name == "width" ){
+				pred.Type = Predicate::WIDTH;
+				this->ParseComparison(pred);
+			}else if( name == "energy" ){
+				pred.Type = Predicate::ENERGY;
+				if( this->Accept("(") ){
+					pred.Channel = this->Channel();
+					this->Expect(")");
+				}
+				this->ParseComparison(pred);
+			}else if( name == "has" ){
+				pred.Type = Predicate::HAS;
+				this->Expect("(");
+				pred.Channel = this->Channel();
+				this->Expect(")");
+			}else{
+				this->Pos = start;
+				this->Fail(name.empty() ? "expected a predicate" : "unknown predicate '"+name+"'");
+			}
+			pred.Text = this->Text.substr(start,this->Pos - start);
+			this->Filter.Predicates.push_back(pred);
+			this->Emit(Instruction::PREDICATE,this->Filter.Predicates.size() - 1);
+		}
+
+		void ParseComparison(Predicate& pred){
+			// Two character operators first, > would match the start of >=
+			static const std::pair<const char*,Compare> ops[] = {
+				{">=",Compare::GE},{"<=",Compare::LE},{"==",Compare::EQ},{"!=",Compare::NE},{">",Compare::GT},{"<",Compare::LT}
+			};
+			for( const auto& op : ops ){
+				if( this->Accept(op.first) ){
+					pred.Op = op.second;
+					pred.Value = this->Number();
+					return;
+				}
+			}
+			this->Fail("expected a comparison");
+		}
+
+		int Channel(){
+			unsigned int ids[3];
+			for( int ii = 0; ii < 3; ++ii ){
+				if( ii > 0 ){
+					this->Expect(":");
+				}
+				const double value = this->Number();
+				if( value < 0.0 or value > 15.0 or value != static_cast<unsigned int>(value) ){
+					this->Fail("crate, slot and channel are 0 to 15");
+				}
+				ids[ii] = static_cast<unsigned int>(value);
+			}
+			return ChannelIndex(ids[0],ids[1],ids[2]);
+		}
+
+		std::string Identifier(){
+			const size_t start = this->Pos;
+			while( this->Pos < this->Text.size() and (std::isalpha(static_cast<unsigned char>(this->Text[this->Pos])) or this->Text[this->Pos] == '_') ){
+				++this->Pos;
+			}
+			return this->Text.substr(start,this->Pos - start);
+		}
+
+		double Number(){
+			this->SkipSpace();
+			const char* begin = this->Text.c_str() + this->Pos;
+			char* end = nullptr;
+			const double value = std::strtod(begin,&end);
+			if( end == begin ){
+				this->Fail("expected a number");
+			}
+			this->Pos += end - begin;
+			return value;
+		}
+
+		void SkipSpace(){
+			while( this->Pos < this->Text.size() and std::isspace(static_cast<unsigned char>(this->Text[this->Pos])) ){
+				++this->Pos;
+			}
+		}
+
+		bool Accept(const std::string& token){
+			this->SkipSpace();
+			if( this->Text.compare(this->Pos,token.size(),token) == 0 ){
+				this->Pos += token.size();
+				return true;
+			}
+			return false;
+		}
+
+		void Expect(const std::string& token){
+			if( not this->Accept(token) ){
+				this->Fail("expected '"+token+"'");
+			}
+		}
+
+		void Emit(Instruction::Code op,size_t index = 0){
+			this->Filter.Program.push_back({op,index});
+		}
+
+		[[noreturn]] void Fail(const std::string& msg) const{
+			throw std::runtime_error("Invalid filter \""+this->Text+"\" at position "+std::to_string(this->Pos)+" : "+msg);
+		}
+
+		const std::string& Text;
+		size_t Pos;
+		EventFilter& Filter;
+};
+
+EventFilter::EventFilter(const std::string& log,const ldf2root::CmdOptions& cmdopts){
+	this->LogName = log;
+	this->EventsIn = 0;
+	this->EventsAccepted = 0;
+	this->console = spdlog::get(this->LogName)->clone("EventFilter");
+
+	for( const auto& filter : cmdopts.filters ){
+		Parser(filter,*this).Parse();
+		if( not this->Expression.empty() ){
+			this->Expression += " && ";
+			this->Program.push_back({Instruction::AND,0});
+		}
+		this->Expression += cmdopts.filters.size() > 1 ? "("+filter+")" : filter;
+	}
+	this->Results.resize(this->Predicates.size(),0);
+	this->Stack.reserve(this->Program.size());
+	this->console->info("Writing only the events passing {} ({} predicates)",this->Expression,this->Predicates.size());
+}
+
+bool EventFilter::Test(Compare op,double lhs,double rhs){
+	switch(op){
+		case Compare::GT:
+			return lhs > rhs;
+		case Compare::GE:
+			return lhs >= rhs;
+		case Compare::LT:
+			return lhs < rhs;
+		case Compare::LE:
+			return lhs <= rhs;
+		case Compare::EQ:
+			return lhs == rhs;
+		case Compare::NE:
+		default:
+			return lhs != rhs;
+	}
+}
+
+bool EventFilter::Evaluate(const Predicate& pred,DDASRootEvent& event) const{
+	switch(pred.Type){
+		case Predicate::MULT:
+			return Test(pred.Op,event.GetNHits(),pred.Value);
+		case Predicate::WIDTH:
+			return Test(pred.Op,event.GetNHits() > 0 ? event.GetTimeWidth() : 0.0,pred.Value);
+		case Predicate::ENERGY:
+			for( const auto* hit : event.GetData() ){
+				if( (pred.Channel < 0 or ChannelIndex(hit->getCrateID(),hit->getSlotID(),hit->getChannelID()) == pred.Channel)
+					and Test(pred.Op,hit->getEnergy(),pred.Value) ){
+					return true;
+				}
+			}
+			return false;
+		case Predicate::HAS:
+		default:
+			for( const auto* hit : event.GetData() ){
+				if( ChannelIndex(hit->getCrateID(),hit->getSlotID(),hit->getChannelID()) == pred.Channel ){
+					return true;
+				}
+			}
+			return false;
+	}
+}
+
+bool EventFilter::Accept(DDASRootEvent& event){
+	++this->EventsIn;
+	for( size_t ii = 0; ii < this->Predicates.size(); ++ii ){
+		this->Results[ii] = this->Evaluate(this->Predicates[ii],event);
+		this->Predicates[ii].Passed += this->Results[ii];
+	}
+	this->Stack.clear();
+	for( const auto& ins : this->Program ){
+		switch(ins.Op){
+			case Instruction::PREDICATE:
+				this->Stack.push_back(this->Results[ins.Index]);
+				break;
+			case Instruction::NOT:
+				this->Stack.back() = not this->Stack.back();
+				break;
+			case Instruction::AND:{
+				const char rhs = this->Stack.back();
+				this->Stack.pop_back();
+				this->Stack.back() = this->Stack.back() and rhs;
+				break;
+			}
+			case Instruction::OR:{
+				const char rhs = this->Stack.back();
+				this->Stack.pop_back();
+				this->Stack.back() = this->Stack.back() or rhs;
+				break;
+			}
+		}
+	}
+	const bool accepted = this->Stack.back();
+	this->EventsAccepted += accepted;
+	return accepted;
+}
+
+void EventFilter::Report() const{
+	const auto percent = [this](uint64_t n){ return this->EventsIn > 0 ? 100.0*n/this->EventsIn : 0.0; };
+	this->console->info("Filter {} accepted {} of {} events ({:.2f}%)",this->Expression,this->EventsAccepted,this->EventsIn,percent(this->EventsAccepted));
+	for( const auto& pred : this->Predicates ){
+		this->console->info("    {} : {} events ({:.2f}%)",pred.Text,pred.Passed,percent(pred.Passed));
+	}
+}
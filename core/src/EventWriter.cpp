@@ -0,0 +1,37 @@
+#include <stdexcept>
+
+#include "EventWriter.h"
+
+EventWriter::EventWriter(const std::string& log,const std::string& writername,const ldf2root::CmdOptions& cmdopts){
+	this->LogName = log;
+	this->WriterName = writername;
+	this->CmdOpts = cmdopts;
+	this->OutputFile = nullptr;
+	this->TraceFile = nullptr;
+	this->EventsWritten = 0;
+	this->HitsWritten = 0;
+
+	this->console = spdlog::get(this->LogName)->clone(this->WriterName);
+	this->console->info("Created Writer [{}]",this->WriterName);
+}
+
+EventWriter::~EventWriter() = default;
+
+bool EventWriter::Initialize(TFile* outfile,TFile* tracefile){
+	this->OutputFile = outfile;
+	this->TraceFile = tracefile;
+	return this->OutputFile != nullptr;
+}
+
+void EventWriter::Fill([[maybe_unused]] DDASRootEvent& event){
+	this->console->error("Called EventWriter::Fill(), not the overload");
+	throw std::runtime_error("Called EventWriter::Fill(), not the overload");
+}
+
+void EventWriter::Save(){
+	this->console->debug("{} writer has nothing to save before it is finalized",this->WriterName);
+}
+
+void EventWriter::Finalize(){
+	this->console->info("Wrote {} events, {} hits",this->EventsWritten,this->HitsWritten);
+}
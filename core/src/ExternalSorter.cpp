@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <atomic>
+#include <queue>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "ExternalSorter.h"
+#include "EventBuilder.h"
+#include "TraceRecorder.h"
+
+namespace{
+	// Sorters in the same process get their own run file names
+	std::atomic<uint64_t> SorterInstances{0};
+
+	const size_t MIN_READ_BUFFER = 64*1024;
+	const size_t MAX_READ_BUFFER = 8*1024*1024;
+	const size_t WRITE_BUFFER = 4*1024*1024;
+}
+
+ExternalSorter::ExternalSorter(const std::string& log,const ldf2root::CmdOptions& cmdopts){
+	this->LogName = log;
+	this->CmdOpts = cmdopts;
+	this->MemoryLimit = static_cast<uint64_t>(this->CmdOpts.sort_memory_mb)*1024*1024;
+	this->TotalHits = 0;
+	this->BytesSpilled = 0;
+	this->console = spdlog::get(this->LogName)->clone("ExternalSorter");
+
+	this->ScratchDir = this->CmdOpts.sort_scratch.empty() ? std::filesystem::temp_directory_path() : std::filesystem::path(this->CmdOpts.sort_scratch);
+	std::error_code ec;
+	std::filesystem::create_directories(this->ScratchDir,ec);
+	if( ec or not std::filesystem::is_directory(this->ScratchDir) ){
+		throw std::runtime_error("Unable to use sort scratch directory "+this->ScratchDir.string());
+	}
+	this->ScratchDir /= "ldf2root_sort_"+std::to_string(getpid())+"_"+std::to_string(SorterInstances.fetch_add(1));
+	this->console->info("External sort with a memory limit of {} MB, runs are written to {}_*.run",this->CmdOpts.sort_memory_mb,this->ScratchDir.string());
+}
+
+ExternalSorter::~ExternalSorter(){
+	this->RemoveRuns();
+}
+
+void ExternalSorter::RemoveRuns(){
+	for( const auto& run : this->Runs ){
+		if( run.empty() ){
+			continue;
+		}
+		std::error_code ec;
+		std::filesystem::remove(run,ec);
+	}
+	this->Runs.clear();
+}
+
+std::chrono::duration<double> ExternalSorter::AddBlock(RawDataVector* rawData){
+	auto start_time = std::chrono::high_resolution_clock::now();
+	if( rawData->empty() ){
+		return std::chrono::high_resolution_clock::now() - start_time;
+	}
+	TraceSpan span("SortRun","sort");
+
+	// Only the time is needed for the key, the hit is unpacked the same way it will be in the merge
+	const uint32_t* data = rawData->data();
+	const size_t totalWords = rawData->size();
+	ddasfmt::DDASHit scratch;
+	this->Keys.clear();
+	size_t pos = 0;
+	while( pos < totalWords ){
+		const uint32_t eventLength = data[pos];
+		if( eventLength < 2 or pos + eventLength/2 > totalWords ){
+			throw std::runtime_error("Corrupt hit length "+std::to_string(eventLength)+" while forming sort run "+std::to_string(this->Runs.size()));
+		}
+		scratch.Reset();
+		this->Unpacker.unpack(data + pos,data + pos + eventLength/2,scratch);
+		this->Keys.push_back({scratch.getFixedTime(),pos});
+		pos += eventLength/2;
+	}
+	std::sort(this->Keys.begin(),this->Keys.end(),
+		[](const SortKey& a,const SortKey& b){ return a.Time < b.Time or (a.Time == b.Time and a.Offset < b.Offset); }
+	);
+
+	const std::filesystem::path runfile = this->ScratchDir.string()+"_"+std::to_string(this->Runs.size())+".run";
+	std::vector<char> streamBuffer(WRITE_BUFFER);
+	std::ofstream output;
+	output.rdbuf()->pubsetbuf(streamBuffer.data(),streamBuffer.size());
+	output.open(runfile,std::ios::binary);
+	if( not output.is_open() ){
+		throw std::runtime_error("Unable to create sort run "+runfile.string());
+	}
+	this->Runs.push_back(runfile);
+	for( const auto& key : this->Keys ){
+		output.write(reinterpret_cast<const char*>(data + key.Offset),(data[key.Offset]/2)*sizeof(uint32_t));
+	}
+	output.close();
+	if( output.fail() ){
+		throw std::runtime_error("Failed writing sort run "+runfile.string()+", is the scratch disk full?");
+	}
+
+	this->TotalHits += this->Keys.size();
+	this->BytesSpilled += totalWords*sizeof(uint32_t);
+	span.SetArg("hits",this->Keys.size());
+	this->console->info("Sort run {} : {} hits, {:.1f} MB",this->Runs.size() - 1,this->Keys.size(),totalWords*sizeof(uint32_t)/(1024.0*1024.0));
+	this->Keys.clear();
+	rawData->clear();
+	return std::chrono::high_resolution_clock::now() - start_time;
+}
+
+ExternalSorter::RunReader::RunReader(const std::filesystem::path& runfile,size_t buffersize){
+	this->StreamBuffer.resize(buffersize);
+	this->Input.rdbuf()->pubsetbuf(this->StreamBuffer.data(),this->StreamBuffer.size());
+	this->Input.open(runfile,std::ios::binary);
+	if( not this->Input.is_open() ){
+		throw std::runtime_error("Unable to open sort run "+runfile.string());
+	}
+}
+
+bool ExternalSorter::RunReader::ReadWords(){
+	uint32_t eventLength = 0;
+	if( not this->Input.read(reinterpret_cast<char*>(&eventLength),sizeof(uint32_t)) ){
+		return false;
+	}
+	const size_t nwords = eventLength/2;
+	this->Words.resize(std::max<size_t>(nwords,1));
+	this->Words[0] = eventLength;
+	if( nwords > 1 and not this->Input.read(reinterpret_cast<char*>(this->Words.data() + 1),(nwords - 1)*sizeof(uint32_t)) ){
+		throw std::runtime_error("Truncated sort run");
+	}
+	return true;
+}
+
+bool ExternalSorter::RunReader::Next(ddasfmt::DDASHitUnpacker& unpacker){
+	if( not this->ReadWords() ){
+		return false;
+	}
+	this->Hit = std::make_unique<DDASRootHit>();
+	unpacker.unpack(this->Words.data(),this->Words.data() + this->Words[0]/2,*(this->Hit));
+	return true;
+}
+
+bool ExternalSorter::RunReader::NextRaw(ddasfmt::DDASHitUnpacker& unpacker){
+	if( not this->ReadWords() ){
+		return false;
+	}
+	// The same decode as the sort key of AddBlock, so a merged run orders exactly like the final merge
+	this->Scratch.Reset();
+	unpacker.unpack(this->Words.data(),this->Words.data() + this->Words[0]/2,this->Scratch);
+	this->Time = this->Scratch.getFixedTime();
+	return true;
+}
+
+size_t ExternalSorter::MaxFanIn() const{
+	size_t fanin = this->MemoryLimit/2/MIN_READ_BUFFER;
+	// Leave descriptors for the input, output, log and trace files
+	rlimit limit;
+	if( getrlimit(RLIMIT_NOFILE,&limit) == 0 and limit.rlim_cur != RLIM_INFINITY ){
+		const size_t reserved = 64;
+		fanin = std::min<size_t>(fanin,limit.rlim_cur > reserved ? limit.rlim_cur - reserved : 0);
+	}
+	return std::max<size_t>(fanin,2);
+}
+
+std::filesystem::path ExternalSorter::MergeRuns(size_t first,size_t last,unsigned int pass){
+	TraceSpan span("MergePass","sort");
+	span.SetArg("runs",last - first);
+	// One more buffer than runs, the output shares the read budget
+	const size_t buffersize = std::clamp<size_t>(this->MemoryLimit/2/(last - first + 1),MIN_READ_BUFFER,MAX_READ_BUFFER);
+	std::vector<std::unique_ptr<RunReader>> readers;
+	using HeapEntry = std::pair<DDASRootHit::FixedTime,size_t>;
+	std::priority_queue<HeapEntry,std::vector<HeapEntry>,std::greater<HeapEntry>> heap;
+	for( size_t ii = first; ii < last; ++ii ){
+		readers.push_back(std::make_unique<RunReader>(this->Runs[ii],buffersize));
+		if( readers.back()->NextRaw(this->Unpacker) ){
+			heap.push({readers.back()->Time,readers.size() - 1});
+		}
+	}
+
+	const std::filesystem::path runfile = this->ScratchDir.string()+"_p"+std::to_string(pass)+"_"+std::to_string(first)+".run";
+	std::vector<char> streamBuffer(buffersize);
+	std::ofstream output;
+	output.rdbuf()->pubsetbuf(streamBuffer.data(),streamBuffer.size());
+	output.open(runfile,std::ios::binary);
+	if( not output.is_open() ){
+		throw std::runtime_error("Unable to create sort run "+runfile.string());
+	}
+	while( not heap.empty() ){
+		const size_t idx = heap.top().second;
+		heap.pop();
+		const auto& words = readers[idx]->Words;
+		output.write(reinterpret_cast<const char*>(words.data()),(words[0]/2)*sizeof(uint32_t));
+		if( readers[idx]->NextRaw(this->Unpacker) ){
+			heap.push({readers[idx]->Time,idx});
+		}
+	}
+	output.close();
+	if( output.fail() ){
+		std::error_code ec;
+		std::filesystem::remove(runfile,ec);
+		throw std::runtime_error("Failed writing sort run "+runfile.string()+", is the scratch disk full?");
+	}
+	readers.clear();
+	for( size_t ii = first; ii < last; ++ii ){
+		std::error_code ec;
+		std::filesystem::remove(this->Runs[ii],ec);
+	}
+	return runfile;
+}
+
+std::chrono::duration<double> ExternalSorter::Merge(EventBuilder& builder){
+	auto start_time = std::chrono::high_resolution_clock::now();
+	TraceSpan span("MergeRuns","sort");
+	span.SetArg("runs",this->Runs.size());
+	// The sort keys are not needed anymore, hand their memory to the read buffers
+	std::vector<SortKey>().swap(this->Keys);
+
+	// Too many runs to read at once, merge groups of consecutive runs into longer ones first
+	const size_t fanin = this->MaxFanIn();
+	unsigned int pass = 0;
+	while( this->Runs.size() > fanin ){
+		++pass;
+		this->console->info("Merge pass {} : {} sort runs in groups of at most {}",pass,this->Runs.size(),fanin);
+		std::vector<std::filesystem::path> merged;
+		try{
+			for( size_t first = 0; first < this->Runs.size(); first += fanin ){
+				const size_t last = std::min(this->Runs.size(),first + fanin);
+				if( last - first == 1 ){
+					merged.push_back(this->Runs[first]);
+					this->Runs[first].clear();
+					continue;
+				}
+				merged.push_back(this->MergeRuns(first,last,pass));
+				// The merged runs are removed, only files that still exist stay listed for RemoveRuns()
+				for( size_t ii = first; ii < last; ++ii ){
+					this->Runs[ii].clear();
+				}
+			}
+		}catch( ... ){
+			this->Runs.insert(this->Runs.end(),merged.begin(),merged.end());
+			throw;
+		}
+		this->Runs = std::move(merged);
+	}
+
+	this->console->info("Merging {} sort runs with {} hits",this->Runs.size(),this->TotalHits);
+	const size_t buffersize = this->Runs.empty() ? MIN_READ_BUFFER : std::clamp<size_t>(this->MemoryLimit/2/this->Runs.size(),MIN_READ_BUFFER,MAX_READ_BUFFER);
+	std::vector<std::unique_ptr<RunReader>> readers;
+
+	// Earliest hit first, ties go to the earlier run so the parse order is kept
+	using HeapEntry = std::pair<DDASRootHit::FixedTime,size_t>;
+	std::priority_queue<HeapEntry,std::vector<HeapEntry>,std::greater<HeapEntry>> heap;
+	for( const auto& run : this->Runs ){
+		readers.push_back(std::make_unique<RunReader>(run,buffersize));
+		if( readers.back()->Next(this->Unpacker) ){
+			heap.push({readers.back()->Hit->getFixedTime(),readers.size() - 1});
+		}
+	}
+
+	int prog = 10;
+	const uint64_t interval = std::max<uint64_t>(this->TotalHits/10,1);
+	uint64_t merged = 0;
+	while( not heap.empty() ){
+		const size_t idx = heap.top().second;
+		heap.pop();
+		builder.AddHit(std::move(readers[idx]->Hit));
+		if( readers[idx]->Next(this->Unpacker) ){
+			heap.push({readers[idx]->Hit->getFixedTime(),idx});
+		}
+		++merged;
+		if( merged%interval == 0 and prog <= 100 ){
+			this->console->info("Progress: {}%",prog);
+			prog += 10;
+		}
+	}
+	builder.Flush();
+
+	readers.clear();
+	this->RemoveRuns();
+	if( merged != this->TotalHits ){
+		throw std::runtime_error("Merged "+std::to_string(merged)+" hits from the sort runs, expected "+std::to_string(this->TotalHits));
+	}
+	return std::chrono::high_resolution_clock::now() - start_time;
+}
@@ -0,0 +1,119 @@
+#include <filesystem>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "FileFollower.h"
+#include "TraceRecorder.h"
+
+std::atomic<bool> FileFollower::StopRequested{false};
+
+namespace{
+	// Upper bound on a wait, the stop flag and the size are checked at least this often
+	const std::chrono::milliseconds POLL_INTERVAL(500);
+}
+
+FileFollower::FileFollower(const std::string& log,const ldf2root::CmdOptions& cmdopts){
+	this->LogName = log;
+	this->Timeout = std::chrono::seconds(cmdopts.follow_timeout);
+	this->Stopped = false;
+	this->InotifyFD = -1;
+	this->WatchFD = -1;
+	this->console = spdlog::get(this->LogName)->clone("FileFollower");
+#ifdef __linux__
+	this->InotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if( this->InotifyFD < 0 ){
+		this->console->warn("inotify is not available, polling the input file every {} ms",POLL_INTERVAL.count());
+	}
+#else
+	this->console->info("Polling the input file every {} ms",POLL_INTERVAL.count());
+#endif
+}
+
+FileFollower::~FileFollower(){
+#ifdef __linux__
+	if( this->InotifyFD >= 0 ){
+		close(this->InotifyFD);
+	}
+#endif
+}
+
+void FileFollower::Watch(const std::string& filename){
+	if( filename == this->WatchedFile ){
+		return;
+	}
+	this->WatchedFile = filename;
+#ifdef __linux__
+	if( this->InotifyFD < 0 ){
+		return;
+	}
+	if( this->WatchFD >= 0 ){
+		inotify_rm_watch(this->InotifyFD,this->WatchFD);
+	}
+	this->WatchFD = inotify_add_watch(this->InotifyFD,filename.c_str(),IN_MODIFY | IN_CLOSE_WRITE);
+	if( this->WatchFD < 0 ){
+		this->console->warn("Unable to watch {} with inotify, polling it every {} ms",filename,POLL_INTERVAL.count());
+	}
+#endif
+}
+
+void FileFollower::WaitForChange(){
+#ifdef __linux__
+	if( this->WatchFD >= 0 ){
+		pollfd pfd = {this->InotifyFD,POLLIN,0};
+		if( poll(&pfd,1,static_cast<int>(POLL_INTERVAL.count())) > 0 ){
+			// Only the wake up matters, drain the events
+			char events[4096];
+			while( read(this->InotifyFD,events,sizeof(events)) > 0 ){}
+		}
+		return;
+	}
+#endif
+	std::this_thread::sleep_for(POLL_INTERVAL);
+}
+
+bool FileFollower::WaitForSize(const std::string& filename,uint64_t size){
+	if( this->Stopped ){
+		return false;
+	}
+	std::error_code ec;
+	uint64_t current = std::filesystem::file_size(filename,ec);
+	if( not ec and current >= size ){
+		return true;
+	}
+
+	TraceSpan span("WaitForData","io");
+	this->Watch(filename);
+	this->console->debug("Waiting for {} to grow from {} to {} bytes",filename,current,size);
+	auto lastGrowth = std::chrono::steady_clock::now();
+	while( true ){
+		if( StopRequested.load(std::memory_order_relaxed) ){
+			this->console->info("Stopped following {} at {} bytes",filename,current);
+			this->Stopped = true;
+			return false;
+		}
+		this->WaitForChange();
+		const uint64_t now_size = std::filesystem::file_size(filename,ec);
+		if( ec ){
+			this->console->error("Lost the followed file {} : {}",filename,ec.message());
+			this->Stopped = true;
+			return false;
+		}
+		if( now_size >= size ){
+			return true;
+		}
+		const auto now = std::chrono::steady_clock::now();
+		if( now_size != current ){
+			current = now_size;
+			lastGrowth = now;
+		}else if( this->Timeout.count() > 0 and now - lastGrowth >= this->Timeout ){
+			this->console->warn("{} did not grow for {} s, stopped following it at {} bytes",filename,this->Timeout.count(),current);
+			this->Stopped = true;
+			return false;
+		}
+	}
+}
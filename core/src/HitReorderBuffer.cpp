@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "HitReorderBuffer.h"
+#include "TraceRecorder.h"
+
+HitReorderBuffer::HitReorderBuffer(const std::string& log,const ldf2root::CmdOptions& cmdopts,HitSink sink) : LogLimiter(nullptr,10,std::chrono::seconds(30)){
+	this->LogName = log;
+	this->CmdOpts = cmdopts;
+	this->Sink = std::move(sink);
+	this->Horizon = this->CmdOpts.reorder_horizon;
+	if( not (this->Horizon > 0.0) ){
+		throw std::runtime_error("The reorder horizon must be positive, got "+std::to_string(this->Horizon)+" ns");
+	}
+	this->FixedHorizon = DDASRootHit::toFixedInterval(this->Horizon);
+	this->ModuleLatest.fill(DDASRootHit::FixedTime::min());
+	this->ModuleSeen.fill(false);
+	this->NewestTime = DDASRootHit::FixedTime::min();
+	this->Watermark = DDASRootHit::FixedTime::min();
+	this->LastReleased = DDASRootHit::FixedTime::min();
+	this->Released = false;
+	this->Sequence = 0;
+	this->HitsIn = 0;
+	this->HitsOut = 0;
+	this->LateHits = 0;
+	this->MaxLateness = 0.0;
+	this->PeakSize = 0;
+	this->console = spdlog::get(this->LogName)->clone("HitReorderBuffer");
+	this->LogLimiter.SetLogger(this->console);
+	this->LogLimiter.SetLimits(this->CmdOpts.log_burst,std::chrono::seconds(this->CmdOpts.log_interval));
+	this->console->info("Streaming time ordering with a reorder horizon of {} ns",this->Horizon);
+}
+
+HitReorderBuffer::~HitReorderBuffer(){
+	if( not this->Heap.empty() ){
+		this->console->error("HitReorderBuffer destroyed with {} hits that were never released",this->Heap.size());
+	}
+}
+
+void HitReorderBuffer::Push(std::unique_ptr<DDASRootHit> hit){
+	const DDASRootHit::FixedTime time = hit->getFixedTime();
+	const size_t module = ((hit->getCrateID() & 0xF) << 4) | (hit->getSlotID() & 0xF);
+	++this->HitsIn;
+	if( not this->ModuleSeen[module] or time > this->ModuleLatest[module] ){
+		this->ModuleLatest[module] = time;
+		this->ModuleSeen[module] = true;
+	}
+	this->NewestTime = std::max(this->NewestTime,time);
+
+	// Too late to be put in order, the hits around it are already built
+	if( this->Released and time < this->LastReleased ){
+		const double lateness = DDASRootHit::fromFixedInterval(this->LastReleased - time);
+		++this->LateHits;
+		this->MaxLateness = std::max(this->MaxLateness,lateness);
+		if( this->LogLimiter.Allow("late hit") ){
+			this->console->warn("Hit from crate {} slot {} channel {} at {} ns arrived {} ns after hits up to {} ns were released, increase --reorder-horizon",
+				hit->getCrateID(),hit->getSlotID(),hit->getChannelID(),hit->getTime(),lateness,this->LastReleased.toNs());
+		}
+		++this->HitsOut;
+		this->Sink(std::move(hit));
+		return;
+	}
+
+	this->Heap.push_back({time,this->Sequence++,std::move(hit)});
+	std::push_heap(this->Heap.begin(),this->Heap.end(),Later);
+	this->PeakSize = std::max(this->PeakSize,this->Heap.size());
+}
+
+void HitReorderBuffer::Push(UnpackedHitVector* hits){
+	for( auto& hit : *hits ){
+		this->Push(std::move(hit));
+	}
+	hits->clear();
+}
+
+void HitReorderBuffer::UpdateWatermark(){
+	if( this->HitsIn == 0 ){
+		return;
+	}
+	// Modules that fell more than a horizon behind the newest hit are not waited for
+	DDASRootHit::FixedTime oldest = this->NewestTime;
+	for( size_t ii = 0; ii < MAX_MODULES; ++ii ){
+		if( this->ModuleSeen[ii] and this->ModuleLatest[ii] >= this->NewestTime - this->FixedHorizon ){
+			oldest = std::min(oldest,this->ModuleLatest[ii]);
+		}
+	}
+	// The watermark never moves back, a module coming back to life can not undo a release
+	this->Watermark = std::max(this->Watermark,oldest - this->FixedHorizon);
+}
+
+void HitReorderBuffer::ReleaseUpTo(DDASRootHit::FixedTime limit){
+	while( not this->Heap.empty() and this->Heap.front().Time <= limit ){
+		std::pop_heap(this->Heap.begin(),this->Heap.end(),Later);
+		Entry& entry = this->Heap.back();
+		this->LastReleased = entry.Time;
+		this->Released = true;
+		++this->HitsOut;
+		this->Sink(std::move(entry.Hit));
+		this->Heap.pop_back();
+	}
+}
+
+std::chrono::duration<double> HitReorderBuffer::Release(){
+	auto start_time = std::chrono::high_resolution_clock::now();
+	TraceSpan span("ReleaseHits","sort");
+	const uint64_t before = this->HitsOut;
+	this->UpdateWatermark();
+	this->ReleaseUpTo(this->Watermark);
+	this->LogLimiter.Tick();
+	span.SetArg("hits",this->HitsOut - before);
+	span.SetArg("buffered",this->Heap.size());
+	return std::chrono::high_resolution_clock::now() - start_time;
+}
+
+std::chrono::duration<double> HitReorderBuffer::Flush(){
+	auto start_time = std::chrono::high_resolution_clock::now();
+	TraceSpan span("FlushHits","sort");
+	span.SetArg("hits",this->Heap.size());
+	this->ReleaseUpTo(DDASRootHit::FixedTime::max());
+	return std::chrono::high_resolution_clock::now() - start_time;
+}
+
+void HitReorderBuffer::Report(){
+	this->console->info("Streaming time ordering : {} hits in, {} hits out, at most {} hits buffered",this->HitsIn,this->HitsOut,this->PeakSize);
+	if( this->LateHits > 0 ){
+		this->console->warn("{} hits arrived too late to be time ordered (at most {} ns late), a reorder horizon above this keeps them in order",this->LateHits,this->MaxLateness);
+	}
+	this->LogLimiter.Report();
+}
@@ -0,0 +1,659 @@
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef LDF2ROOT_HAS_ZSTD
+#include <zstd.h>
+#include <zstd_errors.h>
+#endif
+#ifdef LDF2ROOT_HAS_LZMA
+#include <lzma.h>
+#endif
+
+#include "InputStream.h"
+#include "TraceRecorder.h"
+
+namespace{
+	const unsigned char ZSTD_MAGIC[4] = {0x28,0xB5,0x2F,0xFD};
+	const unsigned char XZ_MAGIC[6] = {0xFD,'7','z','X','Z',0x00};
+
+	// Decoded bytes per block handed to the reader by the streaming decoders
+	const size_t OUTPUT_BLOCK = 4*1024*1024;
+	// Compressed bytes read from the file at a time
+	const size_t INPUT_CHUNK = 4*1024*1024;
+	// zstd frames larger than this are not buffered whole for a worker, the producer streams them
+	const size_t MAX_PARALLEL_FRAME = 64*1024*1024;
+}
+
+/// @brief Read side of a decompressed stream, the blocks are decoded by a producer thread
+/// @details
+/// Decode() runs in the producer and hands over the decoded blocks in stream order with Emit(),
+/// either finished or as futures of worker jobs, and blocks while the queue is full. The reader
+/// keeps the current and the previous block so it can step back over a block boundary.
+class StreamDecoder : public std::streambuf{
+	public:
+		StreamDecoder(const std::string& path,unsigned int threads){
+			this->Path = path;
+			this->Threads = threads > 0 ? threads : std::max(1u,std::thread::hardware_concurrency());
+			this->Depth = this->Threads + 1;
+			this->Input.open(path,std::ios::binary);
+			this->Finished = false;
+			this->StopFlag = false;
+			this->PrevStart = 0;
+			this->CurrStart = 0;
+			this->InPrev = false;
+		}
+		~StreamDecoder() override{
+			this->Close();
+		}
+
+		bool IsOpen() const { return this->Input.is_open(); }
+
+		/// Stop the producer and drop the queued blocks, also called before the derived decoder goes away
+		void Close(){
+			{
+				std::lock_guard<std::mutex> lock(this->QueueMutex);
+				this->StopFlag = true;
+			}
+			this->QueueCV.notify_all();
+			if( this->Producer.joinable() ){
+				this->Producer.join();
+			}
+			// Waits for the worker jobs still running
+			this->Queue.clear();
+			this->Input.close();
+		}
+
+	protected:
+		/// Start the producer, called at the end of the derived constructor
+		void Start(){
+			if( this->Input.is_open() ){
+				this->Producer = std::thread(&StreamDecoder::Produce,this);
+			}else{
+				this->Finished = true;
+			}
+		}
+		/// Decode the whole input, runs in the producer
+		virtual void Decode() = 0;
+
+		/// Queue the next block, blocks while the queue is full, returns false when the reader went away
+		bool Emit(std::future<std::vector<char>> block){
+			std::unique_lock<std::mutex> lock(this->QueueMutex);
+			this->QueueCV.wait(lock,[this](){ return this->StopFlag or this->Queue.size() < this->Depth; });
+			if( this->StopFlag ){
+				return false;
+			}
+			this->Queue.push_back(std::move(block));
+			lock.unlock();
+			this->QueueCV.notify_all();
+			return true;
+		}
+		bool EmitBlock(std::vector<char>&& block){
+			std::promise<std::vector<char>> ready;
+			ready.set_value(std::move(block));
+			return this->Emit(ready.get_future());
+		}
+		bool Stopping(){
+			std::lock_guard<std::mutex> lock(this->QueueMutex);
+			return this->StopFlag;
+		}
+		/// Append up to INPUT_CHUNK compressed bytes to the input buffer, returns false at the end of the file
+		bool ReadInput(){
+			if( this->InBegin > 0 ){
+				std::memmove(this->In.data(),this->In.data() + this->InBegin,this->InEnd - this->InBegin);
+				this->InEnd -= this->InBegin;
+				this->InBegin = 0;
+			}
+			if( this->In.size() < this->InEnd + INPUT_CHUNK ){
+				this->In.resize(this->InEnd + INPUT_CHUNK);
+			}
+			this->Input.read(this->In.data() + this->InEnd,INPUT_CHUNK);
+			const size_t got = this->Input.gcount();
+			this->InEnd += got;
+			if( this->Input.bad() ){
+				throw std::runtime_error("Failed reading "+this->Path);
+			}
+			return got > 0;
+		}
+
+		std::string Path;
+		unsigned int Threads;
+		std::ifstream Input;
+		// Compressed bytes read but not decoded yet are In[InBegin,InEnd)
+		std::vector<char> In;
+		size_t InBegin = 0;
+		size_t InEnd = 0;
+
+		int_type underflow() override{
+			if( this->gptr() < this->egptr() ){
+				return traits_type::to_int_type(*this->gptr());
+			}
+			if( this->InPrev ){
+				this->InPrev = false;
+				this->setg(this->Curr.data(),this->Curr.data(),this->Curr.data() + this->Curr.size());
+				if( not this->Curr.empty() ){
+					return traits_type::to_int_type(*this->gptr());
+				}
+			}
+			if( not this->NextBlock() ){
+				return traits_type::eof();
+			}
+			return traits_type::to_int_type(*this->gptr());
+		}
+
+		pos_type seekoff(off_type off,std::ios_base::seekdir dir,std::ios_base::openmode which) override{
+			if( not (which & std::ios_base::in) ){
+				return pos_type(off_type(-1));
+			}
+			if( dir == std::ios_base::beg ){
+				return this->SeekTo(off);
+			}else if( dir == std::ios_base::cur ){
+				const uint64_t current = (this->InPrev ? this->PrevStart : this->CurrStart) + (this->gptr() - this->eback());
+				return this->SeekTo(static_cast<off_type>(current) + off);
+			}
+			// The decoded size is only known at the end of the stream
+			return pos_type(off_type(-1));
+		}
+		pos_type seekpos(pos_type pos,std::ios_base::openmode which) override{
+			return this->seekoff(off_type(pos),std::ios_base::beg,which);
+		}
+
+	private:
+		void Produce(){
+			if( TraceRecorder::Instance().IsEnabled() ){
+				TraceRecorder::Instance().SetThreadName("decompress");
+			}
+			try{
+				this->Decode();
+			}catch( ... ){
+				// Thrown by the read that gets to this point of the stream
+				std::promise<std::vector<char>> failed;
+				failed.set_exception(std::current_exception());
+				this->Emit(failed.get_future());
+			}
+			{
+				std::lock_guard<std::mutex> lock(this->QueueMutex);
+				this->Finished = true;
+			}
+			this->QueueCV.notify_all();
+		}
+
+		/// Make the next non empty block current, returns false at the end of the stream
+		bool NextBlock(){
+			while( true ){
+				std::future<std::vector<char>> block;
+				{
+					std::unique_lock<std::mutex> lock(this->QueueMutex);
+					this->QueueCV.wait(lock,[this](){ return this->Finished or not this->Queue.empty(); });
+					if( this->Queue.empty() ){
+						return false;
+					}
+					block = std::move(this->Queue.front());
+					this->Queue.pop_front();
+				}
+				this->QueueCV.notify_all();
+				std::vector<char> next = block.get();
+				if( next.empty() ){
+					continue;
+				}
+				this->PrevStart = this->CurrStart;
+				this->CurrStart += this->Curr.size();
+				this->Prev = std::move(this->Curr);
+				this->Curr = std::move(next);
+				this->InPrev = false;
+				this->setg(this->Curr.data(),this->Curr.data(),this->Curr.data() + this->Curr.size());
+				return true;
+			}
+		}
+
+		pos_type SeekTo(off_type target){
+			if( target < 0 ){
+				return pos_type(off_type(-1));
+			}
+			const uint64_t pos = target;
+			if( pos >= this->CurrStart ){
+				// Forward seeks decode and skip
+				while( pos > this->CurrStart + this->Curr.size() ){
+					if( not this->NextBlock() ){
+						return pos_type(off_type(-1));
+					}
+				}
+				this->InPrev = false;
+				this->setg(this->Curr.data(),this->Curr.data() + (pos - this->CurrStart),this->Curr.data() + this->Curr.size());
+				return pos_type(target);
+			}
+			if( pos >= this->PrevStart and not this->Prev.empty() ){
+				this->InPrev = true;
+				this->setg(this->Prev.data(),this->Prev.data() + (pos - this->PrevStart),this->Prev.data() + this->Prev.size());
+				return pos_type(target);
+			}
+			return pos_type(off_type(-1));
+		}
+
+		size_t Depth; // blocks queued or being decoded
+		std::deque<std::future<std::vector<char>>> Queue;
+		std::mutex QueueMutex;
+		std::condition_variable QueueCV;
+		bool Finished;
+		bool StopFlag;
+		std::thread Producer;
+
+		std::vector<char> Prev;
+		std::vector<char> Curr;
+		uint64_t PrevStart; // stream offset of the first byte of Prev
+		uint64_t CurrStart; // stream offset of the first byte of Curr
+		bool InPrev; // reading from Prev after a seek back
+};
+
+namespace{
+	/// @brief Plain file read ahead in large blocks by a pool of pread workers
+	/// @details
+	/// The producer queues the blocks in file order, every block is read by the next free worker,
+	/// so as many reads as there are workers are in flight. On network and parallel file systems
+	/// this keeps the storage busy while the translator works on the blocks already read.
+	class ReadAheadDecoder : public StreamDecoder{
+		public:
+			ReadAheadDecoder(const std::string& path,unsigned int depth,size_t blocksize) : StreamDecoder(path,depth){
+				this->BlockSize = std::max<size_t>(blocksize,64*1024);
+				this->StopWorkers = false;
+				this->FD = ::open(path.c_str(),O_RDONLY | O_CLOEXEC);
+				if( this->FD < 0 ){
+					this->Input.close();
+				}
+				for( unsigned int id = 0; id < this->Threads; ++id ){
+					this->Workers.emplace_back(&ReadAheadDecoder::Work,this,id);
+				}
+				this->Start();
+			}
+			~ReadAheadDecoder() override{
+				this->Close();
+				{
+					std::lock_guard<std::mutex> lock(this->JobMutex);
+					this->StopWorkers = true;
+				}
+				this->JobCV.notify_all();
+				for( auto& worker : this->Workers ){
+					worker.join();
+				}
+				if( this->FD >= 0 ){
+					::close(this->FD);
+				}
+			}
+
+		protected:
+			void Decode() override{
+				struct stat info;
+				if( fstat(this->FD,&info) != 0 ){
+					throw std::runtime_error("Unable to stat "+this->Path);
+				}
+#ifdef POSIX_FADV_SEQUENTIAL
+				posix_fadvise(this->FD,0,0,POSIX_FADV_SEQUENTIAL);
+#endif
+				const uint64_t size = info.st_size;
+				for( uint64_t offset = 0; offset < size; offset += this->BlockSize ){
+					Job job;
+					job.Offset = offset;
+					job.Size = std::min<uint64_t>(this->BlockSize,size - offset);
+					// Queued first, so no more blocks are read than the queue holds
+					if( not this->Emit(job.Block.get_future()) ){
+						return;
+					}
+					{
+						std::lock_guard<std::mutex> lock(this->JobMutex);
+						this->Jobs.push_back(std::move(job));
+					}
+					this->JobCV.notify_one();
+				}
+			}
+
+		private:
+			struct Job{
+				uint64_t Offset;
+				size_t Size;
+				std::promise<std::vector<char>> Block;
+			};
+
+			void Work(unsigned int id){
+				if( TraceRecorder::Instance().IsEnabled() ){
+					TraceRecorder::Instance().SetThreadName("read ahead "+std::to_string(id));
+				}
+				while( true ){
+					Job job;
+					{
+						std::unique_lock<std::mutex> lock(this->JobMutex);
+						this->JobCV.wait(lock,[this](){ return this->StopWorkers or not this->Jobs.empty(); });
+						if( this->StopWorkers ){
+							return;
+						}
+						job = std::move(this->Jobs.front());
+						this->Jobs.pop_front();
+					}
+					try{
+						job.Block.set_value(this->ReadBlock(job.Offset,job.Size));
+					}catch( ... ){
+						job.Block.set_exception(std::current_exception());
+					}
+				}
+			}
+
+			std::vector<char> ReadBlock(uint64_t offset,size_t size){
+				TraceSpan span("ReadAhead","io");
+				span.SetArg("bytes",size);
+				std::vector<char> block(size);
+				size_t done = 0;
+				while( done < size ){
+					const ssize_t got = pread(this->FD,block.data() + done,size - done,offset + done);
+					if( got < 0 ){
+						if( errno == EINTR ){
+							continue;
+						}
+						throw std::runtime_error("Failed reading "+this->Path+" at byte "+std::to_string(offset + done)+" : "+std::strerror(errno));
+					}
+					if( got == 0 ){
+						// Truncated while reading, the translator sees the early end of the file
+						break;
+					}
+					done += got;
+				}
+				block.resize(done);
+				return block;
+			}
+
+			int FD;
+			size_t BlockSize;
+			std::vector<std::thread> Workers;
+			std::deque<Job> Jobs;
+			std::mutex JobMutex;
+			std::condition_variable JobCV;
+			bool StopWorkers;
+	};
+}
+
+#ifdef LDF2ROOT_HAS_ZSTD
+namespace{
+	/// @brief zstd stream, complete frames are decompressed in parallel by worker jobs
+	class ZstdDecoder : public StreamDecoder{
+		public:
+			ZstdDecoder(const std::string& path,unsigned int threads) : StreamDecoder(path,threads){
+				this->Stream = ZSTD_createDCtx();
+				if( this->Stream == nullptr ){
+					throw std::runtime_error("Unable to create a zstd decompression context");
+				}
+				this->Start();
+			}
+			~ZstdDecoder() override{
+				this->Close();
+				ZSTD_freeDCtx(this->Stream);
+			}
+
+		protected:
+			void Decode() override{
+				while( not this->Stopping() ){
+					if( this->InBegin == this->InEnd and not this->ReadInput() ){
+						return;
+					}
+					const size_t frame = ZSTD_findFrameCompressedSize(this->In.data() + this->InBegin,this->InEnd - this->InBegin);
+					if( ZSTD_isError(frame) ){
+						if( ZSTD_getErrorCode(frame) != ZSTD_error_srcSize_wrong ){
+							throw std::runtime_error("Corrupt zstd data in "+this->Path+" : "+ZSTD_getErrorName(frame));
+						}
+						// The frame is not complete in the buffer yet
+						if( this->InEnd - this->InBegin < MAX_PARALLEL_FRAME ){
+							if( not this->ReadInput() ){
+								throw std::runtime_error("Truncated zstd frame at the end of "+this->Path);
+							}
+						}else if( not this->StreamFrame() ){
+							return;
+						}
+						continue;
+					}
+					std::vector<char> src(this->In.begin() + this->InBegin,this->In.begin() + this->InBegin + frame);
+					this->InBegin += frame;
+					if( not this->Emit(std::async(std::launch::async,DecompressFrame,std::move(src),this->Path)) ){
+						return;
+					}
+				}
+			}
+
+		private:
+			/// Decompress one complete frame, runs in a worker
+			static std::vector<char> DecompressFrame(const std::vector<char>& src,const std::string& path){
+				std::vector<char> out;
+				const unsigned long long size = ZSTD_getFrameContentSize(src.data(),src.size());
+				if( size != ZSTD_CONTENTSIZE_UNKNOWN and size != ZSTD_CONTENTSIZE_ERROR ){
+					out.resize(size);
+					const size_t ret = ZSTD_decompress(out.data(),out.size(),src.data(),src.size());
+					if( ZSTD_isError(ret) ){
+						throw std::runtime_error("Corrupt zstd frame in "+path+" : "+ZSTD_getErrorName(ret));
+					}
+					out.resize(ret);
+					return out;
+				}
+				// Written without the content size, e.g. from a pipe
+				std::unique_ptr<ZSTD_DCtx,size_t(*)(ZSTD_DCtx*)> stream(ZSTD_createDCtx(),ZSTD_freeDCtx);
+				ZSTD_inBuffer input = {src.data(),src.size(),0};
+				size_t ret = 1;
+				while( ret != 0 ){
+					const size_t done = out.size();
+					out.resize(done + OUTPUT_BLOCK);
+					ZSTD_outBuffer output = {out.data() + done,OUTPUT_BLOCK,0};
+					ret = ZSTD_decompressStream(stream.get(),&output,&input);
+					if( ZSTD_isError(ret) ){
+						throw std::runtime_error("Corrupt zstd frame in "+path+" : "+ZSTD_getErrorName(ret));
+					}
+					out.resize(done + output.pos);
+					if( ret != 0 and input.pos == input.size and output.pos < OUTPUT_BLOCK ){
+						throw std::runtime_error("Truncated zstd frame in "+path);
+					}
+				}
+				return out;
+			}
+
+			/// Decompress a frame too large to buffer in the producer, block by block, returns false when the reader went away
+			bool StreamFrame(){
+				TraceSpan span("DecompressFrame","io");
+				ZSTD_DCtx_reset(this->Stream,ZSTD_reset_session_only);
+				size_t ret = 1;
+				while( ret != 0 ){
+					std::vector<char> out(OUTPUT_BLOCK);
+					ZSTD_outBuffer output = {out.data(),out.size(),0};
+					while( ret != 0 and output.pos < output.size ){
+						if( this->InBegin == this->InEnd and not this->ReadInput() ){
+							throw std::runtime_error("Truncated zstd frame at the end of "+this->Path);
+						}
+						ZSTD_inBuffer input = {this->In.data() + this->InBegin,this->InEnd - this->InBegin,0};
+						ret = ZSTD_decompressStream(this->Stream,&output,&input);
+						if( ZSTD_isError(ret) ){
+							throw std::runtime_error("Corrupt zstd data in "+this->Path+" : "+ZSTD_getErrorName(ret));
+						}
+						this->InBegin += input.pos;
+					}
+					out.resize(output.pos);
+					if( not this->EmitBlock(std::move(out)) ){
+						return false;
+					}
+				}
+				return true;
+			}
+
+			ZSTD_DCtx* Stream;
+	};
+}
+#endif
+
+#ifdef LDF2ROOT_HAS_LZMA
+namespace{
+	/// @brief xz stream, liblzma decodes the blocks of the stream on its own threads
+	class XzDecoder : public StreamDecoder{
+		public:
+			XzDecoder(const std::string& path,unsigned int threads) : StreamDecoder(path,threads){
+				this->Stream = LZMA_STREAM_INIT;
+#if LZMA_VERSION >= 50040002
+				lzma_mt mt = {};
+				mt.flags = LZMA_CONCATENATED;
+				mt.threads = this->Threads;
+				mt.timeout = 0;
+				mt.memlimit_threading = std::max<uint64_t>(lzma_physmem()/4,64*1024*1024);
+				mt.memlimit_stop = UINT64_MAX;
+				const lzma_ret ret = lzma_stream_decoder_mt(&this->Stream,&mt);
+#else
+				const lzma_ret ret = lzma_stream_decoder(&this->Stream,UINT64_MAX,LZMA_CONCATENATED);
+#endif
+				if( ret != LZMA_OK ){
+					throw std::runtime_error("Unable to create an xz decoder, liblzma error "+std::to_string(ret));
+				}
+				this->Start();
+			}
+			~XzDecoder() override{
+				this->Close();
+				lzma_end(&this->Stream);
+			}
+
+		protected:
+			void Decode() override{
+				bool eof = false;
+				lzma_ret ret = LZMA_OK;
+				while( ret != LZMA_STREAM_END and not this->Stopping() ){
+					TraceSpan span("DecompressBlock","io");
+					std::vector<char> out(OUTPUT_BLOCK);
+					this->Stream.next_out = reinterpret_cast<uint8_t*>(out.data());
+					this->Stream.avail_out = out.size();
+					while( ret != LZMA_STREAM_END and this->Stream.avail_out > 0 ){
+						if( this->InBegin == this->InEnd and not eof ){
+							eof = not this->ReadInput();
+						}
+						this->Stream.next_in = reinterpret_cast<const uint8_t*>(this->In.data() + this->InBegin);
+						this->Stream.avail_in = this->InEnd - this->InBegin;
+						ret = lzma_code(&this->Stream,eof ? LZMA_FINISH : LZMA_RUN);
+						this->InBegin = this->InEnd - this->Stream.avail_in;
+						if( ret != LZMA_OK and ret != LZMA_STREAM_END ){
+							throw std::runtime_error("Corrupt xz data in "+this->Path+", liblzma error "+std::to_string(ret));
+						}
+					}
+					out.resize(out.size() - this->Stream.avail_out);
+					if( not this->EmitBlock(std::move(out)) ){
+						return;
+					}
+				}
+			}
+
+		private:
+			lzma_stream Stream;
+	};
+}
+#endif
+
+InputStream::InputStream() : std::istream(nullptr){
+	this->FileCompression = Compression::NONE;
+	this->DecompressThreads = 0;
+	this->ReadAheadDepth = 0;
+	this->ReadBlockSize = 0;
+	this->rdbuf(&this->File);
+}
+
+InputStream::~InputStream(){
+	// The decoder must not be destroyed while the stream still points at it
+	this->exceptions(std::ios_base::goodbit);
+	this->rdbuf(nullptr);
+}
+
+InputStream::Compression InputStream::Detect(const std::string& path){
+	std::ifstream input(path,std::ios::binary);
+	unsigned char magic[6] = {0,0,0,0,0,0};
+	input.read(reinterpret_cast<char*>(magic),sizeof(magic));
+	const size_t got = input.gcount();
+	if( got >= sizeof(ZSTD_MAGIC) and std::memcmp(magic,ZSTD_MAGIC,sizeof(ZSTD_MAGIC)) == 0 ){
+		return Compression::ZSTD;
+	}
+	if( got >= sizeof(XZ_MAGIC) and std::memcmp(magic,XZ_MAGIC,sizeof(XZ_MAGIC)) == 0 ){
+		return Compression::XZ;
+	}
+	return Compression::NONE;
+}
+
+const char* InputStream::CompressionName(Compression compression){
+	switch( compression ){
+		case Compression::ZSTD:
+			return "zstd";
+		case Compression::XZ:
+			return "xz";
+		default:
+			return "none";
+	}
+}
+
+bool InputStream::IsSupported(Compression compression){
+	switch( compression ){
+		case Compression::NONE:
+			return true;
+#ifdef LDF2ROOT_HAS_ZSTD
+		case Compression::ZSTD:
+			return true;
+#endif
+#ifdef LDF2ROOT_HAS_LZMA
+		case Compression::XZ:
+			return true;
+#endif
+		default:
+			return false;
+	}
+}
+
+void InputStream::open(const std::string& path,std::ios_base::openmode mode){
+	this->exceptions(std::ios_base::goodbit);
+	this->rdbuf(&this->File);
+	this->File.close();
+	this->Decoder.reset();
+	this->FileCompression = Detect(path);
+	if( this->FileCompression == Compression::NONE and this->ReadAheadDepth > 0 ){
+		this->Decoder = std::make_unique<ReadAheadDecoder>(path,this->ReadAheadDepth,this->ReadBlockSize);
+	}else if( this->FileCompression == Compression::NONE ){
+		if( this->File.open(path,mode | std::ios_base::in) == nullptr ){
+			this->setstate(std::ios_base::failbit);
+		}
+		return;
+	}else if( not IsSupported(this->FileCompression) ){
+		throw std::runtime_error(path+" is "+CompressionName(this->FileCompression)+" compressed and ldf2root was built without "+CompressionName(this->FileCompression)+" support, decompress it first");
+	}
+#ifdef LDF2ROOT_HAS_ZSTD
+	if( this->FileCompression == Compression::ZSTD ){
+		this->Decoder = std::make_unique<ZstdDecoder>(path,this->DecompressThreads);
+	}
+#endif
+#ifdef LDF2ROOT_HAS_LZMA
+	if( this->FileCompression == Compression::XZ ){
+		this->Decoder = std::make_unique<XzDecoder>(path,this->DecompressThreads);
+	}
+#endif
+	this->rdbuf(this->Decoder.get());
+	if( not this->Decoder->IsOpen() ){
+		this->setstate(std::ios_base::failbit);
+	}
+	// A decoding error is thrown out of the read instead of only setting the badbit
+	this->exceptions(std::ios_base::badbit);
+}
+
+bool InputStream::is_open() const{
+	return this->Decoder ? this->Decoder->IsOpen() : this->File.is_open();
+}
+
+void InputStream::close(){
+	// Like std::ifstream the stream state is kept, the translator checks eof() after closing
+	if( this->Decoder ){
+		this->Decoder->Close();
+	}else if( this->File.close() == nullptr ){
+		this->setstate(std::ios_base::failbit);
+	}
+}
@@ -1,18 +1,27 @@
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <limits>
 #include <stdexcept>
 
+#include "FileFollower.h"
 #include "LDFPixieTranslator.h"
 #include "Translator.h"
+#include "TraceRecorder.h"
 
 
 LDFPixieTranslator::LDFPixieTranslator(const std::string& logname,const std::string& translatorname, const ldf2root::CmdOptions& cmdopts) : Translator(logname,translatorname){
 	this->PrevTimeStamp = 0;
 	this->CurrSpillID = 0;
+	this->KeepSpills = cmdopts.spill_tree and not cmdopts.scan;
+	this->SpillsRead = 0;
+	this->MissingBefore = 0;
 	this->EvtSpillCounter = std::vector<int>(this->NUMCONCURRENTSPILLS,0);
 	this->FinishedReadingFiles = false;
 	this->CmdOpts = cmdopts;
+	this->LogLimiter.SetLimits(this->CmdOpts.log_burst,std::chrono::seconds(this->CmdOpts.log_interval));
 	this->CurrDirBuff = { 
 		.dirBuffType = HRIBF_TYPES::DIR, 
 		.dirBufferSize = 8192, 
@@ -51,6 +60,12 @@ LDFPixieTranslator::LDFPixieTranslator(const std::string& logname,const std::str
 		.buffer2 = std::vector<uint32_t>(this->CurrDirBuff.fileBufferSize,0xFFFFFFFF)
 	};
 	this->NTotalWords = 0;
+	this->CurrentFile.SetDecompressThreads(this->CmdOpts.decompress_threads);
+	// A followed file is still growing, it is read as it is written
+	this->CurrentFile.SetReadAhead(this->CmdOpts.follow ? 0 : this->CmdOpts.read_ahead,this->CmdOpts.read_block_kb*1024);
+	if( this->CmdOpts.follow ){
+		this->Follower = std::make_unique<FileFollower>(logname,this->CmdOpts);
+	}
 }
 
 LDFPixieTranslator::~LDFPixieTranslator(){
@@ -70,29 +85,14 @@ Translator::TRANSLATORSTATE LDFPixieTranslator::Parse(std::vector<uint32_t>* raw
 		return Translator::TRANSLATORSTATE::COMPLETE;
   }
 	if( this->FinishedCurrentFile ){
-		if( this->OpenNextFile() ){
-			if( this->ParseDirBuffer() == -1 ){
-				throw std::runtime_error("Invalid Dir Buffer when opening file : "+this->InputFiles.at(this->CurrentFileIndex));
-			}
-			if( this->ParseHeadBuffer() == -1 ){
-				throw std::runtime_error("Invalid Head Buffer when opening file : "+this->InputFiles.at(this->CurrentFileIndex));
-			}
-			this->CurrDataBuff.bcount = 0;
-		}else{
+		if( not this->StartNextFile() ){
 			this->FinishedReadingFiles = true;
 		}
 	}
 	while( not this->FinishedReadingFiles and (this->CountBuffersWithData() < this->NUMCONCURRENTSPILLS) ){
-		if( this->CurrentFile.eof() ){
-			if( this->OpenNextFile() ){
-				if( this->ParseDirBuffer() == -1 ){
-					throw std::runtime_error("Invalid Dir Buffer when opening file : "+this->InputFiles.at(this->CurrentFileIndex));
-				}
-				if( this->ParseHeadBuffer() == -1 ){
-					throw std::runtime_error("Invalid Head Buffer when opening file : "+this->InputFiles.at(this->CurrentFileIndex));
-				}
-				this->CurrDataBuff.bcount = 0;
-			}else{
+		// A followed file never reaches its end of file, it is done once its double EOF buffer was read
+		if( this->CurrentFile.eof() or (this->Follower and this->FinishedCurrentFile) ){
+			if( not this->StartNextFile() ){
 				this->FinishedReadingFiles = true;
 			}
 		}
@@ -105,14 +105,36 @@ Translator::TRANSLATORSTATE LDFPixieTranslator::Parse(std::vector<uint32_t>* raw
 		bool bad_spill;
 		uint32_t nBytes = 0;
 		// this->console->info("Reading file : {}, SpillID {}",this->InputFiles.at(this->CurrentFileIndex), this->CurrSpillID);
-		int retval = this->ParseDataBuffer(nBytes,full_spill,bad_spill);
+		int retval;
+		this->BeginSpill();
+		{
+			TraceSpan span("ParseDataBuffer","parse");
+			span.SetArg("spill",this->CurrSpillID);
+			retval = this->ParseDataBuffer(nBytes,full_spill,bad_spill);
+		}
+		if( this->Follower and this->Follower->IsStopped() ){
+			// The spill being read is incomplete, it is dropped
+			this->FinishedReadingFiles = true;
+			break;
+		}
 		if( retval == -1 ){
-			throw std::runtime_error("Invalid Data Buffer in File : "+this->InputFiles.at(this->CurrentFileIndex));
+			throw std::runtime_error("Invalid Data Buffer in File : "+this->InputFiles.at(this->CurrentFileIndex-1));
 		}
 		// Read in complete file and had no spill errors
-		if( full_spill and  retval != 2){
+		const bool unpacked = full_spill and retval != 2;
+		if( unpacked ){
+			TraceSpan span("UnpackData","unpack");
+			span.SetArg("words",nBytes/4);
 			this->UnpackData(rawData,nBytes,full_spill,bad_spill);
 		}
+		// 0 is a complete spill, 4 and 5 a spill that ended in an error, the others did not read a spill
+		if( retval == 0 or retval == 4 or retval == 5 ){
+			this->EndSpill(nBytes,unpacked);
+		}
+		// Hand the block back once it is large enough, the caller calls Parse() again for the rest
+		if( this->CmdOpts.parse_block_words > 0 and rawData->size() >= this->CmdOpts.parse_block_words ){
+			break;
+		}
 	}
 
 	if (this->FinishedReadingFiles) {
@@ -121,6 +143,80 @@ Translator::TRANSLATORSTATE LDFPixieTranslator::Parse(std::vector<uint32_t>* raw
 	return Translator::TRANSLATORSTATE::PARSING;
 }
 
+Translator::ParseStats LDFPixieTranslator::GetParseStats() const{
+	// The header strings are padded with spaces
+	const auto trimmed = [](const char* text){
+		std::string str(text);
+		str.erase(str.find_last_not_of(' ') + 1);
+		return str;
+	};
+	Translator::ParseStats stats;
+	stats.Spills = this->CurrSpillID;
+	stats.GoodChunks = this->CurrDataBuff.goodchunks;
+	stats.MissingChunks = this->CurrDataBuff.missingchunks;
+	stats.RunNumber = this->CurrHeadBuff.run_num;
+	stats.RunTitle = trimmed(this->CurrHeadBuff.run_title);
+	stats.RunDate = trimmed(this->CurrHeadBuff.date);
+	return stats;
+}
+
+std::vector<Translator::SpillInfo> LDFPixieTranslator::TakeSpills(){
+	std::vector<Translator::SpillInfo> spills;
+	spills.swap(this->Spills);
+	return spills;
+}
+
+void LDFPixieTranslator::BeginSpill(){
+	if( not this->KeepSpills ){
+		return;
+	}
+	this->CurrSpill = Translator::SpillInfo();
+	this->CurrSpill.Spill = this->SpillsRead;
+	this->CurrSpill.File = this->CurrentFileIndex - 1;
+	this->CurrSpill.FirstTime = std::numeric_limits<uint64_t>::max();
+	this->MissingBefore = this->CurrDataBuff.missingchunks;
+}
+
+void LDFPixieTranslator::EndSpill(uint32_t nBytes,bool unpacked){
+	++this->SpillsRead;
+	this->LogLimiter.Tick();
+	if( not this->KeepSpills ){
+		return;
+	}
+	this->CurrSpill.Words = nBytes/4;
+	this->CurrSpill.MissingChunks = this->CurrDataBuff.missingchunks - this->MissingBefore;
+	if( this->CurrSpill.MissingChunks > 0 ){
+		this->CurrSpill.Flags |= Translator::SpillInfo::MISSING_CHUNKS;
+	}
+	if( not unpacked ){
+		this->CurrSpill.Flags |= Translator::SpillInfo::NOT_UNPACKED;
+	}
+	if( this->CurrSpill.Hits == 0 ){
+		this->CurrSpill.FirstTime = 0;
+	}
+	this->Spills.push_back(this->CurrSpill);
+}
+
+bool LDFPixieTranslator::StartNextFile(){
+	if( not this->OpenNextFile() ){
+		return false;
+	}
+	// A followed file may not have its DIR and HEAD buffers yet
+	if( not this->WaitForData(2*this->CurrDirBuff.fileBufferSize*sizeof(uint32_t)) ){
+		return false;
+	}
+	// The DIR and HEAD buffers are found by their index in the file
+	this->buffersRead = 0;
+	if( this->ParseDirBuffer() == -1 ){
+		throw std::runtime_error("Invalid Dir Buffer when opening file : "+this->InputFiles.at(this->CurrentFileIndex-1));
+	}
+	if( this->ParseHeadBuffer() == -1 ){
+		throw std::runtime_error("Invalid Head Buffer when opening file : "+this->InputFiles.at(this->CurrentFileIndex-1));
+	}
+	this->CurrDataBuff.bcount = 0;
+	return true;
+}
+
 int LDFPixieTranslator::ParseDirBuffer(){
 	// With the current file, check the buffer type and make sure it matches the DIR buffer type
 	this->CurrentFile.read(reinterpret_cast<char*>(&(this->check_bufftype)),sizeof(uint32_t));
@@ -212,7 +308,12 @@ int LDFPixieTranslator::ParseDataBuffer(uint32_t& nBytes,bool& full_spill,bool&
 	nBytes = 0;
 
 	while( true ){
-		if( this->ReadNextBuffer() == -1 and (this->CurrDataBuff.buffhead != HRIBF_TYPES::ENDFILE) ){
+		const int readstatus = this->ReadNextBuffer();
+		if( readstatus == 3 ){
+			// Following the input stopped before the next buffer was written
+			return 7;
+		}
+		if( readstatus == -1 and (this->CurrDataBuff.buffhead != HRIBF_TYPES::ENDFILE) ){
 			this->console->critical("Failed to read from input data file");
 			// Return if we failed to read the next buffer
 			return 6;
@@ -241,40 +342,58 @@ int LDFPixieTranslator::ParseDataBuffer(uint32_t& nBytes,bool& full_spill,bool&
 			current_chunk_num = this->CurrDataBuff.currbuffer->at(this->CurrDataBuff.buffpos++);
 
 			if( first_chunk ){
+				this->CurrSpill.Offset = (this->buffersRead + this->CurrDataBuff.bcount - 1)*this->CurrDirBuff.fileBufferSize*sizeof(uint32_t)
+					+ (this->CurrDataBuff.buffpos - 3)*sizeof(uint32_t);
+				this->CurrSpill.Chunks = total_num_chunks;
 				if( current_chunk_num != 0 ){
-					this->console->critical("first chunk {} isn't chunk 0 at spill {}",current_chunk_num,this->CurrSpillID);
+					if( this->LogLimiter.Allow("first chunk") ){
+						this->console->critical("first chunk {} isn't chunk 0 at spill {}",current_chunk_num,this->CurrSpillID);
+					}
 					this->CurrDataBuff.missingchunks += current_chunk_num;
+					this->CurrSpill.Flags |= Translator::SpillInfo::INCOMPLETE;
 					full_spill = false;
 				}else{
 					full_spill = true;
 				}
 				first_chunk = false;
 			}else if( total_num_chunks != prev_num_chunks ){
-				this->console->critical("Gotten out of order parsing spill {}",this->CurrSpillID);
+				if( this->LogLimiter.Allow("out of order chunk") ){
+					this->console->critical("Gotten out of order parsing spill {}",this->CurrSpillID);
+				}
+				this->CurrSpill.Flags |= Translator::SpillInfo::MISSING_CHUNKS;
 				this->ReadNextBuffer(true);
 				this->CurrDataBuff.missingchunks += (prev_num_chunks - 1) - prev_chunk_num;
 				return 4; 
 			}else if( current_chunk_num != prev_chunk_num+1 ){
 				full_spill = false;
-				if( current_chunk_num == prev_chunk_num+2 ){
-					this->console->critical("Missing single spill chunk {} at spill {}",prev_chunk_num+1,this->CurrSpillID);
-				}else{
-					this->console->critical("Missing multiple spill chunks from {} to {} at spill {}",prev_chunk_num+1,current_chunk_num-1,this->CurrSpillID);
+				if( this->LogLimiter.Allow("missing chunk") ){
+					if( current_chunk_num == prev_chunk_num+2 ){
+						this->console->critical("Missing single spill chunk {} at spill {}",prev_chunk_num+1,this->CurrSpillID);
+					}else{
+						this->console->critical("Missing multiple spill chunks from {} to {} at spill {}",prev_chunk_num+1,current_chunk_num-1,this->CurrSpillID);
+					}
 				}
 				this->ReadNextBuffer(true);
 				this->CurrDataBuff.missingchunks += std::abs(static_cast<double>(static_cast<double>(current_chunk_num - 1) - prev_chunk_num));
+				this->CurrSpill.Flags |= Translator::SpillInfo::MISSING_CHUNKS;
 				return 4;
 			}
 
 			if( current_chunk_num == total_num_chunks - 1) {//spill footer
 				if( this_chunk_sizeB != 20 ){
-					this->console->critical("spill footer (chunk {} of {}) has size {} != 5 at spill {}",current_chunk_num,total_num_chunks,this_chunk_sizeB,this->CurrSpillID);
+					if( this->LogLimiter.Allow("bad spill footer") ){
+						this->console->critical("spill footer (chunk {} of {}) has size {} != 5 at spill {}",current_chunk_num,total_num_chunks,this_chunk_sizeB,this->CurrSpillID);
+					}
+					this->CurrSpill.Flags |= Translator::SpillInfo::BAD_FOOTER;
 					this->ReadNextBuffer(true);
 					return 5;
 				}
 				//memcpy(&data_[nBytes],&curr_buffer[buff_pos],8)
 				// this->console->info("Found spill footer chunk {} of {}, size {} at spill {}",current_chunk_num+1,total_num_chunks,this_chunk_sizeB, this->CurrSpillID);
-				this->console->info("Found spill footer at offset 0x{:X}", this->CurrentFile.tellg());
+				// tellg() is only worth calling if the message is actually going to be written
+				if( this->console->should_log(spdlog::level::debug) and this->LogLimiter.Allow("spill footer") ){
+					this->console->debug("Found spill footer at offset 0x{:X}", static_cast<int64_t>(this->CurrentFile.tellg()));
+				}
 				uint32_t nWords = 2;
 				for( uint32_t ii = 0; ii < nWords; ++ii ){
 					this->databuffer.push_back(this->CurrDataBuff[this->CurrDataBuff.buffpos+ii]);
@@ -291,8 +410,11 @@ int LDFPixieTranslator::ParseDataBuffer(uint32_t& nBytes,bool& full_spill,bool&
 				//would have to compare against uktscanor output though
 				//is probably fine though
 				if( this_chunk_sizeB < 12 ){
-					this->console->critical("invalid number of bytes in chunk {} of {}, {} bytes at spill {}",current_chunk_num+1,total_num_chunks,this_chunk_sizeB,this->CurrSpillID);
+					if( this->LogLimiter.Allow("bad chunk size") ){
+						this->console->critical("invalid number of bytes in chunk {} of {}, {} bytes at spill {}",current_chunk_num+1,total_num_chunks,this_chunk_sizeB,this->CurrSpillID);
+					}
 					++this->CurrDataBuff.missingchunks;
+					this->CurrSpill.Flags |= Translator::SpillInfo::BAD_CHUNK;
 					return 4;
 				}
 				++this->CurrDataBuff.goodchunks;
@@ -316,9 +438,16 @@ int LDFPixieTranslator::ParseDataBuffer(uint32_t& nBytes,bool& full_spill,bool&
 }
 
 int LDFPixieTranslator::ReadNextBuffer(bool force){
+	const uint64_t bufferBytes = this->CurrDirBuff.fileBufferSize*sizeof(uint32_t);
 	if( this->CurrDataBuff.bcount == 0 ){
+		// The first call reads the current and the next buffer
+		if( not this->WaitForData(2*bufferBytes) ){
+			return 3;
+		}
+		TraceSpan span("ReadBuffer","io");
 		// This seems super jank... really trying to read the curren data buffer into a vector of unsigned ints.
 		this->CurrentFile.read(reinterpret_cast<char*>(&(this->CurrDataBuff.buffer1[0])),this->CurrDirBuff.fileBufferSize*sizeof(uint32_t));
+		this->BytesRead += this->CurrentFile.gcount();
 	}else if( this->CurrDataBuff.buffpos + 3 < this->CurrDirBuff.fileBufferSize and not force ){
 		while( this->CurrDataBuff.currbuffer->at(this->CurrDataBuff.buffpos) == HRIBF_TYPES::ENDBUFF and  this->CurrDataBuff.buffpos < 8193 ){
 			++(this->CurrDataBuff.buffpos);
@@ -327,12 +456,19 @@ int LDFPixieTranslator::ReadNextBuffer(bool force){
 			return 0;
 		}
 	}
+	// The next buffer is read ahead, in follow mode it has to be complete before the current one is used
+	if( this->CurrDataBuff.bcount > 0 and not this->WaitForData(bufferBytes) ){
+		return 3;
+	}
+	TraceSpan span("ReadBuffer","io");
 	if( this->CurrDataBuff.bcount % 2 == 0 ){
 		this->CurrentFile.read(reinterpret_cast<char*>(&(this->CurrDataBuff.buffer2[0])),this->CurrDirBuff.fileBufferSize*sizeof(uint32_t));
+		this->BytesRead += this->CurrentFile.gcount();
 		this->CurrDataBuff.currbuffer = &(this->CurrDataBuff.buffer1);
 		this->CurrDataBuff.nextbuffer = &(this->CurrDataBuff.buffer2);
 	}else{
 		this->CurrentFile.read(reinterpret_cast<char*>(&(this->CurrDataBuff.buffer1[0])),this->CurrDirBuff.fileBufferSize*sizeof(uint32_t));
+		this->BytesRead += this->CurrentFile.gcount();
 		this->CurrDataBuff.currbuffer = &(this->CurrDataBuff.buffer2);
 		this->CurrDataBuff.nextbuffer = &(this->CurrDataBuff.buffer1);
 	}
@@ -354,14 +490,16 @@ int LDFPixieTranslator::ReadNextBuffer(bool force){
 
 // UnpackData for the current spill
 int LDFPixieTranslator::UnpackData(std::vector<uint32_t>* rawData,uint32_t& nBytes,bool& full_spill,bool& bad_spill){
-	if(bad_spill){
+	if(bad_spill and this->LogLimiter.Allow("bad spill")){
 		this->console->info("Bad Spill, skipping unpacking");
 	}
-	if(!full_spill){
+	if(!full_spill and this->LogLimiter.Allow("incomplete spill")){
 		this->console->info("Incomplete Spill, skipping unpacking");
 	}
 
-	this->console->info("Unpacking Data for Spill ID : {}",this->CurrSpillID);
+	if( this->console->should_log(spdlog::level::debug) and this->LogLimiter.Allow("unpack spill") ){
+		this->console->debug("Unpacking Data for Spill ID : {}",this->CurrSpillID);
+	}
 	uint32_t nWords = nBytes/4;
 	// this->console->info("nBytes : {}\tnWords: {}\tBufferSize: {}",nBytes,nWords, this->databuffer.size());
 	uint32_t nWords_read = 0;
@@ -417,7 +555,10 @@ int LDFPixieTranslator::UnpackData(std::vector<uint32_t>* rawData,uint32_t& nByt
 		}else{
 			++(this->CurrSpillID);
 			this->databuffer.clear();
-			this->console->critical("UNEXPECTED VSN : {}",vsn);
+			this->CurrSpill.Flags |= Translator::SpillInfo::UNEXPECTED_VSN;
+			if( this->LogLimiter.Allow("unexpected vsn") ){
+				this->console->critical("UNEXPECTED VSN : {}",vsn);
+			}
 			break;
 		}
 	}
@@ -457,6 +598,19 @@ void LDFPixieTranslator::TransferRawDataWords(std::vector<uint32_t>* rawData, ui
 	const std::array<uint32_t, 3> modArray = CmdOpts.mod_params_map[moduleCratePair];
 	uint32_t DDASWord2 = (modArray[0] & 0xFFFF)|((modArray[1]<<16)&0x00FF0000)|((modArray[2]<<24)&0xFF000000);
 
+	if( this->KeepSpills ){
+		auto& spill = this->CurrSpill;
+		++spill.Hits;
+		++spill.ModuleHits[((moduleCratePair.first & 0xF) << 4) | (moduleCratePair.second & 0xF)];
+		// Words 1 and 2 hold the 48 bit timestamp, in 8 ns steps in the 250 MSPS modules and in 10 ns steps otherwise
+		if( eventLength > 2 and buffpos + 2 < this->databuffer.size() ){
+			const uint64_t tstamp = (static_cast<uint64_t>(this->databuffer[buffpos + 2] & 0xFFFF) << 32) | this->databuffer[buffpos + 1];
+			const uint64_t time = tstamp*(modArray[0] == 250 ? 8 : 10);
+			spill.FirstTime = std::min(spill.FirstTime,time);
+			spill.LastTime = std::max(spill.LastTime,time);
+		}
+	}
+
 	rawData->push_back(DDASWord1);
 	rawData->push_back(DDASWord2);
 	for (uint32_t i = 0; i < eventLength; ++i) {
@@ -0,0 +1,56 @@
+#include "LogRateLimiter.h"
+
+LogRateLimiter::LogRateLimiter(std::shared_ptr<spdlog::logger> logger,uint32_t burst,std::chrono::seconds interval){
+	this->console = logger;
+	this->Burst = burst;
+	this->Interval = interval;
+}
+
+bool LogRateLimiter::Allow(std::string_view category){
+	const auto now = std::chrono::steady_clock::now();
+	auto [it,inserted] = this->Categories.try_emplace(category);
+	auto& state = it->second;
+	if( inserted ){
+		state.WindowStart = now;
+	}else if( now - state.WindowStart >= this->Interval ){
+		this->EndWindow(category,state,now);
+	}
+
+	++state.Total;
+	if( state.AllowedInWindow < this->Burst ){
+		++state.AllowedInWindow;
+		return true;
+	}
+	++state.SuppressedInWindow;
+	++state.TotalSuppressed;
+	return false;
+}
+
+void LogRateLimiter::Tick(){
+	const auto now = std::chrono::steady_clock::now();
+	for( auto& [category,state] : this->Categories ){
+		// Only windows with suppressed messages have something to summarise, the others start anew on their next message
+		if( state.SuppressedInWindow > 0 and now - state.WindowStart >= this->Interval ){
+			this->EndWindow(category,state,now);
+		}
+	}
+}
+
+void LogRateLimiter::EndWindow(std::string_view category,CategoryState& state,std::chrono::steady_clock::time_point now){
+	if( state.SuppressedInWindow > 0 and this->console ){
+		this->console->info("[{}] {} messages suppressed in the last {} s ({} total)",category,state.SuppressedInWindow,
+		                    std::chrono::duration_cast<std::chrono::seconds>(now - state.WindowStart).count(),state.Total);
+	}
+	state.WindowStart = now;
+	state.AllowedInWindow = 0;
+	state.SuppressedInWindow = 0;
+}
+
+void LogRateLimiter::Report(){
+	if( not this->console ){
+		return;
+	}
+	for( const auto& [category,state] : this->Categories ){
+		this->console->info("[{}] {} messages, {} suppressed",category,state.Total,state.TotalSuppressed);
+	}
+}
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cmath>
+
+#include <fmt/format.h>
+
+#include <TDirectory.h>
+#include <TH1.h>
+
+#include "OnlineHistograms.h"
+#include "DDASRootEvent.h"
+#include "DDASRootHit.h"
+
+namespace{
+	// The raw energy is the lower 16 bits of header word 3
+	const uint64_t ENERGY_RANGE = 1 << 16;
+}
+
+OnlineHistograms::OnlineHistograms(const std::string& log,const ldf2root::CmdOptions& cmdopts){
+	this->LogName = log;
+	this->EnergyBins = cmdopts.histo_energy_bins;
+	// The bins are whole nanoseconds, a rate bin of zero would divide by zero
+	this->RateBinNs = std::max<uint64_t>(static_cast<uint64_t>(std::llround(cmdopts.histo_rate_bin*1.0e9)),1);
+	this->HaveStart = false;
+	this->StartTime = 0;
+	this->Hits = 0;
+	this->console = spdlog::get(this->LogName)->clone("OnlineHistograms");
+}
+
+void OnlineHistograms::Count(Counts& counts,int64_t bin,size_t maxbins){
+	++counts.Entries;
+	if( bin < 0 ){
+		++counts.Underflow;
+		return;
+	}
+	const size_t idx = static_cast<size_t>(bin);
+	if( idx >= maxbins ){
+		++counts.Overflow;
+		return;
+	}
+	if( idx >= counts.Bins.size() ){
+		counts.Bins.resize(idx + 1,0);
+	}
+	++counts.Bins[idx];
+}
+
+void OnlineHistograms::Fill(DDASRootEvent& event){
+	auto& data = event.GetData();
+	Count(this->Multiplicity,data.size(),MAX_MULTIPLICITY);
+	for( const auto* hit : data ){
+		const uint64_t time = hit->getCoarseTime();
+		if( not this->HaveStart ){
+			this->StartTime = time;
+			this->HaveStart = true;
+		}
+		const uint32_t crate = hit->getCrateID() & 0xF;
+		const uint32_t slot = hit->getSlotID() & 0xF;
+		const uint32_t chan = hit->getChannelID() & 0xF;
+
+		auto& energy = this->Energy[(crate << 8) | (slot << 4) | chan];
+		if( not energy ){
+			energy = std::make_unique<Counts>();
+			energy->Bins.resize(this->EnergyBins,0);
+		}
+		Count(*energy,(static_cast<uint64_t>(hit->getEnergy()) % ENERGY_RANGE)*this->EnergyBins/ENERGY_RANGE,this->EnergyBins);
+
+		// Hits that were built before the first one (beyond the reorder horizon) are underflow
+		const int64_t ratebin = time >= this->StartTime ? static_cast<int64_t>((time - this->StartTime)/this->RateBinNs) : -1;
+		Count(this->ModuleRate[(crate << 4) | slot],ratebin,MAX_RATE_BINS);
+		Count(this->TotalRate,ratebin,MAX_RATE_BINS);
+	}
+	this->Hits += data.size();
+}
+
+bool OnlineHistograms::WriteHistogram(TDirectory* dir,const Counts& counts,const std::string& name,const std::string& title,size_t nbins,double low,double high){
+	if( counts.Entries == 0 ){
+		return false;
+	}
+	TH1D hist(name.c_str(),title.c_str(),nbins,low,high);
+	hist.SetDirectory(nullptr);
+	for( size_t ii = 0; ii < counts.Bins.size() and ii < nbins; ++ii ){
+		if( counts.Bins[ii] > 0 ){
+			hist.SetBinContent(ii + 1,counts.Bins[ii]);
+		}
+	}
+	hist.SetBinContent(0,counts.Underflow);
+	hist.SetBinContent(nbins + 1,counts.Overflow);
+	hist.SetEntries(counts.Entries);
+	dir->WriteTObject(&hist);
+	return true;
+}
+
+void OnlineHistograms::Write(TDirectory* file){
+	TDirectory* top = file->mkdir("histos","Spectra filled during the conversion",true);
+	TDirectory* energydir = top->mkdir("energy","Raw energy per channel",true);
+	TDirectory* ratedir = top->mkdir("rate","Hits per second against the run time",true);
+
+	const double binseconds = this->RateBinNs*1.0e-9;
+	const std::string rateaxis = fmt::format(";time since the first hit [s];hits/s in {} s bins",binseconds);
+	size_t nhistos = 0;
+	for( size_t ii = 0; ii < MAX_CHANNELS; ++ii ){
+		if( not this->Energy[ii] ){
+			continue;
+		}
+		const size_t crate = ii >> 8;
+		const size_t slot = (ii >> 4) & 0xF;
+		const size_t chan = ii & 0xF;
+		nhistos += WriteHistogram(energydir,*this->Energy[ii],fmt::format("energy_c{}_s{}_ch{}",crate,slot,chan),
+			fmt::format("Crate {} slot {} channel {};energy [ADC];counts",crate,slot,chan),this->EnergyBins,0.0,ENERGY_RANGE);
+	}
+
+	// The rates are counted per bin, they are written in hits per second
+	const auto writeRate = [&](const Counts& counts,const std::string& name,const std::string& title){
+		if( counts.Entries == 0 ){
+			return false;
+		}
+		const size_t nbins = std::max<size_t>(counts.Bins.size(),1);
+		TH1D hist(name.c_str(),(title+rateaxis).c_str(),nbins,0.0,nbins*binseconds);
+		hist.SetDirectory(nullptr);
+		for( size_t ii = 0; ii < counts.Bins.size(); ++ii ){
+			if( counts.Bins[ii] > 0 ){
+				hist.SetBinContent(ii + 1,counts.Bins[ii]/binseconds);
+			}
+		}
+		hist.SetBinContent(0,counts.Underflow/binseconds);
+		hist.SetBinContent(nbins + 1,counts.Overflow/binseconds);
+		hist.SetEntries(counts.Entries);
+		ratedir->WriteTObject(&hist);
+		return true;
+	};
+	for( size_t ii = 0; ii < MAX_MODULES; ++ii ){
+		nhistos += writeRate(this->ModuleRate[ii],fmt::format("rate_c{}_s{}",ii >> 4,ii & 0xF),fmt::format("Crate {} slot {}",ii >> 4,ii & 0xF));
+	}
+	nhistos += writeRate(this->TotalRate,"rate_total","All modules");
+	if( this->TotalRate.Overflow > 0 ){
+		this->console->warn("The rate histograms end after {} s ({} bins), {} later hits are only in their overflow bin, a wider --histo-rate-bin covers them",
+			MAX_RATE_BINS*binseconds,MAX_RATE_BINS,this->TotalRate.Overflow);
+	}
+
+	// The overflow bin only means something when the axis goes up to the limit
+	const size_t maxmult = this->Multiplicity.Overflow > 0 ? MAX_MULTIPLICITY : std::max<size_t>(this->Multiplicity.Bins.size(),1);
+	nhistos += WriteHistogram(top,this->Multiplicity,"multiplicity","Hits per event;hits;events",maxmult,-0.5,maxmult - 0.5);
+
+	this->console->info("Wrote {} histograms of {} hits to histos/",nhistos,this->Hits);
+}
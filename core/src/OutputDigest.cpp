@@ -0,0 +1,170 @@
+#include <memory>
+#include <optional>
+#include <stdexcept>
+
+#include <TBranch.h>
+#include <TFile.h>
+#include <TTree.h>
+
+#include "OutputDigest.h"
+#include "DDASFlatEvent.h"
+#include "DDASRootEvent.h"
+#include "DDASRootHit.h"
+#include "EventDigest.h"
+
+#ifdef LDF2ROOT_HAS_RNTUPLE
+#include "RNTupleEventWriter.h"
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,32,0)
+#include <ROOT/RNTupleReader.hxx>
+#else
+#include <ROOT/RNTuple.hxx>
+#endif
+#endif
+
+OutputDigest::OutputDigest(const std::string& log,const ldf2root::CmdOptions& cmdopts){
+	this->LogName = log;
+	this->CmdOpts = cmdopts;
+	this->console = spdlog::get(this->LogName)->clone("OutputDigest");
+}
+
+std::string OutputDigest::GetTraceFileName() const{
+	if( not this->CmdOpts.split_traces or not this->CmdOpts.write_traces ){
+		return "";
+	}
+	return this->CmdOpts.trace_file.empty() ? this->CmdOpts.output_file : this->CmdOpts.trace_file;
+}
+
+uint64_t OutputDigest::Read(EventDigest& digest){
+	this->console->info("Reading {} back for the event digest",this->CmdOpts.output_file);
+	uint64_t events = 0;
+	switch(this->CmdOpts.output_format){
+		case ldf2root::OutputFormat::RNTUPLE:
+			events = this->ReadNTuple(digest);
+			break;
+		case ldf2root::OutputFormat::TTREE:
+		default:
+			events = this->ReadTree(digest);
+			break;
+	}
+	this->console->info("Added {} written events to the digest",events);
+	return events;
+}
+
+uint64_t OutputDigest::ReadTree(EventDigest& digest){
+	const std::string& filename = this->CmdOpts.output_file;
+	std::unique_ptr<TFile> file(TFile::Open(filename.c_str(),"READ"));
+	if( not file or file->IsZombie() ){
+		throw std::runtime_error("Unable to open "+filename+" for the event digest");
+	}
+	TTree* tree = file->Get<TTree>(this->CmdOpts.tree_name.c_str());
+	if( not tree ){
+		throw std::runtime_error("No tree "+this->CmdOpts.tree_name+" in "+filename);
+	}
+
+	// The split traces are read from their own tree, not through the friend of the main tree
+	std::unique_ptr<TFile> tracefile;
+	TTree* tracetree = nullptr;
+	std::vector<std::vector<uint16_t>>* traces = nullptr;
+	const std::string tracename = this->GetTraceFileName();
+	if( not tracename.empty() ){
+		const std::string treename = this->CmdOpts.tree_name+"_traces";
+		if( tracename == filename ){
+			tracetree = file->Get<TTree>(treename.c_str());
+		}else{
+			tracefile.reset(TFile::Open(tracename.c_str(),"READ"));
+			if( not tracefile or tracefile->IsZombie() ){
+				throw std::runtime_error("Unable to open "+tracename+" for the event digest");
+			}
+			tracetree = tracefile->Get<TTree>(treename.c_str());
+		}
+		if( not tracetree ){
+			throw std::runtime_error("No tree "+treename+" in "+tracename);
+		}
+		if( tracetree->GetEntries() != tree->GetEntries() ){
+			throw std::runtime_error("The trace tree "+treename+" has "+std::to_string(tracetree->GetEntries())+" entries, the events "+std::to_string(tree->GetEntries()));
+		}
+		tracetree->SetBranchAddress("traces",&traces);
+	}
+
+	const std::string branchname = this->CmdOpts.legacy and not this->CmdOpts.lean_hits ? "dchan" : "rawevents";
+	TBranch* branch = tree->GetBranch(branchname.c_str());
+	if( not branch ){
+		throw std::runtime_error("No branch "+branchname+" in "+this->CmdOpts.tree_name);
+	}
+	DDASFlatEvent* lean = nullptr;
+	DDASRootEvent* event = nullptr;
+	std::vector<DDASFlatHit> hits;
+	std::vector<std::vector<uint16_t>> hittraces;
+	const Long64_t nentries = tree->GetEntries();
+	if( this->CmdOpts.lean_hits ){
+		tree->SetBranchAddress(branchname.c_str(),&lean);
+	}else{
+		tree->SetBranchAddress(branchname.c_str(),&event);
+	}
+	for( Long64_t ii = 0; ii < nentries; ++ii ){
+		if( event ){
+			event->Reset();
+		}
+		// Only this branch is read, the friend holding the traces is not
+		if( branch->GetEntry(ii) <= 0 ){
+			throw std::runtime_error("Unable to read entry "+std::to_string(ii)+" of "+this->CmdOpts.tree_name);
+		}
+		if( tracetree and tracetree->GetEntry(ii) <= 0 ){
+			throw std::runtime_error("Unable to read entry "+std::to_string(ii)+" of the trace tree");
+		}
+		if( lean ){
+			digest.Add(lean->GetData(),traces ? *traces : lean->GetTraces());
+			continue;
+		}
+		// The traces are moved out of the hits, the event is reset before the next entry
+		const auto& data = event->GetData();
+		hits.resize(data.size());
+		hittraces.resize(traces ? 0 : data.size());
+		for( size_t jj = 0; jj < data.size(); ++jj ){
+			hits[jj].Set(*data[jj]);
+			if( not traces ){
+				hittraces[jj].clear();
+				hittraces[jj].swap(data[jj]->getTrace());
+			}
+		}
+		digest.Add(hits,traces ? *traces : hittraces);
+	}
+	tree->ResetBranchAddresses();
+	if( tracetree ){
+		tracetree->ResetBranchAddresses();
+	}
+	delete lean;
+	delete event;
+	delete traces;
+	return nentries;
+}
+
+uint64_t OutputDigest::ReadNTuple(EventDigest& digest){
+#ifdef LDF2ROOT_HAS_RNTUPLE
+	auto reader = RNTupleNS::RNTupleReader::Open(this->CmdOpts.tree_name,this->CmdOpts.output_file);
+	auto hits = reader->GetView<std::vector<DDASFlatHit>>("hits");
+
+	using TraceView = decltype(reader->GetView<std::vector<std::vector<uint16_t>>>("traces"));
+	std::unique_ptr<RNTupleNS::RNTupleReader> tracereader;
+	std::optional<TraceView> traces;
+	const std::string tracename = this->GetTraceFileName();
+	if( not tracename.empty() ){
+		tracereader = RNTupleNS::RNTupleReader::Open(this->CmdOpts.tree_name+"_traces",tracename);
+		if( tracereader->GetNEntries() != reader->GetNEntries() ){
+			throw std::runtime_error("The trace ntuple has "+std::to_string(tracereader->GetNEntries())+" entries, the events "+std::to_string(reader->GetNEntries()));
+		}
+		traces.emplace(tracereader->GetView<std::vector<std::vector<uint16_t>>>("traces"));
+	}else if( this->CmdOpts.write_traces ){
+		traces.emplace(reader->GetView<std::vector<std::vector<uint16_t>>>("traces"));
+	}
+
+	static const std::vector<std::vector<uint16_t>> notraces;
+	for( auto ii : reader->GetEntryRange() ){
+		digest.Add(hits(ii),traces ? (*traces)(ii) : notraces);
+	}
+	return reader->GetNEntries();
+#else
+	(void)digest;
+	throw std::runtime_error("ldf2root was built without RNTuple support, unable to read "+this->CmdOpts.output_file);
+#endif
+}
@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+
+#include <TFile.h>
+
+#include "Pipeline.h"
+#include "DataParser.h"
+#include "DataWriter.h"
+#include "DDASHitUnpacker.h"
+#include "EventBuilder.h"
+#include "EventDigest.h"
+#include "EventFilter.h"
+#include "ExternalSorter.h"
+#include "HitReorderBuffer.h"
+#include "OutputDigest.h"
+#include "OnlineHistograms.h"
+#include "PipelineMetrics.h"
+#include "TimeDifferences.h"
+#include "RunScanner.h"
+#include "TraceRecorder.h"
+
+std::chrono::duration<double> ldf2root::UnpackEvents(RawDataVector* rawData,UnpackedHitVector* unpackedData){
+	auto start_time = std::chrono::high_resolution_clock::now();
+	TraceSpan span("UnpackEvents","unpack");
+	ddasfmt::DDASHitUnpacker unpacker;
+
+	const size_t totalWords = rawData->size();
+	const uint32_t* dataPtr = rawData->data();
+
+	size_t processedWords = 0;
+	while( processedWords < totalWords ){
+		// The first word of every hit is its length in 16-bit words, including the two DDAS words
+		uint32_t eventLength = *dataPtr;
+		auto currentHit = std::make_unique<DDASRootHit>();
+		unpacker.unpack(dataPtr,dataPtr + eventLength,*currentHit);
+
+		unpackedData->push_back(std::move(currentHit));
+		dataPtr += eventLength/2;
+		processedWords += eventLength/2;
+	}
+	// Clear the raw data after unpacking
+	rawData->clear();
+	span.SetArg("hits",unpackedData->size());
+	return std::chrono::high_resolution_clock::now() - start_time;
+}
+
+std::chrono::duration<double> ldf2root::SortEvents(UnpackedHitVector* unpackedData){
+	auto start_time = std::chrono::high_resolution_clock::now();
+	TraceSpan span("SortEvents","sort");
+	span.SetArg("hits",unpackedData->size());
+	if( unpackedData->size() > 0 ){
+		// The hit times are assembled once instead of in every comparison. Ties go to the parse order,
+		// the same as the external sort.
+		struct SortKey{
+			DDASRootHit::FixedTime Time;
+			size_t Index;
+		};
+		std::vector<SortKey> keys;
+		keys.reserve(unpackedData->size());
+		for( size_t ii = 0; ii < unpackedData->size(); ++ii ){
+			keys.push_back({(*unpackedData)[ii]->getFixedTime(),ii});
+		}
+		std::sort(keys.begin(),keys.end(),
+			[](const SortKey& a,const SortKey& b){ return a.Time < b.Time or (a.Time == b.Time and a.Index < b.Index); }
+		);
+		UnpackedHitVector sorted;
+		sorted.reserve(unpackedData->size());
+		for( const auto& key : keys ){
+			sorted.push_back(std::move((*unpackedData)[key.Index]));
+		}
+		unpackedData->swap(sorted);
+	}
+	return std::chrono::high_resolution_clock::now() - start_time;
+}
+
+std::string ldf2root::EscapeJSON(const std::string& in){
+	std::string out;
+	out.reserve(in.size());
+	for( const char c : in ){
+		if( c == '"' or c == '\\' ){
+			out += '\\';
+			out += c;
+		}else if( static_cast<unsigned char>(c) < 0x20 ){
+			out += fmt::format("\\u{:04x}",static_cast<unsigned int>(c));
+		}else{
+			out += c;
+		}
+	}
+	return out;
+}
+
+int ldf2root::RunConversion(const CmdOptions& opts,const std::string& logname){
+	auto start_time = std::chrono::high_resolution_clock::now();
+	auto console = spdlog::get(logname);
+
+	// Create the parser and the output ROOT file with the tree/ntuple inside it
+	std::unique_ptr<DataParser> dataparser;
+	std::unique_ptr<DataWriter> datawriter;
+	std::unique_ptr<EventDigest> digest;
+	std::unique_ptr<OnlineHistograms> histos;
+	std::unique_ptr<TimeDifferences> differences;
+	std::unique_ptr<EventFilter> filter;
+	try{
+		dataparser.reset(new DataParser(DataParser::DataFileType::LDF_PIXIE,logname,opts));
+		dataparser->SetInputFiles(opts.input_files);
+		// A filter that does not compile stops the conversion before the output file is created
+		if( not opts.filters.empty() ){
+			filter.reset(new EventFilter(logname,opts));
+		}
+		datawriter.reset(new DataWriter(opts.output_format,logname,opts));
+		if( not opts.digest_file.empty() ){
+			digest.reset(new EventDigest(logname,opts));
+		}
+		if( opts.histos ){
+			histos.reset(new OnlineHistograms(logname,opts));
+		}
+		if( not opts.dt_references.empty() ){
+			differences.reset(new TimeDifferences(logname,opts));
+		}
+	}catch( std::runtime_error const& e ){
+		console->error(e.what());
+		return 1;
+	}
+	PipelineMetrics metrics(logname,opts);
+	datawriter->SetMetrics(&metrics);
+
+	auto rawData = std::make_unique<RawDataVector>();
+	auto unpackedData = std::make_unique<UnpackedHitVector>();
+	EventBuilder eventbuilder(logname,opts,[&](DDASRootEvent& evt){
+		// Rejected events are not written, nor are they in the digest or the histograms
+		if( filter and not filter->Accept(evt) ){
+			return;
+		}
+		// The writer may move the traces out of the event, take the digest first
+		if( digest and not opts.digest_output ){
+			digest->Add(evt);
+		}
+		if( histos ){
+			histos->Fill(evt);
+		}
+		datawriter->Fill(evt);
+	});
+	eventbuilder.SetMetrics(&metrics);
+	eventbuilder.SetTimeDifferences(differences.get());
+
+	// Write the products and close the output, also after an error so the events converted so far stay readable.
+	// Every part is released once written, a second call after a failure only finishes the rest.
+	bool outputDigested = false;
+	auto finishOutput = [&](bool complete){
+		if( histos ){
+			histos->Write(datawriter->GetFile());
+			histos.reset();
+		}
+		if( differences ){
+			differences->Write(datawriter->GetFile());
+			eventbuilder.SetTimeDifferences(nullptr);
+			differences.reset();
+		}
+		datawriter->Close();
+		if( digest and opts.digest_output and not outputDigested ){
+			outputDigested = true;
+			OutputDigest(logname,opts).Read(*digest);
+		}
+		if( digest ){
+			digest->Close(complete);
+		}
+	};
+
+	Translator::TRANSLATORSTATE CurrState = Translator::TRANSLATORSTATE::UNKNOWN;
+	metrics.Start();
+	// Parse the LDF files into raw hit words, in one call or in blocks for the external sort and the streaming time ordering
+	auto parseBlock = [&](){
+		metrics.StageStarted(PipelineMetrics::PARSE);
+		const auto parseStart = std::chrono::steady_clock::now();
+		const uint64_t bytesBefore = dataparser->GetBytesRead();
+		const size_t wordsBefore = rawData->size();
+		CurrState = dataparser->Parse(rawData.get());
+		datawriter->FillSpills(dataparser->TakeSpills());
+		metrics.AddBusyTime(PipelineMetrics::PARSE,std::chrono::steady_clock::now() - parseStart);
+		metrics.AddBytesIn(PipelineMetrics::PARSE,dataparser->GetBytesRead() - bytesBefore);
+		metrics.AddBytesOut(PipelineMetrics::PARSE,(rawData->size() - wordsBefore)*sizeof(uint32_t));
+		metrics.SetQueueDepth(PipelineMetrics::UNPACK,rawData->size());
+	};
+	try{
+		if( opts.sort_memory_mb > 0 ){
+			// External sort: every parsed block becomes a sorted run on scratch disk, the runs are merged into the event builder
+			ExternalSorter sorter(logname,opts);
+			// Reserved once, growing by doubling would take the buffer well past the memory limit
+			rawData->reserve(opts.parse_block_words + opts.parse_block_words/4);
+			do{
+				parseBlock();
+				metrics.StageStarted(PipelineMetrics::SORT);
+				metrics.AddBytesIn(PipelineMetrics::SORT,rawData->size()*sizeof(uint32_t));
+				const uint64_t hitsBefore = sorter.GetHits();
+				auto runTime = sorter.AddBlock(rawData.get());
+				metrics.AddBusyTime(PipelineMetrics::SORT,runTime);
+				metrics.AddHitsIn(PipelineMetrics::SORT,sorter.GetHits() - hitsBefore);
+				metrics.SetQueueDepth(PipelineMetrics::UNPACK,0);
+				metrics.SetQueueDepth(PipelineMetrics::SORT,sorter.GetNumRuns());
+			}while( CurrState == Translator::TRANSLATORSTATE::PARSING );
+			console->info("Finished parsing all input files, {} hits in {} sorted runs ({:.1f} MB spilled).",sorter.GetHits(),sorter.GetNumRuns(),sorter.GetBytesSpilled()/(1024.0*1024.0));
+
+			// The last block is spilled, its buffer is better spent on the merge
+			RawDataVector().swap(*rawData);
+			metrics.StageStarted(PipelineMetrics::BUILD);
+			auto mergeTime = sorter.Merge(eventbuilder);
+			metrics.AddHitsOut(PipelineMetrics::SORT,sorter.GetHits());
+			metrics.SetQueueDepth(PipelineMetrics::SORT,0);
+			// Unpacking the merged hits and handing the events to the writer are part of the merge time
+			metrics.AddBusyTime(PipelineMetrics::BUILD,mergeTime - datawriter->GetWriteTime());
+			console->info("Merge and event building complete, {} hits built into {} events in {} seconds.",eventbuilder.GetHitsBuilt(),eventbuilder.GetEventsBuilt(),mergeTime.count());
+		}else if( opts.stream_sort ){
+			// Streaming: every spill is unpacked into the reorder buffer, hits go to the event builder once they can not be overtaken
+			HitReorderBuffer reorder(logname,opts,[&](std::unique_ptr<DDASRootHit> hit){ eventbuilder.AddHit(std::move(hit)); });
+			std::chrono::duration<double> unpackTime(0),releaseTime(0);
+			const auto streamStart = std::chrono::high_resolution_clock::now();
+			auto lastSave = std::chrono::steady_clock::now();
+			do{
+				parseBlock();
+				metrics.StageStarted(PipelineMetrics::UNPACK);
+				metrics.AddBytesIn(PipelineMetrics::UNPACK,rawData->size()*sizeof(uint32_t));
+				auto blockUnpack = UnpackEvents(rawData.get(),unpackedData.get());
+				unpackTime += blockUnpack;
+				metrics.AddBusyTime(PipelineMetrics::UNPACK,blockUnpack);
+				metrics.AddHitsOut(PipelineMetrics::UNPACK,unpackedData->size());
+				metrics.SetQueueDepth(PipelineMetrics::UNPACK,0);
+
+				metrics.StageStarted(PipelineMetrics::SORT);
+				metrics.AddHitsIn(PipelineMetrics::SORT,unpackedData->size());
+				const uint64_t releasedBefore = reorder.GetHitsOut();
+				const auto writeBefore = datawriter->GetWriteTime();
+				reorder.Push(unpackedData.get());
+				auto blockRelease = reorder.Release();
+				releaseTime += blockRelease;
+				metrics.AddHitsOut(PipelineMetrics::SORT,reorder.GetHitsOut() - releasedBefore);
+				metrics.SetQueueDepth(PipelineMetrics::SORT,reorder.GetSize());
+				// Releasing hands the hits to the builder and the events to the writer, which are accounted to their own stages
+				metrics.StageStarted(PipelineMetrics::BUILD);
+				metrics.AddBusyTime(PipelineMetrics::BUILD,blockRelease - (datawriter->GetWriteTime() - writeBefore));
+				// Online monitoring reads the output while the run is still being converted
+				if( opts.follow and std::chrono::steady_clock::now() - lastSave >= std::chrono::seconds(opts.follow_save) ){
+					datawriter->Save();
+					lastSave = std::chrono::steady_clock::now();
+				}
+			}while( CurrState == Translator::TRANSLATORSTATE::PARSING );
+			const uint64_t releasedBefore = reorder.GetHitsOut();
+			const auto writeBefore = datawriter->GetWriteTime();
+			const auto flushStart = std::chrono::high_resolution_clock::now();
+			reorder.Flush();
+			eventbuilder.Flush();
+			const std::chrono::duration<double> flushTime = std::chrono::high_resolution_clock::now() - flushStart;
+			metrics.AddHitsOut(PipelineMetrics::SORT,reorder.GetHitsOut() - releasedBefore);
+			metrics.SetQueueDepth(PipelineMetrics::SORT,0);
+			metrics.AddBusyTime(PipelineMetrics::BUILD,flushTime - (datawriter->GetWriteTime() - writeBefore));
+			reorder.Report();
+			const std::chrono::duration<double> streamTime = std::chrono::high_resolution_clock::now() - streamStart;
+			console->info("Streaming time ordering and event building complete, {} hits built into {} events in {} seconds ({} s unpacking, {} s ordering and building).",eventbuilder.GetHitsBuilt(),eventbuilder.GetEventsBuilt(),streamTime.count(),unpackTime.count(),(releaseTime + flushTime).count());
+		}else{
+			do{
+				parseBlock();
+			}while( CurrState == Translator::TRANSLATORSTATE::PARSING );
+			console->info("Finished parsing all input files, now unpacking hits.");
+			metrics.StageStarted(PipelineMetrics::UNPACK);
+			metrics.AddBytesIn(PipelineMetrics::UNPACK,rawData->size()*sizeof(uint32_t));
+			auto unpackTime = UnpackEvents(rawData.get(),unpackedData.get());
+			metrics.AddBusyTime(PipelineMetrics::UNPACK,unpackTime);
+			metrics.AddHitsOut(PipelineMetrics::UNPACK,unpackedData->size());
+			metrics.SetQueueDepth(PipelineMetrics::UNPACK,rawData->size());
+			metrics.SetQueueDepth(PipelineMetrics::SORT,unpackedData->size());
+			console->info("Unpacking complete, {} hits unpacked in {} seconds.",unpackedData->size(),unpackTime.count());
+			console->info("Unpacked {} hits from {} input files.",unpackedData->size(),opts.input_files.size());
+
+			console->info("Sorting hits...");
+			metrics.StageStarted(PipelineMetrics::SORT);
+			auto sortTime = SortEvents(unpackedData.get());
+			metrics.AddBusyTime(PipelineMetrics::SORT,sortTime);
+			metrics.AddHitsIn(PipelineMetrics::SORT,unpackedData->size());
+			metrics.AddHitsOut(PipelineMetrics::SORT,unpackedData->size());
+			metrics.SetQueueDepth(PipelineMetrics::SORT,0);
+			console->info("Sorting complete, {} hits sorted in {} seconds.",unpackedData->size(),sortTime.count());
+			auto eventBuildTime = eventbuilder.Build(unpackedData.get());
+			// The build time includes handing the events to the writer, which is accounted to the write stage
+			metrics.AddBusyTime(PipelineMetrics::BUILD,eventBuildTime - datawriter->GetWriteTime());
+			console->info("Event building complete, {} hits built into {} events in {} seconds.",eventbuilder.GetHitsBuilt(),eventbuilder.GetEventsBuilt(),eventBuildTime.count());
+		}
+
+		if( filter ){
+			filter->Report();
+		}
+		console->info("Writing output to ROOT file: {}",opts.output_file);
+		finishOutput(true);
+		console->info("Write Complete!");
+	}catch( std::exception const& e ){
+		// Decoding errors of the input stream and failed allocations end up here as well
+		console->error(e.what());
+		try{
+			finishOutput(false);
+			console->warn("Closed {} with the events converted before the error",opts.output_file);
+		}catch( std::exception const& e2 ){
+			console->error("Unable to close the output after the error: {}",e2.what());
+		}
+		metrics.Stop();
+		return 1;
+	}
+	metrics.Stop();
+
+	auto run_time = std::chrono::high_resolution_clock::now() - start_time;
+	const auto hrs = std::chrono::duration_cast<std::chrono::hours>(run_time);
+	const auto mins = std::chrono::duration_cast<std::chrono::minutes>(run_time - hrs);
+	const auto secs = std::chrono::duration_cast<std::chrono::seconds>(run_time - hrs - mins);
+	const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(run_time - hrs - mins - secs);
+	console->info("Conversion complete in {} hours {} minutes {} seconds {} milliseconds",hrs.count(),mins.count(),secs.count(),ms.count());
+	return 0;
+}
+
+int ldf2root::RunScan(const CmdOptions& opts,const std::string& logname){
+	auto start_time = std::chrono::high_resolution_clock::now();
+	auto console = spdlog::get(logname);
+
+	std::unique_ptr<DataParser> dataparser;
+	try{
+		dataparser.reset(new DataParser(DataParser::DataFileType::LDF_PIXIE,logname,opts));
+		dataparser->SetInputFiles(opts.input_files);
+	}catch( std::runtime_error const& e ){
+		console->error(e.what());
+		return 1;
+	}
+
+	// The raw words are counted block by block, only a block is ever held in memory
+	RunScanner scanner(logname,opts);
+	auto rawData = std::make_unique<RawDataVector>();
+	Translator::TRANSLATORSTATE CurrState = Translator::TRANSLATORSTATE::UNKNOWN;
+	try{
+		do{
+			CurrState = dataparser->Parse(rawData.get());
+			scanner.AddBlock(rawData.get());
+		}while( CurrState == Translator::TRANSLATORSTATE::PARSING );
+		scanner.Finish(dataparser->GetParseStats(),dataparser->GetBytesRead());
+		scanner.Report();
+		if( not opts.scan_json.empty() ){
+			scanner.WriteJSON(opts.scan_json);
+			console->info("Scan summary written to {}",opts.scan_json);
+		}
+	}catch( std::exception const& e ){
+		console->error(e.what());
+		return 1;
+	}
+
+	auto run_time = std::chrono::high_resolution_clock::now() - start_time;
+	console->info("Scan complete in {:.3f} seconds",std::chrono::duration<double>(run_time).count());
+	return 0;
+}
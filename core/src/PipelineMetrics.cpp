@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include <sys/resource.h>
+
+#include "PipelineMetrics.h"
+#include "Pipeline.h"
+
+PipelineMetrics::PipelineMetrics(const std::string& log,const ldf2root::CmdOptions& cmdopts){
+	this->LogName = log;
+	this->JSONFile = cmdopts.metrics_file;
+	this->PromFile = cmdopts.metrics_prom_file;
+	this->OutputFile = cmdopts.output_file;
+	this->Interval = std::chrono::seconds(cmdopts.metrics_interval);
+	this->SharedProcess = cmdopts.jobs != 1;
+	this->StartTime = std::chrono::steady_clock::now();
+	this->Running = false;
+	this->console = spdlog::get(this->LogName)->clone("Metrics");
+}
+
+PipelineMetrics::~PipelineMetrics(){
+	if( this->WriterThread.joinable() ){
+		{
+			std::lock_guard<std::mutex> lock(this->WakeMutex);
+			this->Running = false;
+		}
+		this->Wake.notify_all();
+		this->WriterThread.join();
+	}
+}
+
+void PipelineMetrics::Start(){
+	this->StartTime = std::chrono::steady_clock::now();
+	this->Running = true;
+	if( this->Interval.count() > 0 and (not this->JSONFile.empty() or not this->PromFile.empty()) ){
+		this->WriterThread = std::thread(&PipelineMetrics::PeriodicWriter,this);
+	}
+}
+
+void PipelineMetrics::Stop(){
+	{
+		std::lock_guard<std::mutex> lock(this->WakeMutex);
+		this->Running = false;
+	}
+	this->Wake.notify_all();
+	if( this->WriterThread.joinable() ){
+		this->WriterThread.join();
+	}
+	this->Write(true);
+
+	const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->StartTime).count();
+	for( int ii = 0; ii < NUMSTAGES; ++ii ){
+		const auto& s = this->Stages[ii];
+		const double busy = s.BusyNs.load()*1.0e-9;
+		this->console->info("{:>6} : busy {:.3f} s, stall {:.3f} s, {} bytes in, {} bytes out, {} hits in, {} hits out, {} events out, peak queue depth {}",
+			StageName(static_cast<STAGE>(ii)),busy,s.StallNs.load()*1.0e-9,s.BytesIn.load(),s.BytesOut.load(),s.HitsIn.load(),s.HitsOut.load(),s.EventsOut.load(),s.QueueDepthPeak.load());
+	}
+	if( this->SharedProcess ){
+		this->console->info("wall time {:.3f} s",wall);
+	}else{
+		this->console->info("wall time {:.3f} s, peak RSS {} MB",wall,PeakRSS()/(1024*1024));
+	}
+}
+
+void PipelineMetrics::AddBusyTime(STAGE stage,std::chrono::duration<double> t){
+	this->Stages[stage].BusyNs.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t).count()),std::memory_order_relaxed);
+}
+
+void PipelineMetrics::AddStallTime(STAGE stage,std::chrono::duration<double> t){
+	this->Stages[stage].StallNs.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t).count()),std::memory_order_relaxed);
+}
+
+void PipelineMetrics::SetQueueDepth(STAGE stage,uint64_t depth){
+	auto& s = this->Stages[stage];
+	s.QueueDepth.store(depth,std::memory_order_relaxed);
+	uint64_t peak = s.QueueDepthPeak.load(std::memory_order_relaxed);
+	while( depth > peak and not s.QueueDepthPeak.compare_exchange_weak(peak,depth,std::memory_order_relaxed) ){
+	}
+}
+
+void PipelineMetrics::StageStarted(STAGE stage){
+	auto& started = this->Stages[stage].Started;
+	if( not started.load(std::memory_order_relaxed) and not started.exchange(true) ){
+		this->AddStallTime(stage,std::chrono::steady_clock::now() - this->StartTime);
+	}
+}
+
+void PipelineMetrics::Write(bool final){
+	std::lock_guard<std::mutex> lock(this->WriteMutex);
+	try{
+		if( not this->JSONFile.empty() ){
+			this->WriteJSON(this->JSONFile,final);
+		}
+		if( not this->PromFile.empty() ){
+			this->WritePrometheus(this->PromFile);
+		}
+	}catch(std::exception const& e){
+		this->console->error("Unable to write metrics : {}",e.what());
+	}
+}
+
+const char* PipelineMetrics::StageName(STAGE stage){
+	switch(stage){
+		case PARSE:
+			return "parse";
+		case UNPACK:
+			return "unpack";
+		case SORT:
+			return "sort";
+		case BUILD:
+			return "build";
+		case WRITE:
+			return "write";
+		default:
+			return "unknown";
+	}
+}
+
+uint64_t PipelineMetrics::PeakRSS(){
+	struct rusage usage;
+	if( getrusage(RUSAGE_SELF,&usage) != 0 ){
+		return 0;
+	}
+#ifdef __APPLE__
+	return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+	return static_cast<uint64_t>(usage.ru_maxrss)*1024;
+#endif
+}
+
+// Both files are written next to the target and renamed over it, so a reader (or the node exporter
+// textfile collector) never sees a half written file
+void PipelineMetrics::WriteJSON(const std::string& filename,bool final) const{
+	const std::string tmpname = filename+".tmp";
+	std::ofstream ofs(tmpname);
+	if( not ofs ){
+		throw std::runtime_error("unable to open "+tmpname);
+	}
+	const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->StartTime).count();
+	ofs << "{\n";
+	ofs << fmt::format("  \"output_file\": \"{}\",\n",ldf2root::EscapeJSON(this->OutputFile));
+	ofs << fmt::format("  \"timestamp\": {},\n",static_cast<int64_t>(std::time(nullptr)));
+	ofs << fmt::format("  \"final\": {},\n",final ? "true" : "false");
+	ofs << fmt::format("  \"wall_seconds\": {:.6f},\n",wall);
+	// With concurrent runs the process peak is shared by all of them, the batch reports it once
+	if( not this->SharedProcess ){
+		ofs << fmt::format("  \"peak_rss_bytes\": {},\n",PeakRSS());
+	}
+	ofs << "  \"stages\": {\n";
+	for( int ii = 0; ii < NUMSTAGES; ++ii ){
+		const auto& s = this->Stages[ii];
+		const double busy = s.BusyNs.load()*1.0e-9;
+		const auto rate = [busy](uint64_t n){ return busy > 0.0 ? n/busy : 0.0; };
+		ofs << fmt::format("    \"{}\": {{\n",StageName(static_cast<STAGE>(ii)));
+		ofs << fmt::format("      \"bytes_in\": {},\n",s.BytesIn.load());
+		ofs << fmt::format("      \"bytes_out\": {},\n",s.BytesOut.load());
+		ofs << fmt::format("      \"hits_in\": {},\n",s.HitsIn.load());
+		ofs << fmt::format("      \"hits_out\": {},\n",s.HitsOut.load());
+		ofs << fmt::format("      \"events_in\": {},\n",s.EventsIn.load());
+		ofs << fmt::format("      \"events_out\": {},\n",s.EventsOut.load());
+		ofs << fmt::format("      \"busy_seconds\": {:.6f},\n",busy);
+		ofs << fmt::format("      \"stall_seconds\": {:.6f},\n",s.StallNs.load()*1.0e-9);
+		ofs << fmt::format("      \"queue_depth\": {},\n",s.QueueDepth.load());
+		ofs << fmt::format("      \"queue_depth_peak\": {},\n",s.QueueDepthPeak.load());
+		ofs << fmt::format("      \"bytes_in_per_second\": {:.3f},\n",rate(s.BytesIn.load()));
+		ofs << fmt::format("      \"hits_per_second\": {:.3f},\n",rate(std::max(s.HitsIn.load(),s.HitsOut.load())));
+		ofs << fmt::format("      \"events_per_second\": {:.3f}\n",rate(std::max(s.EventsIn.load(),s.EventsOut.load())));
+		ofs << fmt::format("    }}{}\n",ii+1 < NUMSTAGES ? "," : "");
+	}
+	ofs << "  }\n";
+	ofs << "}\n";
+	ofs.close();
+	std::filesystem::rename(tmpname,filename);
+}
+
+void PipelineMetrics::WritePrometheus(const std::string& filename) const{
+	const std::string tmpname = filename+".tmp";
+	std::ofstream ofs(tmpname);
+	if( not ofs ){
+		throw std::runtime_error("unable to open "+tmpname);
+	}
+	struct PromCounter{
+		const char* name;
+		const char* type;
+		const char* help;
+		std::atomic<uint64_t> StageCounters::* member;
+		double scale;
+	};
+	static const PromCounter counters[] = {
+		{"ldf2root_stage_bytes_in_total","counter","Bytes consumed by the stage",&StageCounters::BytesIn,1.0},
+		{"ldf2root_stage_bytes_out_total","counter","Bytes produced by the stage",&StageCounters::BytesOut,1.0},
+		{"ldf2root_stage_hits_in_total","counter","Hits consumed by the stage",&StageCounters::HitsIn,1.0},
+		{"ldf2root_stage_hits_out_total","counter","Hits produced by the stage",&StageCounters::HitsOut,1.0},
+		{"ldf2root_stage_events_in_total","counter","Events consumed by the stage",&StageCounters::EventsIn,1.0},
+		{"ldf2root_stage_events_out_total","counter","Events produced by the stage",&StageCounters::EventsOut,1.0},
+		{"ldf2root_stage_busy_seconds_total","counter","Time the stage spent working",&StageCounters::BusyNs,1.0e-9},
+		{"ldf2root_stage_stall_seconds_total","counter","Time the stage spent waiting for input",&StageCounters::StallNs,1.0e-9},
+		{"ldf2root_stage_queue_depth","gauge","Items waiting in front of the stage",&StageCounters::QueueDepth,1.0},
+		{"ldf2root_stage_queue_depth_peak","gauge","Largest number of items waiting in front of the stage",&StageCounters::QueueDepthPeak,1.0}
+	};
+	for( const auto& c : counters ){
+		ofs << "# HELP " << c.name << " " << c.help << "\n";
+		ofs << "# TYPE " << c.name << " " << c.type << "\n";
+		for( int ii = 0; ii < NUMSTAGES; ++ii ){
+			const double value = (this->Stages[ii].*(c.member)).load()*c.scale;
+			ofs << fmt::format("{}{{stage=\"{}\"}} {}\n",c.name,StageName(static_cast<STAGE>(ii)),value);
+		}
+	}
+	if( not this->SharedProcess ){
+		ofs << "# HELP ldf2root_peak_rss_bytes Peak resident set size of the process\n";
+		ofs << "# TYPE ldf2root_peak_rss_bytes gauge\n";
+		ofs << "ldf2root_peak_rss_bytes " << PeakRSS() << "\n";
+	}
+	ofs << "# HELP ldf2root_wall_seconds Time since the start of the conversion\n";
+	ofs << "# TYPE ldf2root_wall_seconds gauge\n";
+	ofs << "ldf2root_wall_seconds " << std::chrono::duration<double>(std::chrono::steady_clock::now() - this->StartTime).count() << "\n";
+	ofs.close();
+	std::filesystem::rename(tmpname,filename);
+}
+
+void PipelineMetrics::PeriodicWriter(){
+	std::unique_lock<std::mutex> lock(this->WakeMutex);
+	while( this->Running ){
+		if( this->Wake.wait_for(lock,this->Interval,[this]{ return not this->Running; }) ){
+			break;
+		}
+		lock.unlock();
+		this->Write(false);
+		lock.lock();
+	}
+}
@@ -0,0 +1,98 @@
+#ifdef LDF2ROOT_HAS_RNTUPLE
+
+#include <stdexcept>
+
+#include <Compression.h>
+#include <TFile.h>
+#include <ROOT/RNTupleWriteOptions.hxx>
+
+#include "RNTupleEventWriter.h"
+
+#include "DDASRootEvent.h"
+#include "DDASRootHit.h"
+
+RNTupleEventWriter::RNTupleEventWriter(const std::string& log,const std::string& writername,const ldf2root::CmdOptions& cmdopts) : EventWriter(log,writername,cmdopts){
+	this->Writer = nullptr;
+	this->Hits = nullptr;
+	this->Traces = nullptr;
+	this->TraceWriter = nullptr;
+	this->TraceEventID = nullptr;
+}
+
+RNTupleEventWriter::~RNTupleEventWriter() = default;
+
+bool RNTupleEventWriter::Initialize(TFile* outfile,TFile* tracefile){
+	if( not EventWriter::Initialize(outfile,tracefile) ){
+		return false;
+	}
+	// Match the compression used for the TTree output so the two formats can be compared directly
+	RNTupleNS::RNTupleWriteOptions writeopts;
+	writeopts.SetCompression(ROOT::RCompressionSetting::EDefaults::kUseAnalysis);
+
+	auto model = RNTupleNS::RNTupleModel::Create();
+	this->Hits = model->MakeField<std::vector<DDASFlatHit>>("hits");
+	if( this->TraceFile ){
+		auto tracemodel = RNTupleNS::RNTupleModel::Create();
+		this->TraceEventID = tracemodel->MakeField<uint64_t>("event");
+		this->Traces = tracemodel->MakeField<std::vector<std::vector<uint16_t>>>("traces");
+		this->TraceWriter = RNTupleNS::RNTupleWriter::Append(std::move(tracemodel),this->GetTraceTreeName(),*(this->TraceFile),writeopts);
+		if( not this->TraceWriter ){
+			this->console->error("Unable to create RNTuple {}",this->GetTraceTreeName());
+			return false;
+		}
+		this->console->info("Created trace RNTuple {}",this->GetTraceTreeName());
+	}else if( this->CmdOpts.write_traces ){
+		this->Traces = model->MakeField<std::vector<std::vector<uint16_t>>>("traces");
+	}
+
+	this->Writer = RNTupleNS::RNTupleWriter::Append(std::move(model),this->CmdOpts.tree_name,*(this->OutputFile),writeopts);
+	if( not this->Writer ){
+		this->console->error("Unable to create RNTuple {}",this->CmdOpts.tree_name);
+		return false;
+	}
+	this->console->info("Created RNTuple {}",this->CmdOpts.tree_name);
+	if( this->CmdOpts.follow ){
+		this->console->warn("An RNTuple can only be read once its footer is written, the output is readable when following ends");
+	}
+	return true;
+}
+
+void RNTupleEventWriter::Fill(DDASRootEvent& event){
+	const auto& data = event.GetData();
+	// resize() keeps the capacity of the vectors (and of their members) between entries
+	this->Hits->resize(data.size());
+	for( size_t ii = 0; ii < data.size(); ++ii ){
+		(*this->Hits)[ii].Set(*data[ii]);
+	}
+	if( this->Traces ){
+		this->Traces->resize(data.size());
+		for( size_t ii = 0; ii < data.size(); ++ii ){
+			const auto& trace = data[ii]->getTrace();
+			(*this->Traces)[ii].assign(trace.begin(),trace.end());
+		}
+	}
+	if( this->TraceWriter ){
+		*(this->TraceEventID) = this->EventsWritten;
+		this->TraceWriter->Fill();
+	}
+	this->Writer->Fill();
+	++(this->EventsWritten);
+	this->HitsWritten += data.size();
+}
+
+void RNTupleEventWriter::Save(){
+	// The clusters reach the file, readers still need the footer written by Finalize()
+	this->Writer->CommitCluster();
+	if( this->TraceWriter ){
+		this->TraceWriter->CommitCluster();
+	}
+}
+
+void RNTupleEventWriter::Finalize(){
+	// Destroying the writer commits the last cluster and the RNTuple footer to the file
+	this->Writer.reset();
+	this->TraceWriter.reset();
+	EventWriter::Finalize();
+}
+
+#endif
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include "DDASBitMasks.h"
+#include "DDASHitUnpacker.h"
+#include "RunScanner.h"
+
+namespace{
+	// The coarse time conversion of the unpacker, without unpacking the whole hit
+	class CoarseTimeUnpacker : public ddasfmt::DDASHitUnpacker{
+		public:
+			using ddasfmt::DDASHitUnpacker::computeCoarseTime;
+	};
+
+	// Words of a raw hit: length in 16-bit words, module info, then the four Pixie header words
+	const size_t RAW_HEADER_WORDS = 2 + ddasfmt::SIZE_OF_RAW_EVENT;
+}
+
+RunScanner::RunScanner(const std::string& log,const ldf2root::CmdOptions& cmdopts){
+	this->LogName = log;
+	this->CmdOpts = cmdopts;
+	this->StartTime = std::chrono::steady_clock::now();
+	this->WallSeconds = 0.0;
+	this->TotalHits = 0;
+	this->CorruptWords = 0;
+	this->FirstTime = std::numeric_limits<uint64_t>::max();
+	this->LastTime = 0;
+	this->BytesRead = 0;
+	this->console = spdlog::get(this->LogName)->clone("RunScanner");
+}
+
+void RunScanner::AddBlock(RawDataVector* rawData){
+	CoarseTimeUnpacker unpacker;
+	const uint32_t* data = rawData->data();
+	const size_t totalWords = rawData->size();
+	size_t pos = 0;
+	while( pos < totalWords ){
+		const uint32_t* hit = data + pos;
+		const size_t hitWords = hit[0]/2;
+		if( hitWords < RAW_HEADER_WORDS or pos + hitWords > totalWords ){
+			// The translator only hands over complete hits, anything else ends the block
+			this->CorruptWords += totalWords - pos;
+			break;
+		}
+		const uint32_t modinfo = hit[1];
+		const uint32_t word0 = hit[2];
+		const uint32_t word2 = hit[4];
+		const uint32_t word3 = hit[5];
+
+		const uint32_t chan = word0 & ddasfmt::CHANNEL_ID_MASK;
+		const uint32_t slot = (word0 & ddasfmt::SLOT_ID_MASK) >> ddasfmt::SLOT_ID_SHIFT;
+		const uint32_t crate = (word0 & ddasfmt::CRATE_ID_MASK) >> ddasfmt::CRATE_ID_SHIFT;
+		const uint32_t msps = modinfo & ddasfmt::LOWER_16_BIT_MASK;
+		const uint64_t time = unpacker.computeCoarseTime(msps,hit[3],word2 & ddasfmt::LOWER_16_BIT_MASK);
+		const uint32_t tracelength = (word3 & ddasfmt::BIT_30_TO_16_MASK) >> 16;
+
+		auto& mod = this->Modules[(crate << 4) | slot];
+		if( mod.Hits == 0 ){
+			mod.FirstTime = time;
+			mod.LastTime = time;
+			mod.MSPS = msps;
+		}else if( time < mod.PrevTime ){
+			++mod.Backwards;
+		}
+		++mod.Hits;
+		++mod.ChannelHits[chan];
+		mod.PileUps += (word0 & ddasfmt::FINISH_CODE_MASK) >> ddasfmt::FINISH_CODE_SHIFT;
+		mod.OutOfRange += word3 >> ddasfmt::OUT_OF_RANGE_SHIFT;
+		if( tracelength > 0 ){
+			++mod.TraceHits;
+			mod.TraceSamples += tracelength;
+		}
+		// Out of order hits must not shrink the span the rate is computed over
+		mod.PrevTime = time;
+		mod.FirstTime = std::min(mod.FirstTime,time);
+		mod.LastTime = std::max(mod.LastTime,time);
+
+		this->FirstTime = std::min(this->FirstTime,time);
+		this->LastTime = std::max(this->LastTime,time);
+		++this->TotalHits;
+		pos += hitWords;
+	}
+	rawData->clear();
+}
+
+void RunScanner::Finish(const Translator::ParseStats& stats,uint64_t bytesread){
+	this->Stats = stats;
+	this->BytesRead = bytesread;
+	this->WallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->StartTime).count();
+}
+
+double RunScanner::TimeSpan() const{
+	return this->TotalHits > 0 ? (this->LastTime - this->FirstTime)*1.0e-9 : 0.0;
+}
+
+void RunScanner::Report() const{
+	this->console->info("Run {} \"{}\" {}",this->Stats.RunNumber,this->Stats.RunTitle,this->Stats.RunDate);
+	this->console->info("{} spills, {} good chunks, {} missing chunks, {:.1f} MB read",this->Stats.Spills,this->Stats.GoodChunks,this->Stats.MissingChunks,this->BytesRead/(1024.0*1024.0));
+	const double span = this->TimeSpan();
+	this->console->info("{} hits over {:.3f} s of run time ({:.1f} hits/s)",this->TotalHits,span,span > 0.0 ? this->TotalHits/span : 0.0);
+	if( this->CorruptWords > 0 ){
+		this->console->warn("{} raw words skipped after hits with an impossible length",this->CorruptWords);
+	}
+	for( size_t ii = 0; ii < MAX_MODULES; ++ii ){
+		const auto& mod = this->Modules[ii];
+		if( mod.Hits == 0 ){
+			continue;
+		}
+		const double modspan = (mod.LastTime - mod.FirstTime)*1.0e-9;
+		this->console->info("crate {:>2} slot {:>2} ({} MSPS) : {} hits ({:.1f}/s), {} pile ups, {} out of range, {} with traces, {} out of order",
+			ii >> 4,ii & 0xF,mod.MSPS,mod.Hits,modspan > 0.0 ? mod.Hits/modspan : 0.0,mod.PileUps,mod.OutOfRange,mod.TraceHits,mod.Backwards);
+		std::string chans;
+		for( size_t cc = 0; cc < mod.ChannelHits.size(); ++cc ){
+			if( mod.ChannelHits[cc] > 0 ){
+				chans += fmt::format(" {}:{}",cc,mod.ChannelHits[cc]);
+			}
+		}
+		this->console->info("    channel hits{}",chans);
+	}
+	this->console->info("Scanned in {:.3f} s ({:.1f} MB/s)",this->WallSeconds,this->WallSeconds > 0.0 ? this->BytesRead/(1024.0*1024.0)/this->WallSeconds : 0.0);
+}
+
+// Written next to the target and renamed over it, like the pipeline metrics
+void RunScanner::WriteJSON(const std::string& filename) const{
+	const std::string tmpname = filename+".tmp";
+	std::ofstream ofs(tmpname);
+	if( not ofs ){
+		throw std::runtime_error("unable to open "+tmpname);
+	}
+	const double span = this->TimeSpan();
+	std::string inputs;
+	for( size_t ii = 0; ii < this->CmdOpts.input_files.size(); ++ii ){
+		inputs += fmt::format("{}\"{}\"",ii > 0 ? ", " : "",ldf2root::EscapeJSON(this->CmdOpts.input_files[ii]));
+	}
+	ofs << "{\n";
+	ofs << fmt::format("  \"input_files\": [{}],\n",inputs);
+	ofs << fmt::format("  \"timestamp\": {},\n",static_cast<int64_t>(std::time(nullptr)));
+	ofs << fmt::format("  \"run_number\": {},\n",this->Stats.RunNumber);
+	ofs << fmt::format("  \"run_title\": \"{}\",\n",ldf2root::EscapeJSON(this->Stats.RunTitle));
+	ofs << fmt::format("  \"run_date\": \"{}\",\n",ldf2root::EscapeJSON(this->Stats.RunDate));
+	ofs << fmt::format("  \"bytes_read\": {},\n",this->BytesRead);
+	ofs << fmt::format("  \"spills\": {},\n",this->Stats.Spills);
+	ofs << fmt::format("  \"good_chunks\": {},\n",this->Stats.GoodChunks);
+	ofs << fmt::format("  \"missing_chunks\": {},\n",this->Stats.MissingChunks);
+	ofs << fmt::format("  \"corrupt_words\": {},\n",this->CorruptWords);
+	ofs << fmt::format("  \"hits\": {},\n",this->TotalHits);
+	ofs << fmt::format("  \"first_time_ns\": {},\n",this->TotalHits > 0 ? this->FirstTime : 0);
+	ofs << fmt::format("  \"last_time_ns\": {},\n",this->LastTime);
+	ofs << fmt::format("  \"run_seconds\": {:.9f},\n",span);
+	ofs << fmt::format("  \"hits_per_second\": {:.3f},\n",span > 0.0 ? this->TotalHits/span : 0.0);
+	ofs << fmt::format("  \"wall_seconds\": {:.6f},\n",this->WallSeconds);
+	ofs << "  \"modules\": [";
+	bool first = true;
+	for( size_t ii = 0; ii < MAX_MODULES; ++ii ){
+		const auto& mod = this->Modules[ii];
+		if( mod.Hits == 0 ){
+			continue;
+		}
+		std::string chans;
+		for( size_t cc = 0; cc < mod.ChannelHits.size(); ++cc ){
+			chans += fmt::format("{}{}",cc > 0 ? ", " : "",mod.ChannelHits[cc]);
+		}
+		const double modspan = (mod.LastTime - mod.FirstTime)*1.0e-9;
+		ofs << (first ? "\n" : ",\n");
+		ofs << "    {\n";
+		ofs << fmt::format("      \"crate\": {},\n",ii >> 4);
+		ofs << fmt::format("      \"slot\": {},\n",ii & 0xF);
+		ofs << fmt::format("      \"msps\": {},\n",mod.MSPS);
+		ofs << fmt::format("      \"hits\": {},\n",mod.Hits);
+		ofs << fmt::format("      \"hits_per_second\": {:.3f},\n",modspan > 0.0 ? mod.Hits/modspan : 0.0);
+		ofs << fmt::format("      \"pileups\": {},\n",mod.PileUps);
+		ofs << fmt::format("      \"out_of_range\": {},\n",mod.OutOfRange);
+		ofs << fmt::format("      \"trace_hits\": {},\n",mod.TraceHits);
+		ofs << fmt::format("      \"trace_samples\": {},\n",mod.TraceSamples);
+		ofs << fmt::format("      \"out_of_order\": {},\n",mod.Backwards);
+		ofs << fmt::format("      \"first_time_ns\": {},\n",mod.FirstTime);
+		ofs << fmt::format("      \"last_time_ns\": {},\n",mod.LastTime);
+		ofs << fmt::format("      \"channel_hits\": [{}]\n",chans);
+		ofs << "    }";
+		first = false;
+	}
+	ofs << (first ? "]\n" : "\n  ]\n");
+	ofs << "}\n";
+	ofs.close();
+	std::filesystem::rename(tmpname,filename);
+}
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "RunWatcher.h"
+#include "TraceRecorder.h"
+
+std::atomic<bool> RunWatcher::StopRequested{false};
+
+namespace{
+	// Layout of the end of an LDF file, see LDFPixieTranslator
+	const uint32_t ENDFILE = 541478725;
+	const uint64_t FILE_BUFFER_BYTES = 8194*sizeof(uint32_t);
+
+	// The stop flag is checked at least this often while waiting for the next scan
+	const std::chrono::milliseconds STOP_CHECK(500);
+}
+
+RunWatcher::RunWatcher(const std::string& log,const ldf2root::CmdOptions& cmdopts,ConvertFunction convert){
+	this->LogName = log;
+	this->CmdOpts = cmdopts;
+	this->Convert = std::move(convert);
+	this->WatchDir = this->CmdOpts.watch_dir;
+	this->StateFile = this->CmdOpts.state_file;
+	this->Interval = std::chrono::seconds(std::max(1u,this->CmdOpts.watch_interval));
+	this->NumWorkers = std::max(1u,this->CmdOpts.jobs);
+	this->MaxQueue = 2*this->NumWorkers;
+	this->Backlog = 0;
+	this->Stopping = false;
+	this->Converted = 0;
+	this->Failed = 0;
+	this->Busy = 0;
+	this->InotifyFD = -1;
+	this->WatchFD = -1;
+	this->console = spdlog::get(this->LogName)->clone("RunWatcher");
+
+	if( not std::filesystem::is_directory(this->WatchDir) ){
+		throw std::runtime_error("Watch directory "+this->WatchDir.string()+" does not exist");
+	}
+	this->LoadState();
+	this->State.open(this->StateFile,std::ios::app);
+	if( not this->State.is_open() ){
+		throw std::runtime_error("Unable to open the state file "+this->StateFile.string());
+	}
+#ifdef __linux__
+	this->InotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if( this->InotifyFD >= 0 ){
+		this->WatchFD = inotify_add_watch(this->InotifyFD,this->WatchDir.c_str(),IN_CLOSE_WRITE | IN_MOVED_TO);
+	}
+	if( this->WatchFD < 0 ){
+		this->console->warn("Unable to watch {} with inotify, only files ending with a double EOF buffer are detected",this->WatchDir.string());
+	}
+#else
+	this->console->info("Only files ending with a double EOF buffer are detected on this platform");
+#endif
+}
+
+RunWatcher::~RunWatcher(){
+#ifdef __linux__
+	if( this->InotifyFD >= 0 ){
+		close(this->InotifyFD);
+	}
+#endif
+}
+
+bool RunWatcher::HasEndOfRun(const std::filesystem::path& file){
+	std::error_code ec;
+	const uintmax_t size = std::filesystem::file_size(file,ec);
+	if( ec or size < 2*FILE_BUFFER_BYTES or size%FILE_BUFFER_BYTES != 0 ){
+		return false;
+	}
+	std::ifstream input(file,std::ios::binary);
+	for( uint64_t ii = 1; ii <= 2; ++ii ){
+		uint32_t bufftype = 0;
+		input.seekg(size - ii*FILE_BUFFER_BYTES);
+		if( not input.read(reinterpret_cast<char*>(&bufftype),sizeof(uint32_t)) or bufftype != ENDFILE ){
+			return false;
+		}
+	}
+	return true;
+}
+
+void RunWatcher::LoadState(){
+	std::ifstream input(this->StateFile);
+	if( not input.is_open() ){
+		this->console->info("Starting a new state file {}",this->StateFile.string());
+		std::ofstream header(this->StateFile);
+		header << "# ldf2root watch state v1, one START and one DONE line per converted file\n";
+		return;
+	}
+	std::set<std::string> started;
+	std::string line;
+	while( std::getline(input,line) ){
+		std::istringstream iss(line);
+		std::string tag,path;
+		long long when = 0;
+		iss >> tag >> when;
+		if( tag == "START" ){
+			std::getline(iss >> std::ws,path);
+			started.insert(path);
+			this->Known.insert(path);
+		}else if( tag == "DONE" ){
+			int status = 0;
+			double seconds = 0.0;
+			iss >> status >> seconds;
+			std::getline(iss >> std::ws,path);
+			started.erase(path);
+			this->Known.insert(path);
+		}
+	}
+	for( const auto& path : started ){
+		this->console->warn("The conversion of {} was interrupted, it is not converted again (remove it from {} to retry)",path,this->StateFile.string());
+	}
+	this->console->info("Loaded {} files from the state file {}",this->Known.size(),this->StateFile.string());
+}
+
+void RunWatcher::AppendState(const std::string& line){
+	std::lock_guard<std::mutex> lock(this->StateMutex);
+	this->State << line << '\n';
+	this->State.flush();
+	if( this->State.fail() ){
+		// The next line is tried again, the disk may have room by then
+		this->State.clear();
+		throw std::runtime_error("Failed writing the state file "+this->StateFile.string());
+	}
+}
+
+void RunWatcher::WaitForEvents(){
+	const auto deadline = std::chrono::steady_clock::now() + this->Interval;
+	while( not StopRequested.load(std::memory_order_relaxed) and std::chrono::steady_clock::now() < deadline ){
+#ifdef __linux__
+		if( this->WatchFD >= 0 ){
+			pollfd pfd = {this->InotifyFD,POLLIN,0};
+			if( poll(&pfd,1,static_cast<int>(STOP_CHECK.count())) <= 0 ){
+				continue;
+			}
+			// Note the files that were closed or moved in, the scan decides if they are finished
+			alignas(inotify_event) char events[4096];
+			ssize_t len;
+			bool closed = false;
+			while( (len = read(this->InotifyFD,events,sizeof(events))) > 0 ){
+				for( char* ptr = events; ptr < events + len; ){
+					const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+					if( event->len > 0 ){
+						const std::filesystem::path file = this->WatchDir/event->name;
+						if( file.extension() == ".ldf" ){
+							std::error_code ec;
+							auto& pending = this->Pending[file.string()];
+							pending.Size = std::filesystem::file_size(file,ec);
+							pending.Closed = not ec;
+							closed = true;
+						}
+					}
+					ptr += sizeof(inotify_event) + event->len;
+				}
+			}
+			if( closed ){
+				return;
+			}
+			continue;
+		}
+#endif
+		std::this_thread::sleep_for(STOP_CHECK);
+	}
+}
+
+void RunWatcher::Scan(){
+	TraceSpan span("Scan","watch");
+	std::vector<std::string> finished;
+	std::error_code ec;
+	for( const auto& entry : std::filesystem::directory_iterator(this->WatchDir,ec) ){
+		if( not entry.is_regular_file() or entry.path().extension() != ".ldf" ){
+			continue;
+		}
+		const std::string path = entry.path().string();
+		if( this->Known.count(path) ){
+			continue;
+		}
+		std::error_code sizeec;
+		const uintmax_t size = std::filesystem::file_size(entry.path(),sizeec);
+		auto& pending = this->Pending[path];
+		if( sizeec or size != pending.Size ){
+			// Still growing, a close before this size does not count
+			pending.Closed = false;
+			pending.Size = size;
+		}
+		if( HasEndOfRun(entry.path()) or (pending.Closed and size > 0) ){
+			finished.push_back(path);
+		}
+	}
+	if( ec ){
+		this->console->error("Unable to scan {} : {}",this->WatchDir.string(),ec.message());
+		return;
+	}
+	// Runs are named in order, convert them in order
+	std::sort(finished.begin(),finished.end());
+
+	size_t deferred = 0;
+	{
+		std::lock_guard<std::mutex> lock(this->QueueMutex);
+		for( const auto& path : finished ){
+			if( this->Queue.size() >= this->MaxQueue ){
+				++deferred;
+				continue;
+			}
+			this->console->info("Queued finished run {}",path);
+			this->Queue.push_back(path);
+			this->Known.insert(path);
+			this->Pending.erase(path);
+		}
+		const size_t backlog = this->Queue.size() + deferred;
+		if( backlog != this->Backlog ){
+			if( backlog > this->NumWorkers and backlog > this->Backlog ){
+				this->console->warn("Backlog of {} finished runs with {} of {} workers busy, the conversion falls behind the data taking",backlog,this->Busy.load(),this->NumWorkers);
+			}else{
+				this->console->info("Backlog of {} finished runs",backlog);
+			}
+			this->Backlog = backlog;
+		}
+	}
+	this->QueueCV.notify_all();
+}
+
+void RunWatcher::Worker(unsigned int id){
+	if( TraceRecorder::Instance().IsEnabled() ){
+		TraceRecorder::Instance().SetThreadName("worker "+std::to_string(id));
+	}
+	while( true ){
+		std::string path;
+		{
+			std::unique_lock<std::mutex> lock(this->QueueMutex);
+			this->QueueCV.wait(lock,[this](){ return this->Stopping or not this->Queue.empty(); });
+			if( this->Stopping ){
+				// Queued runs are not in the state file yet, they are picked up after a restart
+				return;
+			}
+			path = this->Queue.front();
+			this->Queue.pop_front();
+		}
+		++this->Busy;
+		// Recorded before the conversion starts, a crash during it never leads to a second conversion.
+		// A state file that can not be written only costs the bookkeeping, the watcher keeps running.
+		try{
+			this->AppendState("START "+std::to_string(std::time(nullptr))+" "+path);
+		}catch( std::exception const& e ){
+			this->console->error("{}, converting {} without its START record",e.what(),path);
+		}
+		const auto start = std::chrono::steady_clock::now();
+		int status = 1;
+		try{
+			status = this->Convert(path);
+		}catch( std::exception const& e ){
+			this->console->error("Conversion of {} failed: {}",path,e.what());
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		try{
+			this->AppendState("DONE "+std::to_string(std::time(nullptr))+" "+std::to_string(status)+" "+std::to_string(seconds)+" "+path);
+		}catch( std::exception const& e ){
+			this->console->error("{}, the result of {} is not recorded",e.what(),path);
+		}
+		--this->Busy;
+		if( status == 0 ){
+			++this->Converted;
+			this->console->info("Converted {} in {:.1f} s",path,seconds);
+		}else{
+			++this->Failed;
+			this->console->error("Conversion of {} failed after {:.1f} s",path,seconds);
+		}
+	}
+}
+
+int RunWatcher::Run(){
+	this->console->info("Watching {} for finished runs with {} workers, scanning every {} s",this->WatchDir.string(),this->NumWorkers,this->Interval.count());
+	std::vector<std::thread> workers;
+	for( unsigned int id = 0; id < this->NumWorkers; ++id ){
+		workers.emplace_back(&RunWatcher::Worker,this,id);
+	}
+	while( not StopRequested.load(std::memory_order_relaxed) ){
+		this->Scan();
+		this->WaitForEvents();
+	}
+	this->console->info("Stopping, waiting for {} running conversions",this->Busy.load());
+	{
+		std::lock_guard<std::mutex> lock(this->QueueMutex);
+		this->Stopping = true;
+	}
+	this->QueueCV.notify_all();
+	for( auto& worker : workers ){
+		worker.join();
+	}
+	this->console->info("Watcher stopped, {} runs converted, {} failed",this->Converted.load(),this->Failed.load());
+	return this->Failed == 0 ? 0 : 1;
+}
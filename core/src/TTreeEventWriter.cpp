@@ -0,0 +1,111 @@
+#include <stdexcept>
+
+#include <TFile.h>
+#include <TTree.h>
+
+#include "TTreeEventWriter.h"
+
+#include "DDASRootEvent.h"
+#include "DDASRootHit.h"
+
+TTreeEventWriter::TTreeEventWriter(const std::string& log,const std::string& writername,const ldf2root::CmdOptions& cmdopts) : EventWriter(log,writername,cmdopts){
+	this->OutputTree = nullptr;
+	this->CurrEvent = nullptr;
+	this->TraceTree = nullptr;
+	this->TraceEventID = 0;
+}
+
+TTreeEventWriter::~TTreeEventWriter() = default;
+
+bool TTreeEventWriter::Initialize(TFile* outfile,TFile* tracefile){
+	if( not EventWriter::Initialize(outfile,tracefile) ){
+		return false;
+	}
+	this->OutputFile->cd();
+	// The tree is owned by the output file, it is deleted when the file is closed
+	this->OutputTree = new TTree(this->CmdOpts.tree_name.c_str(), "DDAS Unpacked Data");
+	if (this->CmdOpts.lean_hits) {
+		// Lean format: TTree name "ddas" with a fully split DDASFlatEvent branch "rawevents"
+		this->OutputTree->Branch("rawevents", &(this->LeanEvent), 32000, 99);
+	} else if (this->CmdOpts.legacy) {
+		// Legacy format: TTree name "dchan" with a branch "dchan"
+		this->OutputTree->Branch("dchan", &(this->CurrEvent));
+	} else {
+		// Modern format: TTree name "ddas" with a branch "rawevents"
+		this->OutputTree->Branch("rawevents", &(this->CurrEvent));
+	}
+	this->console->info("Created TTree {}",this->CmdOpts.tree_name);
+
+	if( this->TraceFile ){
+		this->TraceFile->cd();
+		this->TraceTree = new TTree(this->GetTraceTreeName().c_str(), "DDAS Traces");
+		this->TraceTree->Branch("event", &(this->TraceEventID));
+		this->TraceTree->Branch("traces", &(this->TraceBuffer));
+		this->console->info("Created trace TTree {}",this->GetTraceTreeName());
+		this->OutputFile->cd();
+	}
+	return true;
+}
+
+void TTreeEventWriter::Fill(DDASRootEvent& event){
+	auto& data = event.GetData();
+	if( this->TraceTree ){
+		// Move the traces out of the hits, the event is reset after it is written so nothing is lost
+		this->TraceBuffer.resize(data.size());
+		for( size_t ii = 0; ii < data.size(); ++ii ){
+			this->TraceBuffer[ii].clear();
+			this->TraceBuffer[ii].swap(data[ii]->getTrace());
+		}
+	}else if( not this->CmdOpts.write_traces and not this->CmdOpts.lean_hits ){
+		for( auto& hit : data ){
+			hit->getTrace().clear();
+		}
+	}
+
+	if( this->CmdOpts.lean_hits ){
+		// Copy the hits into the contiguous event, its storage is reused from entry to entry
+		const bool withtraces = this->CmdOpts.write_traces and not this->TraceTree;
+		this->LeanEvent.Reset();
+		for( const auto& hit : data ){
+			this->LeanEvent.AddChannelData(*hit,withtraces);
+		}
+		this->LeanEvent.Trim();
+	}else if( &event != this->CurrEvent ){
+		this->CurrEvent = &event;
+		this->OutputTree->SetBranchAddress(this->CmdOpts.legacy ? "dchan" : "rawevents",&(this->CurrEvent));
+	}
+
+	if( this->TraceTree ){
+		this->TraceEventID = this->EventsWritten;
+		this->TraceTree->Fill();
+	}
+	this->OutputTree->Fill();
+	++(this->EventsWritten);
+	this->HitsWritten += data.size();
+}
+
+void TTreeEventWriter::Save(){
+	// SaveSelf also writes the keys and the free segments, a reader opening the file sees every entry so far
+	if( this->TraceTree ){
+		this->TraceFile->cd();
+		this->TraceTree->AutoSave("SaveSelf");
+	}
+	this->OutputFile->cd();
+	this->OutputTree->AutoSave("SaveSelf");
+}
+
+void TTreeEventWriter::Finalize(){
+	if( this->TraceTree ){
+		this->TraceFile->cd();
+		this->TraceTree->Write("",TObject::kOverwrite);
+		// Readers of the main tree pick up the traces automatically through the friend
+		if( this->TraceFile == this->OutputFile ){
+			this->OutputTree->AddFriend(this->TraceTree);
+		}else{
+			this->OutputTree->AddFriend(this->GetTraceTreeName().c_str(),this->CmdOpts.trace_file.c_str());
+		}
+	}
+	this->OutputFile->cd();
+	this->OutputTree->Write("",TObject::kOverwrite);
+	EventWriter::Finalize();
+}
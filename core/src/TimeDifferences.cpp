@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cmath>
+
+#include <fmt/format.h>
+
+#include <TDirectory.h>
+#include <TH1.h>
+
+#include "TimeDifferences.h"
+#include "DDASRootHit.h"
+
+namespace{
+	inline uint16_t ChannelIndex(uint32_t crate,uint32_t slot,uint32_t chan){
+		return ((crate & 0xF) << 8) | ((slot & 0xF) << 4) | (chan & 0xF);
+	}
+}
+
+TimeDifferences::TimeDifferences(const std::string& log,const ldf2root::CmdOptions& cmdopts){
+	this->LogName = log;
+	this->Range = cmdopts.dt_range;
+	this->BinWidth = cmdopts.dt_bin;
+	this->NumBins = static_cast<size_t>(std::ceil(2.0*this->Range/this->BinWidth));
+	this->Pairs = 0;
+	this->ReferenceIndex.fill(-1);
+	this->console = spdlog::get(this->LogName)->clone("TimeDifferences");
+
+	for( const auto& ref : cmdopts.dt_references ){
+		const uint16_t idx = ChannelIndex(ref.crate,ref.slot,ref.channel);
+		if( this->ReferenceIndex[idx] >= 0 ){
+			continue;
+		}
+		this->ReferenceIndex[idx] = this->References.size();
+		this->References.emplace_back();
+		this->References.back().Channel = ref;
+		this->References.back().All.resize(this->NumBins,0);
+	}
+	this->console->info("Counting time differences within {} ns of {} reference channels in {} ns bins",this->Range,this->References.size(),this->BinWidth);
+}
+
+void TimeDifferences::Count(ReferenceCounts& ref,uint16_t channel,double dt){
+	// Only a hit released late by the streaming time ordering can be this far apart
+	if( not (std::fabs(dt) < this->Range) ){
+		return;
+	}
+	const size_t bin = std::min(static_cast<size_t>((dt + this->Range)/this->BinWidth),this->NumBins - 1);
+	auto& pairs = ref.Pairs[channel];
+	if( not pairs ){
+		pairs = std::make_unique<std::vector<uint64_t>>(this->NumBins,0);
+	}
+	++(*pairs)[bin];
+	++ref.All[bin];
+	++this->Pairs;
+}
+
+void TimeDifferences::AddHit(const DDASRootHit& hit){
+	const double time = hit.getTime();
+	while( not this->Recent.empty() and time - this->Recent.front().Time >= this->Range ){
+		this->Recent.pop_front();
+	}
+	const uint16_t channel = ChannelIndex(hit.getCrateID(),hit.getSlotID(),hit.getChannelID());
+	const int reference = this->ReferenceIndex[channel];
+	for( const auto& prev : this->Recent ){
+		if( prev.Reference >= 0 ){
+			this->Count(this->References[prev.Reference],channel,time - prev.Time);
+		}
+		if( reference >= 0 ){
+			this->Count(this->References[reference],prev.Channel,prev.Time - time);
+		}
+	}
+	this->Recent.push_back({time,channel,reference});
+}
+
+void TimeDifferences::Write(TDirectory* file){
+	TDirectory* top = file->mkdir("histos","Spectra filled during the conversion",true);
+	TDirectory* dtdir = top->mkdir("dt","Time differences to the reference channels",true);
+
+	const auto writeHistogram = [this](TDirectory* dir,const std::vector<uint64_t>& bins,const std::string& name,const std::string& title){
+		TH1D hist(name.c_str(),title.c_str(),this->NumBins,-this->Range,this->NumBins*this->BinWidth - this->Range);
+		hist.SetDirectory(nullptr);
+		uint64_t entries = 0;
+		for( size_t ii = 0; ii < bins.size(); ++ii ){
+			if( bins[ii] > 0 ){
+				hist.SetBinContent(ii + 1,bins[ii]);
+				entries += bins[ii];
+			}
+		}
+		hist.SetEntries(entries);
+		dir->WriteTObject(&hist);
+	};
+	for( const auto& ref : this->References ){
+		const std::string refname = fmt::format("c{}_s{}_ch{}",ref.Channel.crate,ref.Channel.slot,ref.Channel.channel);
+		const std::string reftitle = fmt::format("crate {} slot {} channel {}",ref.Channel.crate,ref.Channel.slot,ref.Channel.channel);
+		TDirectory* refdir = dtdir->mkdir(("ref_"+refname).c_str(),("Reference "+reftitle).c_str(),true);
+		size_t nchannels = 0;
+		for( size_t ii = 0; ii < MAX_CHANNELS; ++ii ){
+			if( not ref.Pairs[ii] ){
+				continue;
+			}
+			const size_t crate = ii >> 8;
+			const size_t slot = (ii >> 4) & 0xF;
+			const size_t chan = ii & 0xF;
+			writeHistogram(refdir,*ref.Pairs[ii],fmt::format("dt_c{}_s{}_ch{}",crate,slot,chan),
+				fmt::format("t(crate {} slot {} channel {}) - t({});#Deltat [ns];pairs",crate,slot,chan,reftitle));
+			++nchannels;
+		}
+		writeHistogram(refdir,ref.All,"dt_all",fmt::format("t(any channel) - t({});#Deltat [ns];pairs",reftitle));
+		this->console->info("Reference {} : time differences to {} channels",refname,nchannels);
+	}
+	this->console->info("Wrote the time differences of {} pairs to histos/dt/",this->Pairs);
+}
@@ -0,0 +1,71 @@
+#include <fstream>
+#include <stdexcept>
+
+#include <spdlog/fmt/fmt.h>
+
+#include "TraceRecorder.h"
+
+TraceRecorder& TraceRecorder::Instance(){
+	static TraceRecorder recorder;
+	return recorder;
+}
+
+TraceRecorder::TraceRecorder(){
+	this->Enabled = false;
+	this->Epoch = std::chrono::steady_clock::now();
+}
+
+TraceRecorder::ThreadBuffer& TraceRecorder::LocalBuffer(){
+	// The recorder shares ownership so the spans survive the thread that recorded them
+	thread_local std::shared_ptr<ThreadBuffer> buffer;
+	if( not buffer ){
+		buffer = std::make_shared<ThreadBuffer>();
+		buffer->Dropped = 0;
+		std::lock_guard<std::mutex> lock(this->Mutex);
+		buffer->ThreadID = this->Buffers.size()+1;
+		buffer->ThreadName = "thread "+std::to_string(buffer->ThreadID);
+		this->Buffers.push_back(buffer);
+	}
+	return *buffer;
+}
+
+void TraceRecorder::Record(const char* name,const char* category,int64_t start,int64_t end,const char* argkey,int64_t argvalue){
+	auto& buffer = this->LocalBuffer();
+	if( buffer.Events.size() >= MaxEventsPerThread ){
+		++buffer.Dropped;
+		return;
+	}
+	buffer.Events.push_back({name,category,start,end-start,argkey,argvalue});
+}
+
+void TraceRecorder::SetThreadName(const std::string& name){
+	auto& buffer = this->LocalBuffer();
+	std::lock_guard<std::mutex> lock(this->Mutex);
+	buffer.ThreadName = name;
+}
+
+void TraceRecorder::Write(const std::string& filename){
+	std::ofstream ofs(filename);
+	if( not ofs ){
+		throw std::runtime_error("Unable to open trace timeline file : "+filename);
+	}
+	std::lock_guard<std::mutex> lock(this->Mutex);
+	ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	ofs << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"ldf2root\"}}";
+	for( const auto& buffer : this->Buffers ){
+		ofs << fmt::format(",\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",buffer->ThreadID,buffer->ThreadName);
+		if( buffer->Dropped > 0 ){
+			ofs << fmt::format(",\n{{\"name\":\"dropped spans\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":{},\"ts\":0,\"args\":{{\"count\":{}}}}}",buffer->ThreadID,buffer->Dropped);
+		}
+		// Timestamps are in microseconds, keep the nanoseconds as decimals
+		for( const auto& evt : buffer->Events ){
+			ofs << fmt::format(",\n{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}",
+			                   evt.Name,evt.Category,buffer->ThreadID,evt.StartNs*1.0e-3,evt.DurationNs*1.0e-3);
+			if( evt.ArgKey ){
+				ofs << fmt::format(",\"args\":{{\"{}\":{}}}",evt.ArgKey,evt.ArgValue);
+			}
+			ofs << "}";
+		}
+	}
+	ofs << "\n]}\n";
+}
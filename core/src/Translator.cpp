@@ -4,25 +4,34 @@
 #include <stdexcept>
 
 #include "Translator.h"
+#include "FileFollower.h"
 
-Translator::Translator(const std::string& log,const std::string& translatorname){
+Translator::Translator(const std::string& log,const std::string& translatorname) : LogLimiter(nullptr,10,std::chrono::seconds(30)){
 	this->LogName = log;
 	this->TranslatorName = translatorname;
 
 	this->console = spdlog::get(this->LogName)->clone(this->TranslatorName);
+	this->LogLimiter.SetLogger(this->console);
 	this->console->info("Created Translator [{}]",this->TranslatorName);
 	
 	this->LastReadEvtWithin = false;
 	this->CurrExtTS = std::numeric_limits<uint64_t>::max();
+	this->BytesRead = 0;
 
 	// this->CustomLeftovers = std::vector<std::deque<std::unique_ptr<ddasfmt::DDASHit>>>(13);
 	// this->LeftoverSpillIDs = std::vector<std::deque<uint64_t>>(13);
 }
 
 Translator::~Translator(){
-	if( not this->CurrentFile.eof() or this->CurrentFileIndex < this->NumTotalFiles ){
+	// A followed file does not end at its end of file, only with its double EOF buffer
+	if( this->Follower ){
+		if( this->Follower->IsStopped() ){
+			this->console->warn("Stopped following the input before the end of the run");
+		}
+	}else if( not this->CurrentFile.eof() or this->CurrentFileIndex < this->NumTotalFiles ){
 		this->console->error("Translator didn't finish reading final file");
 	}
+	this->LogLimiter.Report();
 }
 		
 bool Translator::AddFile(const std::string& filename){
@@ -56,6 +65,7 @@ bool Translator::OpenNextFile(){
 		this->console->info("Opening First File : {}",this->InputFiles.at(this->CurrentFileIndex));
 		this->CurrentFile.open(this->InputFiles.at(this->CurrentFileIndex),std::ifstream::binary);
 		++(this->CurrentFileIndex);
+		this->CheckCompression();
 		return true;
 	}else if(this->CurrentFileIndex == this->NumTotalFiles){
 		this->console->info("Completed Final File : {}",this->InputFiles.at(this->CurrentFileIndex-1));
@@ -67,10 +77,34 @@ bool Translator::OpenNextFile(){
 		this->CurrentFile.close();
 		this->CurrentFile.open(this->InputFiles.at(this->CurrentFileIndex),std::ifstream::binary);
 		++(this->CurrentFileIndex);
+		this->CheckCompression();
 		return true;
 	}
 }
 
+void Translator::CheckCompression(){
+	if( this->CurrentFile.GetCompression() == InputStream::Compression::NONE ){
+		return;
+	}
+	// Following needs the size of the decompressed data on disk
+	if( this->Follower ){
+		throw std::runtime_error("Following needs an uncompressed input file, "+this->InputFiles.at(this->CurrentFileIndex-1)+" is "+InputStream::CompressionName(this->CurrentFile.GetCompression())+" compressed");
+	}
+	this->console->info("Decompressing {} input {} while reading it",InputStream::CompressionName(this->CurrentFile.GetCompression()),this->InputFiles.at(this->CurrentFileIndex-1));
+}
+
+bool Translator::WaitForData(uint64_t nbytes){
+	if( not this->Follower ){
+		return true;
+	}
+	const std::streamoff pos = this->CurrentFile.tellg();
+	if( pos < 0 ){
+		// The stream already failed, the read reports it
+		return true;
+	}
+	return this->Follower->WaitForSize(this->InputFiles.at(this->CurrentFileIndex-1),static_cast<uint64_t>(pos) + nbytes);
+}
+
 // void Translator::SetChannelMap(const std::shared_ptr<ChannelMap>& cmap){
 // 	this->CMap = cmap;
 // }
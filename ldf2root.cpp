@@ -9,6 +9,7 @@
   *@param tree_name Name of the ROOT tree to create (default: "ddas/rawevents")
   *@param silent Suppress output messages (optional)
   *@param legacy Use legacy ROOT file output structure (optional)
+  *@param format Output container, TTree or RNTuple (optional, defaults to TTree)
 */
 
 // Include necessary system headers
@@ -24,23 +25,36 @@
 #include <sstream>
 #include <chrono>
 #include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <numeric>
+#include <set>
+#include <thread>
+#include <csignal>
 
 // Include necessary ROOT headers
 #include <TFile.h>
 #include <TTree.h>
 #include <TBranch.h>
 #include <RtypesCore.h>
+#include <TROOT.h>
 
 // GenScan Classes
 
 #include <spdlog/common.h>
 #include <spdlog/spdlog.h>
+#include <spdlog/async.h>
 #include <spdlog/cfg/env.h>
 #include <spdlog/fmt/ostr.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 
-#include "DataParser.h"
+#include "FileFollower.h"
+#include "Pipeline.h"
+#include "PipelineMetrics.h"
+#include "RunWatcher.h"
+#include "TraceRecorder.h"
 
 // Include additional user headers
 #include "InputParser.h"
@@ -48,15 +62,20 @@
 #include "DDASRootEvent.h"
 #include "DDASHitUnpacker.h"
 
-using chrono_duration = std::chrono::duration<double>;
+void AddDDASWords(const uint32_t&, uint32_t&, std::vector<bool>& );
+void WriteTraceTimeline(const std::string&, std::shared_ptr<spdlog::logger>);
 
-typedef std::vector<std::unique_ptr<DDASRootHit>> UnpackedHitVector;
-typedef std::vector<uint32_t> RawDataVector;
+// SIGINT or SIGTERM stop the watcher once the running conversions are done, a second one kills the process
+extern "C" void StopWatching(int signum) {
+  RunWatcher::RequestStop();
+  std::signal(signum, SIG_DFL);
+}
 
-void AddDDASWords(const uint32_t&, uint32_t&, std::vector<bool>& );
-chrono_duration EventBuild(UnpackedHitVector*, DDASRootEvent&,ldf2root::CmdOptions , TTree* , const std::string& );
-chrono_duration SortEvents(UnpackedHitVector* );
-chrono_duration UnpackEvents(RawDataVector*,UnpackedHitVector*);
+// The first Ctrl-C ends following and closes the output file properly, a second one kills the process
+extern "C" void StopFollowing(int) {
+  FileFollower::RequestStop();
+  std::signal(SIGINT, SIG_DFL);
+}
 
 void generate_default_config(const std::string& filename = "example_config.txt") {
     std::ofstream ofs(filename);
@@ -86,9 +105,86 @@ void PrintUsageString(std::ostream& os = std::cout) {
   os << "  --output-file <file>   Path to the output ROOT file (Optional: default input_files.ldf -> input_files.root)\n";
   os << "  --tree-name <name>     Name of the ROOT tree to create (default: 'ddas')\n";
   os << "  --build-window <time>  Build window in nanoseconds (default: 3000)\n";
-  os << "  --window-type <type>   Type of window to use (0: flat, 1: fixed, 2: rolling; default: 1)\n";
+  os << "  --window-type <type>   Type of window to use (0: flat, 1: fixed, 2: rolling, 3: triggered; default: 1)\n";
+  os << "  --trigger <c:s:ch>     Build events only around hits of this crate:slot:channel, dropping all other hits (repeatable, implies --window-type 3)\n";
+  os << "  --pre-window <ns>      Nanoseconds before a trigger hit that belong to its event (default 0)\n";
+  os << "  --post-window <ns>     Nanoseconds after a trigger hit that belong to its event (default: the build window)\n";
+  os << "  --coarse-windows       Compare the build windows on the integer coarse timestamps, without the CFD correction\n";
   os << "  --silent               Suppress output messages\n";
   os << "  --legacy               ROOT file output uses legacy DDASEvent/ddaschannel object structure\n";
+  os << "  --format <type>        Output container (ttree or rntuple; default: ttree)\n";
+  os << "  --no-traces            Do not write the ADC traces to the output file\n";
+  os << "  --no-spill-tree        Do not write the per-spill bookkeeping tree '<tree-name>_spills'\n";
+  os << "  --lean-hits            Write split DDASFlatEvent/DDASFlatHit instead of DDASRootEvent/DDASRootHit (ttree format)\n";
+  os << "  --split-traces         Write the ADC traces to a separate friend tree '<tree-name>_traces'\n";
+  os << "  --trace-file <file>    Put the split traces in this file instead of the output file (implies --split-traces)\n";
+  os << "  --log-queue <n>        Size of the asynchronous log queue (default 8192 messages)\n";
+  os << "  --log-burst <n>        Repeated per-spill messages of one kind logged per log interval (default 10)\n";
+  os << "  --log-interval <s>     Seconds between summaries of suppressed per-spill messages (default 30)\n";
+  os << "  --metrics <file>       Write per-stage throughput metrics to this JSON file\n";
+  os << "  --metrics-prom <file>  Write the per-stage metrics as a Prometheus textfile\n";
+  os << "  --metrics-interval <s> Seconds between metrics snapshots, 0 only writes them at the end (default 10)\n";
+  os << "  --trace-timeline <file> Record a Chrome/Perfetto trace-event timeline of the conversion to this JSON file\n";
+  os << "  --sort-memory <MB>     Sort with sorted runs on scratch disk, keeping the hit memory under this limit\n";
+  os << "  --sort-scratch <dir>   Directory for the sorted runs (default: the system temporary directory)\n";
+  os << "  --stream-sort          Time order the hits spill by spill in a bounded reorder buffer instead of sorting all hits\n";
+  os << "  --reorder-horizon <ns> Lateness the streaming time ordering still puts in order (default 1e9, about one spill)\n";
+  os << "  --follow               Keep converting the input file while the DAQ is writing it, until the end of the run\n";
+  os << "  --follow-timeout <s>   Stop following when the file has not grown for this long (default 0: wait forever)\n";
+  os << "  --follow-save <s>      Seconds between saves of the output file while following (default 10)\n";
+  os << "  --batch                Convert every input file into its own output file, in one process\n";
+  os << "  --jobs <n>             Runs converted at the same time in batch mode, 0 uses one per core (default 1)\n";
+  os << "  --output-dir <dir>     Directory for the output files of a batch (default: next to each input file)\n";
+  os << "  --watch <dir>          Run as a daemon converting every finished .ldf file that appears in this directory\n";
+  os << "  --watch-interval <s>   Seconds between scans of the watch directory (default 10)\n";
+  os << "  --state-file <file>    Files converted by the watcher, never converted twice (default: <output-dir>/ldf2root_watch.state)\n";
+  os << "  --digest <file>        Write a digest of every built event and hit to this file, compare two with ldf2root_compare\n";
+  os << "  --digest-output        Take the digest from the written output file instead of the built events\n";
+  os << "  --decompress-threads <n> Workers decompressing a .ldf.zst or .ldf.xz input, 0 uses one per core (default 0)\n";
+  os << "  --read-ahead <n>       Blocks of the input file read ahead in parallel, 0 reads synchronously (default 4)\n";
+  os << "  --read-block <KB>      Size of a read ahead block (default 4096)\n";
+  os << "  --histos               Fill energy, hit rate and multiplicity histograms while building, written to histos/\n";
+  os << "  --histo-energy-bins <n> Bins of the energy histograms over the 16 bit range (default 4096)\n";
+  os << "  --histo-rate-bin <s>   Seconds per bin of the hit rate histograms (default 1)\n";
+  os << "  --filter <expr>        Only write the events passing this expression, e.g. 'mult >= 2 && has(0:2:0)' (repeatable)\n";
+  os << "  --dt-ref <c:s:ch>       Histogram the time differences of all channels to this crate:slot:channel (repeatable)\n";
+  os << "  --dt-range <ns>        Largest time difference to a reference channel (default 5000)\n";
+  os << "  --dt-bin <ns>          Bin width of the time difference histograms (default 2)\n";
+  os << "  --scan                 Only log the run statistics (spills, chunks, hit rates per module, time span), no output file\n";
+  os << "  --scan-json <file>     Also write the run statistics of the scan to this JSON file (implies --scan)\n";
+}
+
+// Input path without the .ldf extension and the .zst or .xz of a compressed file, empty if it is not an LDF file
+std::string LDFStem(const std::string& input) {
+  std::string stem = input;
+  for (const std::string ext : {".zst", ".xz"}) {
+    if (stem.size() > ext.size() && stem.compare(stem.size() - ext.size(), ext.size(), ext) == 0) {
+      stem.resize(stem.size() - ext.size());
+      break;
+    }
+  }
+  if (stem.size() < 4 || stem.substr(stem.size() - 4) != ".ldf") {
+    return "";
+  }
+  return stem.substr(0, stem.size() - 4);
+}
+
+// Run name of an LDF file in a batch or the watcher, its file name without the extensions
+std::string RunName(const std::string& input) {
+  return std::filesystem::path(LDFStem(input)).filename().string();
+}
+
+// Channel of an option given as crate:slot:channel, exits on a malformed value
+ldf2root::ChannelID ParseChannelID(const std::string& option, const std::string& value) {
+  ldf2root::ChannelID id;
+  char sep1 = 0, sep2 = 0;
+  std::istringstream iss(value);
+  if (!(iss >> id.crate >> sep1 >> id.slot >> sep2 >> id.channel) || sep1 != ':' || sep2 != ':' || !iss.eof() ||
+      id.crate > 15 || id.slot > 15 || id.channel > 15) {
+    std::cerr << option << " takes a channel as crate:slot:channel, each 0 to 15, not " << value << std::endl;
+    exit(1);
+  }
+  return id;
 }
 
 void parse_args(int argc, char* argv[], ldf2root::CmdOptions& opts) {
@@ -118,20 +214,124 @@ void parse_args(int argc, char* argv[], ldf2root::CmdOptions& opts) {
       opts.build_window = std::stod(argv[++i]);
     } else if (arg == "--window-type" && i + 1 < argc) {
       int tmp = std::stoi(argv[++i]);
-      if (tmp < 0 || tmp > 2) {
-        std::cerr << "Invalid window type. Must be 0 (flat), 1(fixed), or 2 (rolling)." << std::endl;
+      if (tmp < 0 || tmp > 3) {
+        std::cerr << "Invalid window type. Must be 0 (flat), 1(fixed), 2 (rolling), or 3 (triggered)." << std::endl;
+        exit(1);
       }
       if (tmp == 1) {
         opts.build_window_type = ldf2root::WindowType::FIXED;
       } else if (tmp == 2) {
         opts.build_window_type = ldf2root::WindowType::ROLLING;
+      } else if (tmp == 3) {
+        opts.build_window_type = ldf2root::WindowType::TRIGGERED;
       }
+    } else if (arg == "--trigger" && i + 1 < argc) {
+      opts.trigger_channels.push_back(ParseChannelID(arg, argv[++i]));
+      opts.build_window_type = ldf2root::WindowType::TRIGGERED;
+    } else if (arg == "--pre-window" && i + 1 < argc) {
+      opts.pre_window = std::stod(argv[++i]);
+    } else if (arg == "--post-window" && i + 1 < argc) {
+      opts.post_window = std::stod(argv[++i]);
+    } else if (arg == "--coarse-windows") {
+      opts.coarse_windows = true;
     } else if (arg == "--log-file") {
       opts.log_file = true;
     } else if (arg == "--silent") {
       opts.silent = true;
     } else if (arg == "--legacy") {
       opts.legacy = true;
+    } else if (arg == "--format" && i + 1 < argc) {
+      std::string fmt = argv[++i];
+      if (fmt == "ttree") {
+        opts.output_format = ldf2root::OutputFormat::TTREE;
+      } else if (fmt == "rntuple") {
+        opts.output_format = ldf2root::OutputFormat::RNTUPLE;
+      } else {
+        std::cerr << "Invalid output format. Must be ttree or rntuple." << std::endl;
+        exit(1);
+      }
+    } else if (arg == "--no-traces") {
+      opts.write_traces = false;
+    } else if (arg == "--no-spill-tree") {
+      opts.spill_tree = false;
+    } else if (arg == "--lean-hits") {
+      opts.lean_hits = true;
+    } else if (arg == "--split-traces") {
+      opts.split_traces = true;
+    } else if (arg == "--trace-file" && i + 1 < argc) {
+      opts.split_traces = true;
+      opts.trace_file = argv[++i];
+    } else if (arg == "--log-queue" && i + 1 < argc) {
+      opts.log_queue_size = std::stoul(argv[++i]);
+    } else if (arg == "--log-burst" && i + 1 < argc) {
+      opts.log_burst = std::stoul(argv[++i]);
+    } else if (arg == "--log-interval" && i + 1 < argc) {
+      opts.log_interval = std::stoul(argv[++i]);
+    } else if (arg == "--metrics" && i + 1 < argc) {
+      opts.metrics_file = argv[++i];
+    } else if (arg == "--metrics-prom" && i + 1 < argc) {
+      opts.metrics_prom_file = argv[++i];
+    } else if (arg == "--metrics-interval" && i + 1 < argc) {
+      opts.metrics_interval = std::stoul(argv[++i]);
+    } else if (arg == "--trace-timeline" && i + 1 < argc) {
+      opts.trace_timeline_file = argv[++i];
+    } else if (arg == "--sort-memory" && i + 1 < argc) {
+      opts.sort_memory_mb = std::stoul(argv[++i]);
+    } else if (arg == "--sort-scratch" && i + 1 < argc) {
+      opts.sort_scratch = argv[++i];
+    } else if (arg == "--stream-sort") {
+      opts.stream_sort = true;
+    } else if (arg == "--reorder-horizon" && i + 1 < argc) {
+      opts.reorder_horizon = std::stod(argv[++i]);
+    } else if (arg == "--follow") {
+      opts.follow = true;
+    } else if (arg == "--follow-timeout" && i + 1 < argc) {
+      opts.follow_timeout = std::stoul(argv[++i]);
+    } else if (arg == "--follow-save" && i + 1 < argc) {
+      opts.follow_save = std::stoul(argv[++i]);
+    } else if (arg == "--batch") {
+      opts.batch = true;
+    } else if (arg == "--jobs" && i + 1 < argc) {
+      opts.jobs = std::stoul(argv[++i]);
+    } else if (arg == "--output-dir" && i + 1 < argc) {
+      opts.output_dir = argv[++i];
+    } else if (arg == "--watch" && i + 1 < argc) {
+      opts.watch_dir = argv[++i];
+    } else if (arg == "--watch-interval" && i + 1 < argc) {
+      opts.watch_interval = std::stoul(argv[++i]);
+    } else if (arg == "--state-file" && i + 1 < argc) {
+      opts.state_file = argv[++i];
+    } else if (arg == "--digest" && i + 1 < argc) {
+      opts.digest_file = argv[++i];
+    } else if (arg == "--digest-output") {
+      opts.digest_output = true;
+    } else if (arg == "--decompress-threads" && i + 1 < argc) {
+      opts.decompress_threads = std::stoul(argv[++i]);
+    } else if (arg == "--read-ahead" && i + 1 < argc) {
+      opts.read_ahead = std::stoul(argv[++i]);
+    } else if (arg == "--read-block" && i + 1 < argc) {
+      opts.read_block_kb = std::stoul(argv[++i]);
+    } else if (arg == "--histos") {
+      opts.histos = true;
+    } else if (arg == "--histo-energy-bins" && i + 1 < argc) {
+      opts.histos = true;
+      opts.histo_energy_bins = std::stoul(argv[++i]);
+    } else if (arg == "--histo-rate-bin" && i + 1 < argc) {
+      opts.histos = true;
+      opts.histo_rate_bin = std::stod(argv[++i]);
+    } else if (arg == "--filter" && i + 1 < argc) {
+      opts.filters.push_back(argv[++i]);
+    } else if (arg == "--dt-ref" && i + 1 < argc) {
+      opts.dt_references.push_back(ParseChannelID(arg, argv[++i]));
+    } else if (arg == "--dt-range" && i + 1 < argc) {
+      opts.dt_range = std::stod(argv[++i]);
+    } else if (arg == "--dt-bin" && i + 1 < argc) {
+      opts.dt_bin = std::stod(argv[++i]);
+    } else if (arg == "--scan") {
+      opts.scan = true;
+    } else if (arg == "--scan-json" && i + 1 < argc) {
+      opts.scan = true;
+      opts.scan_json = argv[++i];
     } else if (!arg.empty() && arg[0] == '-') {
       std::cerr << "Unknown option: " << arg << std::endl<<std::endl;
       PrintUsageString(std::cerr);
@@ -139,8 +339,13 @@ void parse_args(int argc, char* argv[], ldf2root::CmdOptions& opts) {
     }
   }
   
+  const bool watching = !opts.watch_dir.empty();
+  if (watching && (!opts.input_files.empty() || !opts.output_file.empty() || opts.batch || opts.follow)) {
+    std::cerr << "--watch takes its input files from the watch directory, it can not be combined with --input, --output, --batch or --follow." << std::endl;
+    exit(1);
+  }
   // Check if input file is specified
-  if (opts.input_files.empty()) {
+  if (opts.input_files.empty() && !watching) {
     std::cerr << "No input file specified." << std::endl;
     PrintUsageString(std::cerr);
     exit(1);
@@ -151,14 +356,91 @@ void parse_args(int argc, char* argv[], ldf2root::CmdOptions& opts) {
     PrintUsageString(std::cerr);
     exit(1);
   }
-  // Check input file ends with .ldf
-  if (opts.input_files.at(0).size() < 4 || opts.input_files.at(0).substr(opts.input_files.at(0).size() - 4) != ".ldf") {
-    std::cerr << "Input file must be of type .ldf." << std::endl;
+  // Check input file ends with .ldf (.ldf.zst or .ldf.xz when compressed), in batch mode every input is a run of its own
+  for (const auto& input : opts.input_files) {
+    if (LDFStem(input).empty()) {
+      std::cerr << "Input file must be of type .ldf, .ldf.zst or .ldf.xz." << std::endl;
+      exit(1);
+    }
+    if (!opts.batch) {
+      break;
+    }
+  }
+  if (opts.batch && !opts.output_file.empty()) {
+    std::cerr << "--output can not be used with --batch, every run is written to <output-dir>/<run>.root" << std::endl;
+    exit(1);
+  }
+  if (!opts.batch && !watching && (!opts.output_dir.empty() || opts.jobs != 1)) {
+    std::cerr << "--jobs and --output-dir need --batch or --watch." << std::endl;
+    exit(1);
+  }
+  if (watching && opts.jobs == 0) {
+    opts.jobs = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // Set default output file if not set, the runs of a batch or the watcher get theirs when they start
+  if (opts.output_file.empty() && !opts.batch && !watching) {
+    opts.output_file = LDFStem(opts.input_files.at(0)) + ".root";
+  }
+  if (opts.legacy && opts.output_format != ldf2root::OutputFormat::TTREE) {
+    std::cerr << "The legacy output structure is only available with the ttree format." << std::endl;
+    exit(1);
+  }
+  if (opts.legacy && opts.lean_hits) {
+    std::cerr << "--legacy and --lean-hits can not be combined." << std::endl;
+    exit(1);
+  }
+  if (opts.lean_hits && opts.output_format != ldf2root::OutputFormat::TTREE) {
+    std::cerr << "--lean-hits is only available with the ttree format." << std::endl;
+    exit(1);
+  }
+  if (opts.follow && (opts.batch || opts.sort_memory_mb > 0)) {
+    std::cerr << "--follow can not be combined with --batch or --sort-memory." << std::endl;
+    exit(1);
+  }
+  // Following builds the events spill by spill, a full sort would wait for the end of the run
+  if (opts.follow) {
+    opts.stream_sort = true;
+  }
+  if (opts.stream_sort && opts.sort_memory_mb > 0) {
+    std::cerr << "--stream-sort and --sort-memory can not be combined." << std::endl;
+    exit(1);
+  }
+  if (opts.digest_output && opts.digest_file.empty()) {
+    std::cerr << "--digest-output needs --digest." << std::endl;
+    exit(1);
+  }
+  if (opts.stream_sort && !(opts.reorder_horizon > 0.0)) {
+    std::cerr << "The reorder horizon must be positive." << std::endl;
     exit(1);
   }
-  // Set default output file if not set
-  if (opts.output_file.empty()) {
-    opts.output_file = opts.input_files.at(0).substr(0, opts.input_files.at(0).size() - 4) + ".root";
+  // The external sort gets the raw words in blocks of 2/5 of its memory limit, with a quarter block
+  // of headroom for the spill that crosses the limit the raw buffer takes half of it
+  if (opts.sort_memory_mb > 0) {
+    opts.parse_block_words = opts.sort_memory_mb*1024*1024*2/(5*sizeof(uint32_t));
+  }
+  // The streaming time ordering gets every spill as soon as it is parsed
+  if (opts.stream_sort) {
+    opts.parse_block_words = 1;
+  }
+  if (opts.histos && (opts.histo_energy_bins == 0 || opts.histo_energy_bins > 65536 || !(opts.histo_rate_bin >= 1.0e-3))) {
+    std::cerr << "The energy histograms need 1 to 65536 bins and the rate bin must be at least 1 ms." << std::endl;
+    exit(1);
+  }
+  if (opts.build_window_type == ldf2root::WindowType::TRIGGERED && opts.trigger_channels.empty()) {
+    std::cerr << "The triggered window type needs at least one --trigger channel." << std::endl;
+    exit(1);
+  }
+  if (!(opts.pre_window >= 0.0)) {
+    std::cerr << "The pre window can not be negative." << std::endl;
+    exit(1);
+  }
+  if (!opts.dt_references.empty() && (!(opts.dt_range > 0.0) || !(opts.dt_bin > 0.0) || 2.0*opts.dt_range/opts.dt_bin > 1.0e6)) {
+    std::cerr << "The time difference range and bin width must be positive, with at most 1e6 bins." << std::endl;
+    exit(1);
+  }
+  // A scan keeps only a block of raw words in memory, while following every spill is counted as it arrives
+  if (opts.scan && !opts.follow) {
+    opts.parse_block_words = 4*1024*1024;
   }
   // Set default tree name if not set
   if (opts.legacy) {
@@ -175,9 +457,21 @@ void parse_args(int argc, char* argv[], ldf2root::CmdOptions& opts) {
   } else {
     opts.outfile_stem = opts.output_file;
   }
+  // The watcher writes everything to the output directory, its own log included
+  if (watching) {
+    if (opts.output_dir.empty()) {
+      opts.output_dir = opts.watch_dir;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(opts.output_dir, ec);
+    if (opts.state_file.empty()) {
+      opts.state_file = (std::filesystem::path(opts.output_dir) / "ldf2root_watch.state").string();
+    }
+    opts.outfile_stem = (std::filesystem::path(opts.output_dir) / "ldf2root_watch").string();
+  }
 }
 
-bool ReadConfigFile(ldf2root::CmdOptions opts) {
+bool ReadConfigFile(ldf2root::CmdOptions& opts) {
   std::ifstream infile(opts.config_file);
   if (!infile.is_open()) {
     std::cerr << "Failed to open config file: " << opts.config_file << std::endl;
@@ -203,13 +497,184 @@ bool ReadConfigFile(ldf2root::CmdOptions opts) {
   return true;
 }
 
+// Loggers of a run log to <stem>.log/.err/.dbg and the console, through the shared asynchronous thread pool
+std::shared_ptr<spdlog::logger> CreateRunLogger(const std::string& name, const std::string& stem, const std::string& consolePattern = "") {
+	std::shared_ptr<spdlog::sinks::basic_file_sink_mt> LogFileSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(stem+".log",true);
+	LogFileSink->set_level(spdlog::level::info);
+
+	std::shared_ptr<spdlog::sinks::basic_file_sink_mt> ErrorFileSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(stem+".err",true);
+	ErrorFileSink->set_level(spdlog::level::err);
+
+	std::shared_ptr<spdlog::sinks::basic_file_sink_mt> DebugFileSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(stem+".dbg",true);
+	DebugFileSink->set_level(spdlog::level::debug);
+
+	std::shared_ptr<spdlog::sinks::stdout_color_sink_mt> LogFileConsole = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+	LogFileConsole->set_level(spdlog::level::info);
+	if (!consolePattern.empty()) {
+		LogFileConsole->set_pattern(consolePattern);
+	}
+
+	std::vector<spdlog::sink_ptr> sinks {DebugFileSink,LogFileSink,ErrorFileSink,LogFileConsole};
+	// Producers block when the queue is full rather than dropping messages, the per-spill messages
+	// are rate limited in the translator so the queue only fills up on a pathological input.
+	auto console = std::make_shared<spdlog::async_logger>(name,sinks.begin(),sinks.end(),spdlog::thread_pool(),spdlog::async_overflow_policy::block);
+	spdlog::initialize_logger(console);
+	console->flush_on(spdlog::level::warn);
+	return console;
+}
+
+// Insert the run name in front of the extension of a per-run output path: metrics.json -> metrics_run042.json
+std::string PerRunPath(const std::string& path, const std::string& run) {
+  if (path.empty()) {
+    return path;
+  }
+  std::filesystem::path p(path);
+  return (p.parent_path() / (p.stem().string() + "_" + run + p.extension().string())).string();
+}
+
+// Options of one run of a batch or of the watcher, the output and the per-run files go to the output directory
+ldf2root::CmdOptions MakeRunOptions(const ldf2root::CmdOptions& opts, const std::string& input) {
+  const std::filesystem::path inpath(input);
+  const std::string run = RunName(input);
+  ldf2root::CmdOptions runopts = opts;
+  runopts.batch = false;
+  runopts.watch_dir.clear();
+  runopts.input_files = {input};
+  const std::filesystem::path outdir = opts.output_dir.empty() ? inpath.parent_path() : std::filesystem::path(opts.output_dir);
+  runopts.output_file = (outdir / (run + ".root")).string();
+  runopts.outfile_stem = (outdir / run).string();
+  runopts.metrics_file = PerRunPath(opts.metrics_file, run);
+  runopts.metrics_prom_file = PerRunPath(opts.metrics_prom_file, run);
+  runopts.digest_file = PerRunPath(opts.digest_file, run);
+  runopts.trace_file = PerRunPath(opts.trace_file, run);
+  runopts.scan_json = PerRunPath(opts.scan_json, run);
+  // The watcher always leaves the metrics of a run next to its output
+  if (!opts.watch_dir.empty() && opts.metrics_file.empty()) {
+    runopts.metrics_file = runopts.outfile_stem + ".metrics.json";
+  }
+  return runopts;
+}
+
+// Convert one run of a batch or of the watcher with its own logger, the console lines are tagged with the run name
+int ConvertRun(const ldf2root::CmdOptions& runopts, const std::string& run, const std::string& logname) {
+  const std::string jobname = logname + ":" + run;
+  int status = 1;
+  try {
+    auto jobconsole = CreateRunLogger(jobname, runopts.outfile_stem, "[%Y-%m-%d %H:%M:%S.%e] [" + run + "] [%n] [%^%l%$] %v");
+    status = runopts.scan ? ldf2root::RunScan(runopts, jobname) : ldf2root::RunConversion(runopts, jobname);
+    jobconsole->flush();
+  } catch (std::exception const& e) {
+    spdlog::get(logname)->error("Run {} failed: {}", run, e.what());
+    status = 1;
+  }
+  spdlog::drop(jobname);
+  return status;
+}
+
+int RunBatch(const ldf2root::CmdOptions& opts, const std::string& logname) {
+  auto console = spdlog::get(logname);
+  auto batch_start_time = std::chrono::high_resolution_clock::now();
+
+  // Every input file is a run of its own with its own output file and logs
+  struct BatchJob {
+    ldf2root::CmdOptions opts;
+    std::string run;
+    uintmax_t size = 0;
+    int status = -1;
+    double seconds = 0.0;
+  };
+  std::vector<BatchJob> jobs;
+  std::set<std::string> outputs;
+  for (const auto& input : opts.input_files) {
+    BatchJob job;
+    const std::filesystem::path inpath(input);
+    job.run = RunName(input);
+    job.opts = MakeRunOptions(opts, input);
+    if (!outputs.insert(job.opts.output_file).second) {
+      console->error("Two runs of the batch would both be written to {}, convert them in separate batches or rename one", job.opts.output_file);
+      return 1;
+    }
+    std::error_code ec;
+    job.size = std::filesystem::file_size(inpath, ec);
+    jobs.push_back(std::move(job));
+  }
+  if (!opts.output_dir.empty()) {
+    std::error_code ec;
+    std::filesystem::create_directories(opts.output_dir, ec);
+  }
+  // Largest runs first, so a big run started last does not leave the other workers idle at the end
+  std::vector<size_t> order(jobs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return jobs[a].size > jobs[b].size; });
+
+  unsigned int nworkers = opts.jobs == 0 ? std::max(1u, std::thread::hardware_concurrency()) : opts.jobs;
+  nworkers = std::min<unsigned int>(nworkers, jobs.size());
+  if (nworkers > 1) {
+    // Every job opens its own files and trees, ROOT has to keep gDirectory and its lists per thread
+    ROOT::EnableThreadSafety();
+  }
+  console->info("Converting {} runs with {} concurrent jobs", jobs.size(), nworkers);
+
+  std::atomic<size_t> next{0};
+  auto worker = [&](unsigned int id) {
+    if (TraceRecorder::Instance().IsEnabled()) {
+      TraceRecorder::Instance().SetThreadName("job " + std::to_string(id));
+    }
+    for (size_t idx = next.fetch_add(1); idx < order.size(); idx = next.fetch_add(1)) {
+      BatchJob& job = jobs[order[idx]];
+      const auto start = std::chrono::high_resolution_clock::now();
+      console->info("Starting run {} ({}/{}) -> {}", job.run, idx + 1, jobs.size(), job.opts.output_file);
+      job.status = ConvertRun(job.opts, job.run, logname);
+      job.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+      console->info("Finished run {} in {:.1f} s{}", job.run, job.seconds, job.status == 0 ? "" : " with errors");
+    }
+  };
+  std::vector<std::thread> workers;
+  for (unsigned int id = 1; id < nworkers; ++id) {
+    workers.emplace_back(worker, id);
+  }
+  worker(0);
+  for (auto& t : workers) {
+    t.join();
+  }
+
+  size_t failed = 0;
+  for (const auto& job : jobs) {
+    if (job.status != 0) {
+      ++failed;
+      console->error("Run {} ({}) failed, see {}.err", job.run, job.opts.input_files.at(0), job.opts.outfile_stem);
+    }
+  }
+  const double batchSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - batch_start_time).count();
+  // The runs share the process, so its peak memory is only meaningful for the batch as a whole
+  console->info("Batch complete, {} of {} runs converted in {:.1f} s, peak RSS {} MB", jobs.size() - failed, jobs.size(), batchSeconds, PipelineMetrics::PeakRSS()/(1024*1024));
+  return failed == 0 ? 0 : 1;
+}
+
+int RunWatch(const ldf2root::CmdOptions& opts, const std::string& logname) {
+  auto console = spdlog::get(logname);
+  if (opts.jobs > 1) {
+    // Every job opens its own files and trees, ROOT has to keep gDirectory and its lists per thread
+    ROOT::EnableThreadSafety();
+  }
+  try {
+    RunWatcher watcher(logname, opts, [&](const std::string& input) {
+      const ldf2root::CmdOptions runopts = MakeRunOptions(opts, input);
+      console->info("Converting {} -> {}", input, runopts.output_file);
+      return ConvertRun(runopts, RunName(input), logname);
+    });
+    return watcher.Run();
+  } catch (std::runtime_error const& e) {
+    console->error(e.what());
+    return 1;
+  }
+}
+
 int main(int argc, char* argv[]) {
-  std::chrono::time_point<std::chrono::high_resolution_clock> global_start_time = std::chrono::high_resolution_clock::now();
 	const std::string logname = "ldf2root";
   // Parse command line arguments
   ldf2root::CmdOptions opts;
   parse_args(argc, argv, opts);
-  std::string outfile_stem = opts.outfile_stem;
 
   // Read config file to get module MSPS mapping
   if( not ReadConfigFile(opts)){
@@ -221,223 +686,86 @@ int main(int argc, char* argv[]) {
     std::cout.setstate(std::ios_base::failbit); // Suppress output
   }
 
-  std::cout << "Input file: " << opts.input_files.at(0) << std::endl;
-  std::cout << "Output file: " << opts.output_file << std::endl;
+  if (!opts.watch_dir.empty()) {
+    std::cout << "Watch directory: " << opts.watch_dir << std::endl;
+    std::cout << "Output directory: " << opts.output_dir << std::endl;
+    std::cout << "State file: " << opts.state_file << std::endl;
+  } else if (opts.batch) {
+    std::cout << "Input files: " << opts.input_files.size() << " runs" << std::endl;
+    std::cout << "Output directory: " << (opts.output_dir.empty() ? "next to the input files" : opts.output_dir) << std::endl;
+  } else {
+    std::cout << "Input file: " << opts.input_files.at(0) << std::endl;
+    if (opts.scan) {
+      std::cout << "Scan summary: " << (opts.scan_json.empty() ? "log only" : opts.scan_json) << std::endl;
+    } else {
+      std::cout << "Output file: " << opts.output_file << std::endl;
+    }
+  }
   std::cout << "Config file: " << opts.config_file << std::endl;
   std::cout << "Tree name: " << opts.tree_name << std::endl;
-
-
-
-  const std::string logfilename = (outfile_stem)+".log";
-	const std::string errfilename = (outfile_stem)+".err";
-	const std::string dbgfilename = (outfile_stem)+".dbg";
+  std::cout << "Output format: " << (opts.output_format == ldf2root::OutputFormat::RNTUPLE ? "rntuple" : "ttree") << std::endl;
 
 	spdlog::set_level(spdlog::level::debug);
-	std::shared_ptr<spdlog::sinks::basic_file_sink_mt> LogFileSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(logfilename,true);
-	LogFileSink->set_level(spdlog::level::info);
-
-	std::shared_ptr<spdlog::sinks::basic_file_sink_mt> ErrorFileSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(errfilename,true);
-	ErrorFileSink->set_level(spdlog::level::err);
-
-	std::shared_ptr<spdlog::sinks::basic_file_sink_mt> DebugFileSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(dbgfilename,true);
-	DebugFileSink->set_level(spdlog::level::debug);
-
-	std::shared_ptr<spdlog::sinks::stdout_color_sink_mt> LogFileConsole = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
-	LogFileConsole->set_level(spdlog::level::info);
-
-	std::vector<spdlog::sink_ptr> sinks {DebugFileSink,LogFileSink,ErrorFileSink,LogFileConsole};
-	auto console = std::make_shared<spdlog::logger>(logname,sinks.begin(),sinks.end());
-	spdlog::initialize_logger(console);
-	console->flush_on(spdlog::level::info);
+	// The sinks are written from a single background thread, the caller only formats and enqueues.
+	// All runs of a batch share the thread pool.
+	spdlog::init_thread_pool(opts.log_queue_size,1);
+	spdlog::flush_every(std::chrono::seconds(5));
+	// Drain the queue on every return path, declared here so it is destroyed after everything that logs
+	struct LogShutdown { ~LogShutdown() { spdlog::shutdown(); } } logshutdown;
+
+  std::shared_ptr<spdlog::logger> console;
+  try {
+    if (opts.batch) {
+      // The batch logger only goes to the console, every run has its own log files
+      auto sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+      sink->set_level(spdlog::level::info);
+      console = std::make_shared<spdlog::async_logger>(logname, sink, spdlog::thread_pool(), spdlog::async_overflow_policy::block);
+      spdlog::initialize_logger(console);
+    } else {
+      console = CreateRunLogger(logname, opts.outfile_stem);
+    }
+  } catch (std::exception const& e) {
+    std::cerr << "Unable to create the log files: " << e.what() << std::endl;
+    return 1;
+  }
 
-  std::unique_ptr<DataParser> dataparser;
-  dataparser.reset(new DataParser(DataParser::DataFileType::LDF_PIXIE, logname, opts));
+  if (!opts.trace_timeline_file.empty()) {
+    TraceRecorder::Instance().Enable();
+    TraceRecorder::Instance().SetThreadName(opts.batch ? "job 0" : "main");
+  }
 
-    // Create output ROOT file and tree
-  TFile* fout = TFile::Open(opts.output_file.c_str(), "RECREATE","",ROOT::RCompressionSetting::EDefaults::kUseAnalysis);
-  if (!fout || fout->IsZombie()) {
-    std::cerr << "Failed to create output ROOT file: " << opts.output_file << std::endl;
-    return 1;
+  if (!opts.watch_dir.empty()) {
+    std::signal(SIGINT, StopWatching);
+    std::signal(SIGTERM, StopWatching);
+    const int status = RunWatch(opts, logname);
+    WriteTraceTimeline(opts.trace_timeline_file, console);
+    return status;
   }
-  TTree* tout = new TTree(opts.tree_name.c_str(), "DDAS Unpacked Data");
 
-  // Prepare DDASHit vector and branch
-  auto rawData = std::make_unique<RawDataVector>();
-  auto unpackedData = std::make_unique<UnpackedHitVector>();
-  DDASRootEvent dEvent;
-  if (opts.legacy) {
-    // Legacy format: TTree name "dchan" with a branch "ddasevent
-    tout->Branch("dchan", &dEvent);
+  if (opts.follow) {
+    std::signal(SIGINT, StopFollowing);
+    console->info("Following {}, press Ctrl-C to stop and close the output file", opts.input_files.back());
+  }
+  int status = 0;
+  if (opts.batch) {
+    status = RunBatch(opts, logname);
+  } else if (opts.scan) {
+    status = ldf2root::RunScan(opts, logname);
   } else {
-    // Modern format: TTree name "ddas" with a branch "rawevents
-    tout->Branch("rawevents", &dEvent);
+    status = ldf2root::RunConversion(opts, logname);
   }
+  WriteTraceTimeline(opts.trace_timeline_file, console);
+  return status;
+}
 
-  // Main processing step
-  // Step 1: specify the input files to the DataParser
-  dataparser->SetInputFiles(opts.input_files);
-  Translator::TRANSLATORSTATE CurrState = Translator::TRANSLATORSTATE::UNKNOWN;
+void WriteTraceTimeline(const std::string& filename, std::shared_ptr<spdlog::logger> console) {
+  if (filename.empty()) {
+    return;
+  }
   try {
-    do{
-      // Step 2: parse the entire LDF file into DDASRootHit objects + store them in rawHits in time order
-      CurrState = dataparser->Parse(rawData.get());
-    } while (CurrState == Translator::TRANSLATORSTATE::PARSING);
-      console->info("Finished parsing all input files, now unpacking hits.");
-      auto unpackTime = UnpackEvents(rawData.get(), unpackedData.get());
-      console->info("Unpacking complete, {} hits unpacked in {} seconds.", unpackedData->size(), unpackTime.count());
-      console->info("Unpacked {} hits from {} input files.", unpackedData->size(), opts.input_files.size());
-
-      console->info("Sorting hits...");
-      auto sortTime = SortEvents(unpackedData.get());
-      console->info("Sorting complete, {} hits sorted in {} seconds.", unpackedData->size(), sortTime.count());
-      fout->cd();
-      auto eventBuildTime = EventBuild(unpackedData.get(), dEvent, opts, tout,logname);
-      console->info("Event building complete, {} hits processed in {} seconds.", unpackedData->size(), eventBuildTime.count());
-      console->info("Event Building complete, parsing next group");
-
-    // console->info("Finished parsing {} hits from {} input files.", rawHits->size(), opts.input_files.size());
-    // Step 3: Repack the DDASRootHit objects into DDASRootEvent objects and write them to the output ROOT file.
-    console->info("Writing output to ROOT file: {}", opts.output_file);
-    tout->Write("",TObject::kOverwrite);
-    fout->Close();
-    console->info("Write Complete!", opts.output_file);
+    TraceRecorder::Instance().Write(filename);
+    console->info("Wrote trace timeline to {}", filename);
   } catch(std::runtime_error const& e) {
     console->error(e.what());
-    return 1;
   }
-
-	auto global_run_time = std::chrono::high_resolution_clock::now() - global_start_time;
-	const auto hrs = std::chrono::duration_cast<std::chrono::hours>(global_run_time);
-	const auto mins = std::chrono::duration_cast<std::chrono::minutes>(global_run_time - hrs);
-	const auto secs = std::chrono::duration_cast<std::chrono::seconds>(global_run_time - hrs - mins);
-	const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(global_run_time - hrs - mins - secs);
-	console->info("Conversion complete in {} hours {} minutes {} seconds {} milliseconds",hrs.count(),mins.count(),secs.count(),ms.count());
-
-  return 0;
 }
-
-chrono_duration EventBuild(UnpackedHitVector* hitList, DDASRootEvent& dEvent,const ldf2root::CmdOptions opts, TTree* tout, const std::string& logname) {
-  // Create a DDASRootEvent object to hold the unpacked data
-  std::chrono::time_point<std::chrono::high_resolution_clock> start_time = std::chrono::high_resolution_clock::now();
-  auto console = spdlog::get(logname)->clone("EventBuilder");
-
-  Double_t lastTime = 0.0;
-  int prog = 10;
-  const size_t numHits = hitList->size();
-  const auto interval = numHits/prog;
-  // Loop through each hit in the hitList
-  switch(opts.build_window_type) {
-    case (ldf2root::WindowType::FLAT):
-      console->info("Building events with flat window type.");
-      // For flat window, we can just fill the TTree with all hits
-      for(size_t i = 0; i < numHits; ++i) {
-        if(i%interval == 0) {
-          console->info("Progress: {}%", prog);
-          prog += 10;
-        }
-        dEvent.Reset();
-        auto currentHit = (*hitList).at(i).release();
-        dEvent.AddChannelData(currentHit);
-        tout->Fill();
-      }
-      break;
-    
-    case (ldf2root::WindowType::ROLLING):
-      // For rolling window, we need to keep track of the last event time
-      lastTime = 0.0;
-      console->info("Building events with rolling window type and build window of {} nanoseconds.", opts.build_window);
-      for(size_t i=0; i < numHits; ++i) {
-        if(i%interval == 0) {
-          console->info("Progress: {}%", prog);
-          prog += 10;
-        }
-        // Access m_time from the base class ddasfmt::DDASHit
-        auto currentHit = (*hitList).at(i).release();
-        lastTime = currentHit->getTime();
-        if (std::fabs(currentHit->getTime() - lastTime) < opts.build_window) {
-          dEvent.AddChannelData(currentHit);
-          lastTime = currentHit->getTime();
-        } else {
-          // Fill the TTree with the current event
-          tout->Fill();
-          dEvent.Reset();
-          dEvent.AddChannelData(currentHit);
-          lastTime = currentHit->getTime();
-        }
-      }
-      tout->Fill(); // Fill the last event
-      break;
-    
-    case (ldf2root::WindowType::FIXED):
-      // For fixed window, we need to keep track of the last event time
-      console->info("Building events with fixed window type and build window of {} nanoseconds.", opts.build_window);
-      lastTime = 0.0;
-            for(size_t i=0; i < numHits; ++i) {
-        if(i%interval == 0) {
-          console->info("Progress: {}%", prog);
-          prog += 10;
-        }
-        // Access m_time from the base class ddasfmt::DDASHit
-        auto currentHit = (*hitList).at(i).release();
-        lastTime = currentHit->getTime();
-        if (std::fabs(currentHit->getTime() - lastTime) < opts.build_window) {
-          dEvent.AddChannelData(currentHit);
-        } else {
-          // Fill the TTree with the current event
-          tout->Fill();
-          dEvent.Reset();
-          dEvent.AddChannelData(currentHit);
-          lastTime = currentHit->getTime();
-        }
-      }
-      tout->Fill(); // Fill the last event
-      break;
-  }
-  
-  // Clean up memory
-  dEvent.Reset();
-  std::chrono::duration<double> elapsed_seconds = std::chrono::high_resolution_clock::now() - start_time;
-  return elapsed_seconds;
-}
-
-chrono_duration UnpackEvents(RawDataVector* rawData, UnpackedHitVector* unpackedData) {
-  std::chrono::time_point<std::chrono::high_resolution_clock> start_time = std::chrono::high_resolution_clock::now();
-  ddasfmt::DDASHitUnpacker unpacker;
-
-  uint32_t totalWords = rawData->size();
-  const uint32_t* dataPtr = rawData->data();
-
-  uint32_t processedWords = 0;
-  
-  while(processedWords<totalWords) {
-    
-    // Read the event length from the raw data
-    uint32_t eventLength = *dataPtr;
-    // Create a new DDASRootHit object for each unpacked hit
-    auto currentHit = std::make_unique<DDASRootHit>();
-    // Unpack the raw data into the current hit
-    unpacker.unpack(dataPtr, dataPtr + eventLength, *currentHit);
-    
-    // Add the unpacked hit to the unpacked data vector
-    unpackedData->push_back(std::move(currentHit));
-    dataPtr += eventLength/2; // Move the pointer to the next event
-    processedWords += eventLength/2;
-  }
-  // Clear the raw data after unpacking
-  rawData->clear();
-  std::chrono::duration<double> elapsed_seconds = std::chrono::high_resolution_clock::now() - start_time;
-  return elapsed_seconds; // Return the time taken to unpack the data
-}
-
-
-chrono_duration SortEvents(UnpackedHitVector* unpackedData) {
-  std::chrono::time_point<std::chrono::high_resolution_clock> start_time = std::chrono::high_resolution_clock::now();
-  // Sort the unpacked data by time
-	if( unpackedData->size() > 0 ){
-		std::sort(unpackedData->begin(),unpackedData->end(),
-			[](const std::unique_ptr<DDASRootHit>& a, const std::unique_ptr<DDASRootHit>& b) {return *a < *b;}
-		);
-  }
-  std::chrono::duration<double> elapsed_seconds = std::chrono::high_resolution_clock::now() - start_time;
-  return elapsed_seconds; // Return the time taken to sort the data
-}
\ No newline at end of file
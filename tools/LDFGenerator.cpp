@@ -0,0 +1,338 @@
+#include "LDFGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "DDASBitMasks.h"
+
+namespace ldfgen {
+
+void LDFWriter::WriteDirBuffer(uint32_t run_num) {
+  std::vector<uint32_t> dir(FILE_BUFFER_SIZE, 0);
+  dir[0] = HRIBF_TYPES::DIR;
+  dir[1] = DATA_BUFFER_SIZE;
+  dir[2] = FILE_BUFFER_SIZE;
+  dir[3] = 0; // total buffers, patched in Finalize()
+  dir[4] = 0;
+  dir[5] = 1;
+  dir[6] = run_num;
+  dir[7] = 2;
+  WriteRaw(dir);
+}
+
+void LDFWriter::WriteHeadBuffer(uint32_t run_num, const std::string& title) {
+  std::vector<uint32_t> head(FILE_BUFFER_SIZE, 0);
+  head[0] = HRIBF_TYPES::HEAD;
+  head[1] = 64;
+  char* text = reinterpret_cast<char*>(&head[2]);
+  auto put = [&text](const std::string& s, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+      text[i] = i < s.size() ? s[i] : ' ';
+    }
+    text += len;
+  };
+  put("U OF TN", 8);
+  put("LIST DATA", 8);
+  put("DISK", 16);
+  put("SYNTHETIC", 16);
+  put(title, 80);
+  head[2 + (8 + 8 + 16 + 16 + 80)/4] = run_num;
+  WriteRaw(head);
+}
+
+void LDFWriter::WriteSpill(const std::vector<uint32_t>& payload, Corruption corruption) {
+  // The chunk sizes depend on where in the buffer the spill starts, plan them before writing the headers
+  std::vector<uint32_t> chunks;
+  size_t pos = Pos == 0 ? 2 : Pos;
+  size_t remaining = payload.size();
+  while (remaining > 0) {
+    size_t space = FILE_BUFFER_SIZE - pos;
+    if (space < CHUNK_HEADER_SIZE + 4) {
+      pos = 2;
+      space = FILE_BUFFER_SIZE - pos;
+    }
+    const size_t n = std::min({remaining, space - CHUNK_HEADER_SIZE, static_cast<size_t>(MAX_CHUNK_PAYLOAD)});
+    chunks.push_back(n);
+    remaining -= n;
+    pos += CHUNK_HEADER_SIZE + n;
+  }
+  const uint32_t totalChunks = chunks.size() + 1;
+  const uint32_t dropChunk = (corruption == DROP_CHUNK && chunks.size() > 1) ? 1 : totalChunks;
+
+  size_t offset = 0;
+  for (uint32_t ii = 0; ii < chunks.size(); ++ii) {
+    if (ii != dropChunk) {
+      WriteChunk(totalChunks, ii, &payload[offset], chunks[ii]);
+    }
+    if (corruption == BAD_BUFFER && ii == 0) {
+      WriteUnknownBuffer();
+    }
+    offset += chunks[ii];
+  }
+  // Spill footer, marks the end of the readout
+  const uint32_t footer[2] = {2, END_OF_READOUT_VSN};
+  WriteChunk(totalChunks, totalChunks - 1, footer, 2, corruption == BAD_FOOTER ? 4 : 0);
+}
+
+void LDFWriter::WriteEOF() {
+  FlushBuffer();
+  for (int ii = 0; ii < 2; ++ii) {
+    std::vector<uint32_t> eof(FILE_BUFFER_SIZE, ENDBUFF);
+    eof[0] = HRIBF_TYPES::ENDFILE;
+    eof[1] = DATA_BUFFER_SIZE;
+    WriteRaw(eof);
+  }
+}
+
+void LDFWriter::Finalize() {
+  Output.seekp(3*sizeof(uint32_t), std::ios::beg);
+  const uint32_t total = BuffersWritten;
+  Output.write(reinterpret_cast<const char*>(&total), sizeof(uint32_t));
+  Output.seekp(0, std::ios::end);
+}
+
+void LDFWriter::WriteChunk(uint32_t totalChunks, uint32_t chunkNum, const uint32_t* data, size_t n, uint32_t extraBytes) {
+  if (Pos == 0 || FILE_BUFFER_SIZE - Pos < CHUNK_HEADER_SIZE + std::max<size_t>(n, 4)) {
+    FlushBuffer();
+    StartDataBuffer();
+  }
+  Buffer[Pos++] = (CHUNK_HEADER_SIZE + n)*sizeof(uint32_t) + extraBytes;
+  Buffer[Pos++] = totalChunks;
+  Buffer[Pos++] = chunkNum;
+  std::copy(data, data + n, Buffer.begin() + Pos);
+  Pos += n;
+}
+
+void LDFWriter::WriteUnknownBuffer() {
+  FlushBuffer();
+  std::vector<uint32_t> junk(FILE_BUFFER_SIZE, 0xDEADBEEF);
+  junk[1] = DATA_BUFFER_SIZE;
+  WriteRaw(junk);
+}
+
+void LDFWriter::StartDataBuffer() {
+  std::fill(Buffer.begin(), Buffer.end(), ENDBUFF);
+  Buffer[0] = HRIBF_TYPES::DATA;
+  Buffer[1] = DATA_BUFFER_SIZE;
+  Pos = 2;
+}
+
+void LDFWriter::FlushBuffer() {
+  if (Pos > 0) {
+    WriteRaw(Buffer);
+    Pos = 0;
+  }
+}
+
+void LDFWriter::WriteRaw(const std::vector<uint32_t>& buffer) {
+  Output.write(reinterpret_cast<const char*>(buffer.data()), buffer.size()*sizeof(uint32_t));
+  ++BuffersWritten;
+  BytesWritten += buffer.size()*sizeof(uint32_t);
+}
+
+void EncodeTime(unsigned int msps, double time, uint64_t& ticks, uint32_t& cfdWord) {
+  using namespace ddasfmt;
+  if (msps == 250) {
+    ticks = static_cast<uint64_t>(time/8.0);
+    double r = time - ticks*8.0;
+    uint32_t trigSource = 0;
+    if (r >= 4.0) {
+      // Correction is negative with the trigger source bit set
+      ++ticks;
+      trigSource = 1;
+      r -= 4.0;
+    }
+    const uint32_t cfd = std::min<uint32_t>(static_cast<uint32_t>(r/4.0*16384.0), 16383);
+    cfdWord = ((cfd << 16) & BIT_29_TO_16_MASK) | (trigSource << 30);
+  } else if (msps == 500) {
+    ticks = static_cast<uint64_t>(time/10.0);
+    const double r = (time - ticks*10.0)/2.0;
+    const uint32_t trigSource = static_cast<uint32_t>(r) + 1;
+    const uint32_t cfd = std::min<uint32_t>(static_cast<uint32_t>((r - std::floor(r))*8192.0), 8191);
+    cfdWord = ((cfd << 16) & BIT_28_TO_16_MASK) | (trigSource << 29);
+  } else {
+    ticks = static_cast<uint64_t>(time/10.0);
+    const double r = time - ticks*10.0;
+    const uint32_t cfd = std::min<uint32_t>(static_cast<uint32_t>(r/10.0*32768.0), 32767);
+    cfdWord = (cfd << 16) & BIT_30_TO_16_MASK;
+  }
+}
+
+void EncodeHit(const GenOptions& opts, const ModuleInfo& mod, const GenHit& hit, std::mt19937_64& rng, std::vector<uint32_t>& out) {
+  using namespace ddasfmt;
+  const uint32_t headerLength = SIZE_OF_RAW_EVENT + (opts.energy_sums ? SIZE_OF_ENE_SUMS : 0) + (opts.qdc_sums ? SIZE_OF_QDC_SUMS : 0) + (opts.ext_ts ? SIZE_OF_EXT_TS : 0);
+  const uint32_t channelLength = headerLength + opts.trace_length/2;
+  const uint32_t maxADC = (1u << mod.resolution) - 1;
+
+  // Mostly a few lines on a flat background
+  static const double lines[] = {511.0, 662.0, 1173.2, 1332.5, 2614.5};
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  double e;
+  if (unit(rng) < 0.7) {
+    std::normal_distribution<double> peak(lines[rng() % 5]*4.0, 8.0);
+    e = peak(rng);
+  } else {
+    e = unit(rng)*12000.0;
+  }
+  const uint32_t energy = std::clamp<uint32_t>(static_cast<uint32_t>(std::max(e, 1.0)), 1, std::min<uint32_t>(maxADC, 0xFFFF));
+
+  uint64_t ticks;
+  uint32_t cfdWord;
+  EncodeTime(mod.msps, hit.time, ticks, cfdWord);
+
+  out.push_back((hit.channel & CHANNEL_ID_MASK) | ((mod.slot << SLOT_ID_SHIFT) & SLOT_ID_MASK) | ((mod.crate << CRATE_ID_SHIFT) & CRATE_ID_MASK) |
+                ((headerLength << HEADER_LENGTH_SHIFT) & HEADER_LENGTH_MASK) | ((channelLength << CHANNEL_LENGTH_SHIFT) & CHANNEL_LENGTH_MASK));
+  out.push_back(static_cast<uint32_t>(ticks & 0xFFFFFFFF));
+  out.push_back(static_cast<uint32_t>((ticks >> 32) & LOWER_16_BIT_MASK) | cfdWord);
+  out.push_back(energy | ((opts.trace_length << 16) & BIT_30_TO_16_MASK));
+  if (opts.energy_sums) {
+    const float baseline = 400.0f + static_cast<float>(unit(rng));
+    uint32_t baselineBits;
+    std::memcpy(&baselineBits, &baseline, sizeof(uint32_t));
+    out.push_back(energy*4); // trailing sum
+    out.push_back(energy*6); // leading sum
+    out.push_back(energy*2); // gap sum
+    out.push_back(baselineBits);
+  }
+  if (opts.qdc_sums) {
+    for (int ii = 0; ii < 8; ++ii) {
+      out.push_back(static_cast<uint32_t>(energy*(ii + 1)*(0.5 + unit(rng))));
+    }
+  }
+  if (opts.ext_ts) {
+    const uint64_t ext = static_cast<uint64_t>(hit.time/10.0);
+    out.push_back(static_cast<uint32_t>(ext & 0xFFFFFFFF));
+    out.push_back(static_cast<uint32_t>((ext >> 32) & LOWER_16_BIT_MASK));
+  }
+  if (opts.trace_length > 0) {
+    // Baseline with noise and an exponential pulse a quarter of the way in
+    const double amplitude = std::min(static_cast<double>(energy)*0.5, static_cast<double>(maxADC) - 500.0);
+    const unsigned int t0 = opts.trace_length/4;
+    std::normal_distribution<double> noise(0.0, 2.0);
+    uint16_t prev = 0;
+    for (unsigned int ii = 0; ii < opts.trace_length; ++ii) {
+      double s = 400.0 + noise(rng);
+      if (ii >= t0) {
+        const double dt = ii - t0;
+        s += amplitude*(1.0 - std::exp(-dt/2.0))*std::exp(-dt/40.0);
+      }
+      const uint16_t sample = static_cast<uint16_t>(std::clamp(s, 0.0, static_cast<double>(maxADC)));
+      if (ii % 2 == 0) {
+        prev = sample;
+      } else {
+        out.push_back(prev | (static_cast<uint32_t>(sample) << 16));
+      }
+    }
+  }
+}
+
+std::vector<ModuleInfo> MakeModules(const GenOptions& opts) {
+  std::vector<ModuleInfo> modules;
+  for (unsigned int ii = 0; ii < opts.modules; ++ii) {
+    const unsigned int msps = opts.msps.at(ii % opts.msps.size());
+    modules.push_back({opts.crate, ii + 2, msps, (msps == 250 ? 16u : 14u)});
+  }
+  return modules;
+}
+
+std::string ConfigFilePath(const GenOptions& opts) {
+  if (!opts.config_out.empty()) {
+    return opts.config_out;
+  }
+  size_t lastdot = opts.output_file.find_last_of('.');
+  return (lastdot != std::string::npos ? opts.output_file.substr(0, lastdot) : opts.output_file) + "_config.txt";
+}
+
+GenStats GenerateFile(const GenOptions& opts) {
+  const std::vector<ModuleInfo> modules = MakeModules(opts);
+  const std::string config_out = ConfigFilePath(opts);
+
+  // Crate configuration for ldf2root, same format as --generate-config
+  std::ofstream cfg(config_out);
+  if (!cfg) {
+    throw std::runtime_error("Failed to create " + config_out);
+  }
+  cfg << "# Generated by ldfgen for " << opts.output_file << "\n";
+  cfg << "# Format: sourceID(0) slotID(starts at 2) MSPS(100/250/500) ADC_resolution(12/14/16 bits) Hardware_revision(Rev F is current)\n";
+  for (const auto& mod : modules) {
+    cfg << mod.crate << " " << mod.slot << " " << mod.msps << " " << mod.resolution << " f\n";
+  }
+  cfg.close();
+
+  std::ofstream ofs(opts.output_file, std::ios::binary);
+  if (!ofs) {
+    throw std::runtime_error("Failed to create " + opts.output_file);
+  }
+  LDFWriter writer(ofs);
+  writer.WriteDirBuffer(opts.run_num);
+  writer.WriteHeadBuffer(opts.run_num, "ldfgen synthetic run seed " + std::to_string(opts.seed));
+
+  std::mt19937_64 rng(opts.seed);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  std::poisson_distribution<uint64_t> nhits(opts.rate*opts.spill_duration);
+
+  const double spillLength = opts.spill_duration*1.0e9; // ns
+  double spillStart = 1.0e9;
+  std::vector<GenHit> late;
+  std::vector<GenHit> hits;
+  std::vector<std::vector<uint32_t>> moduleWords(modules.size());
+  std::vector<uint32_t> payload;
+  GenStats stats;
+
+  while (opts.max_size_mb > 0.0 ? writer.GetBytesWritten() < opts.max_size_mb*1024*1024 : stats.spills < opts.spills) {
+    hits.clear();
+    const uint64_t n = nhits(rng);
+    for (uint64_t ii = 0; ii < n; ++ii) {
+      hits.push_back({spillStart + unit(rng)*spillLength, static_cast<unsigned int>(rng() % modules.size()), static_cast<unsigned int>(rng() % 16)});
+    }
+    std::sort(hits.begin(), hits.end(), [](const GenHit& a, const GenHit& b) { return a.time < b.time; });
+
+    // Hits held back from the previous spill come first in their module, ahead of newer hits
+    for (auto& words : moduleWords) {
+      words.clear();
+    }
+    for (const auto& hit : late) {
+      EncodeHit(opts, modules[hit.module], hit, rng, moduleWords[hit.module]);
+    }
+    late.clear();
+    for (const auto& hit : hits) {
+      if (opts.out_of_order > 0.0 && unit(rng) < opts.out_of_order) {
+        late.push_back(hit);
+        ++stats.late_hits;
+        continue;
+      }
+      EncodeHit(opts, modules[hit.module], hit, rng, moduleWords[hit.module]);
+    }
+    stats.hits += n;
+
+    payload.clear();
+    for (size_t ii = 0; ii < modules.size(); ++ii) {
+      payload.push_back(moduleWords[ii].size() + 2);
+      payload.push_back(ii);
+      payload.insert(payload.end(), moduleWords[ii].begin(), moduleWords[ii].end());
+    }
+
+    Corruption corruption = Corruption::NONE;
+    if (opts.corrupt > 0.0 && unit(rng) < opts.corrupt) {
+      corruption = static_cast<Corruption>(1 + rng() % 3);
+      ++stats.corrupt_spills;
+    }
+    writer.WriteSpill(payload, corruption);
+
+    spillStart += spillLength;
+    ++stats.spills;
+  }
+  // Whatever was held back from the last spill never makes it into the file
+  stats.hits -= late.size();
+  stats.late_hits -= late.size();
+  writer.WriteEOF();
+  writer.Finalize();
+  ofs.close();
+  stats.buffers = writer.GetBuffersWritten();
+  stats.bytes = writer.GetBytesWritten();
+  return stats;
+}
+
+} // namespace ldfgen
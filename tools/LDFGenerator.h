@@ -0,0 +1,121 @@
+#ifndef __LDF_GENERATOR_HPP__
+#define __LDF_GENERATOR_HPP__
+
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace ldfgen {
+
+enum HRIBF_TYPES : uint32_t {
+  HEAD = 1145128264,
+  DATA = 1096040772,
+  DIR = 542263620,
+  ENDFILE = 541478725,
+  ENDBUFF = 0xFFFFFFFF
+};
+
+const uint32_t FILE_BUFFER_SIZE = 8194; // words per buffer, including the 2 word buffer header
+const uint32_t DATA_BUFFER_SIZE = 8192;
+const uint32_t CHUNK_HEADER_SIZE = 3; // size in bytes, total chunks, chunk number
+const uint32_t MAX_CHUNK_PAYLOAD = 8187; // what the Pixie readout uses
+const uint32_t END_OF_READOUT_VSN = 9999;
+
+struct GenOptions {
+  std::string output_file;
+  std::string config_out; // empty uses <output>_config.txt
+  uint64_t spills = 100;
+  double max_size_mb = 0.0; // stop once the file reaches this size, 0 uses spills
+  double rate = 1.0e5; // hits per second, all modules together
+  double spill_duration = 0.1; // seconds
+  unsigned int crate = 0;
+  std::vector<unsigned int> msps = {250}; // cycled over the modules
+  unsigned int modules = 4;
+  unsigned int trace_length = 0; // samples
+  bool energy_sums = false;
+  bool qdc_sums = false;
+  bool ext_ts = false;
+  double out_of_order = 0.0; // fraction of hits delivered one spill late
+  double corrupt = 0.0; // fraction of corrupted spills
+  uint64_t seed = 1;
+  uint32_t run_num = 1;
+};
+
+struct ModuleInfo {
+  unsigned int crate;
+  unsigned int slot;
+  unsigned int msps;
+  unsigned int resolution;
+};
+
+struct GenHit {
+  double time; // ns
+  unsigned int module;
+  unsigned int channel;
+};
+
+struct GenStats {
+  uint64_t spills = 0;
+  uint64_t hits = 0;
+  uint64_t late_hits = 0;
+  uint64_t corrupt_spills = 0;
+  uint64_t buffers = 0;
+  uint64_t bytes = 0;
+};
+
+enum Corruption {
+  NONE,
+  DROP_CHUNK, // a chunk in the middle of the spill is missing
+  BAD_FOOTER, // the spill footer has the wrong size
+  BAD_BUFFER // an unknown buffer type shows up between two chunks
+};
+
+/// Writes the buffer structure of an LDF file, the spill payload is split into chunks that never cross a buffer
+class LDFWriter {
+  public:
+    explicit LDFWriter(std::ofstream& ofs) : Output(ofs), Buffer(FILE_BUFFER_SIZE, ENDBUFF), Pos(0), BuffersWritten(0), BytesWritten(0) {}
+
+    void WriteDirBuffer(uint32_t run_num);
+    void WriteHeadBuffer(uint32_t run_num, const std::string& title);
+    void WriteSpill(const std::vector<uint32_t>& payload, Corruption corruption);
+    void WriteEOF();
+    /// Patch the total number of buffers into the DIR buffer
+    void Finalize();
+
+    uint64_t GetBytesWritten() const { return BytesWritten + (Pos > 0 ? FILE_BUFFER_SIZE*sizeof(uint32_t) : 0); }
+    uint64_t GetBuffersWritten() const { return BuffersWritten; }
+
+  private:
+    void WriteChunk(uint32_t totalChunks, uint32_t chunkNum, const uint32_t* data, size_t n, uint32_t extraBytes = 0);
+    void WriteUnknownBuffer();
+    void StartDataBuffer();
+    void FlushBuffer();
+    void WriteRaw(const std::vector<uint32_t>& buffer);
+
+    std::ofstream& Output;
+    std::vector<uint32_t> Buffer;
+    size_t Pos; // 0 while no DATA buffer is open
+    uint64_t BuffersWritten;
+    uint64_t BytesWritten;
+};
+
+/// Clock ticks and the CFD word for a time in ns, inverse of DDASHitUnpacker::parseHeaderWords1And2()
+void EncodeTime(unsigned int msps, double time, uint64_t& ticks, uint32_t& cfdWord);
+
+/// Append the Pixie list mode words of one hit
+void EncodeHit(const GenOptions& opts, const ModuleInfo& mod, const GenHit& hit, std::mt19937_64& rng, std::vector<uint32_t>& out);
+
+/// Module list of the options, slots start at 2 and the MSPS list is cycled over the modules
+std::vector<ModuleInfo> MakeModules(const GenOptions& opts);
+
+/// Path of the ldf2root configuration file written next to the output
+std::string ConfigFilePath(const GenOptions& opts);
+
+/// Write the LDF file and its ldf2root configuration file, throws std::runtime_error if either can not be created
+GenStats GenerateFile(const GenOptions& opts);
+
+} // namespace ldfgen
+
+#endif
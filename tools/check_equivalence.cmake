@@ -0,0 +1,36 @@
+#Generates a run with ldfgen and checks with ldf2root_compare that two sets of ldf2root options build
+#the same events. Run with cmake -P, the variables are passed with -D:
+#  LDFGEN, COMPARE   the ldfgen and ldf2root_compare executables
+#  WORKDIR           scratch directory of this check, removed first
+#  SIZE_MB           size of the generated run (default 8)
+#  ARGS_A, ARGS_B    ldf2root options of the two conversions
+foreach(var LDFGEN COMPARE WORKDIR)
+	if(NOT DEFINED ${var})
+		message(FATAL_ERROR "check_equivalence.cmake needs -D${var}=...")
+	endif()
+endforeach()
+if(NOT DEFINED SIZE_MB)
+	set(SIZE_MB 8)
+endif()
+
+file(REMOVE_RECURSE ${WORKDIR})
+file(MAKE_DIRECTORY ${WORKDIR})
+set(LDF ${WORKDIR}/run.ldf)
+set(CONFIG ${WORKDIR}/run_config.txt)
+
+#Every module type, energy sums, short traces and late hits, so the unpacking and the ordering are both exercised
+execute_process(
+	COMMAND ${LDFGEN} -o ${LDF} --config-out ${CONFIG} --size ${SIZE_MB} --modules 6 --msps 100,250,500
+		--energy-sums --trace-length 32 --out-of-order 0.01 --seed 7
+	RESULT_VARIABLE gen_result)
+if(NOT gen_result EQUAL 0)
+	message(FATAL_ERROR "ldfgen failed (${gen_result})")
+endif()
+
+execute_process(
+	COMMAND ${COMPARE} -i ${LDF} -c ${CONFIG} --a "${ARGS_A}" --b "${ARGS_B}" --scratch ${WORKDIR}/compare
+	RESULT_VARIABLE compare_result)
+if(NOT compare_result EQUAL 0)
+	message(FATAL_ERROR "\"${ARGS_A}\" and \"${ARGS_B}\" built different events (${compare_result}), the outputs are in ${WORKDIR}/compare")
+endif()
+file(REMOVE_RECURSE ${WORKDIR})
@@ -0,0 +1,346 @@
+/**
+  *@file ldf2root_compare.cpp
+  *@brief Checks that two ldf2root configurations produce the same events
+  *@details
+  * Converts an LDF file twice, with the ldf2root options given by --a and --b, and streams the
+  * two event digests (ldf2root --digest) against each other event by event and hit by hit.
+  * Only the digests are read, never the ROOT files, so memory use does not depend on the size
+  * of the run. The first divergence is reported with the matching events before it, the hits of
+  * the divergent event from both sides with the differing fields marked, and the events after it.
+  * Two existing digest files can be compared directly with --digest-a and --digest-b.
+  *@param input_files Path to the LDF file(s) to convert
+  *@param config_file Path to the crate configuration file
+  *@return 0 if the digests match, 1 if they diverge, 2 on errors
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef LDF2ROOT_EXECUTABLE
+#define LDF2ROOT_EXECUTABLE "ldf2root"
+#endif
+
+namespace ldfcompare {
+
+struct CompareOptions {
+  std::string ldf2root = LDF2ROOT_EXECUTABLE;
+  std::vector<std::string> input_files;
+  std::string config_file;
+  std::string args_a;
+  std::string args_b;
+  std::string digest_a;
+  std::string digest_b;
+  std::filesystem::path scratch = std::filesystem::temp_directory_path() / "ldf2root_compare";
+  unsigned int context = 3; // events shown before and after the divergence
+  bool keep = false;
+};
+
+/// Names of the columns of a hit line, see EventDigest
+const std::vector<std::string> HIT_FIELDS = {"H", "crate", "slot", "channel", "time", "energy", "trace", "hit hash"};
+
+struct EventBlock {
+  std::string line; // E <event> <hits> <hash>
+  uint64_t lineNumber = 0;
+  std::string hash;
+  std::vector<std::string> hits;
+};
+
+std::vector<std::string> Split(const std::string& line) {
+  std::vector<std::string> fields;
+  std::istringstream iss(line);
+  std::string field;
+  while (iss >> field) {
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+/// Reads a digest one event at a time
+class DigestReader {
+  public:
+    explicit DigestReader(const std::string& filename) : FileName(filename), Input(filename), LineNumber(0) {
+      if (!Input.is_open()) {
+        throw std::runtime_error("Unable to open digest " + filename);
+      }
+      ReadLine();
+    }
+
+    bool Next(EventBlock& block) {
+      while (HasLine && (Line.empty() || Line[0] == '#')) {
+        ReadLine();
+      }
+      if (!HasLine || Line[0] != 'E') {
+        if (HasLine && Line[0] == 'T') {
+          Trailer = Line;
+        } else if (HasLine) {
+          throw std::runtime_error(FileName + ":" + std::to_string(LineNumber) + " unexpected line \"" + Line + "\"");
+        }
+        return false;
+      }
+      block.line = Line;
+      block.lineNumber = LineNumber;
+      const auto fields = Split(Line);
+      block.hash = fields.size() > 3 ? fields[3] : "";
+      block.hits.clear();
+      ReadLine();
+      while (HasLine && !Line.empty() && Line[0] == 'H') {
+        block.hits.push_back(Line);
+        ReadLine();
+      }
+      return true;
+    }
+
+    const std::string& GetTrailer() const { return Trailer; }
+    const std::string& GetFileName() const { return FileName; }
+
+  private:
+    void ReadLine() {
+      HasLine = static_cast<bool>(std::getline(Input, Line));
+      if (HasLine) {
+        ++LineNumber;
+      }
+    }
+
+    std::string FileName;
+    std::ifstream Input;
+    std::string Line;
+    bool HasLine = false;
+    uint64_t LineNumber;
+    std::string Trailer;
+};
+
+/// The hit lines of both sides with the fields that differ named
+void PrintHitDiff(const EventBlock& a, const EventBlock& b, std::ostream& os) {
+  const size_t n = std::max(a.hits.size(), b.hits.size());
+  for (size_t ii = 0; ii < n; ++ii) {
+    if (ii >= a.hits.size()) {
+      os << "  + B " << b.hits[ii] << "   (only in B)\n";
+      continue;
+    }
+    if (ii >= b.hits.size()) {
+      os << "  - A " << a.hits[ii] << "   (only in A)\n";
+      continue;
+    }
+    if (a.hits[ii] == b.hits[ii]) {
+      os << "    = " << a.hits[ii] << "\n";
+      continue;
+    }
+    const auto fa = Split(a.hits[ii]);
+    const auto fb = Split(b.hits[ii]);
+    std::string differs;
+    for (size_t jj = 1; jj < std::max(fa.size(), fb.size()); ++jj) {
+      if (jj >= fa.size() || jj >= fb.size() || fa[jj] != fb[jj]) {
+        // A different hash with every shown field equal means one of the fields that are not shown differs
+        const std::string name = jj < HIT_FIELDS.size() ? HIT_FIELDS[jj] : "field " + std::to_string(jj);
+        differs += (differs.empty() ? "" : ", ") + name;
+      }
+    }
+    os << "  ! A " << a.hits[ii] << "\n";
+    os << "  ! B " << b.hits[ii] << "   (differs in " << differs << ")\n";
+  }
+}
+
+/// Stream both digests, returns true if they match
+bool Compare(DigestReader& a, DigestReader& b, unsigned int context, std::ostream& os) {
+  std::deque<std::string> previous;
+  EventBlock ea, eb;
+  uint64_t events = 0, hits = 0;
+  while (true) {
+    const bool hasA = a.Next(ea);
+    const bool hasB = b.Next(eb);
+    if (!hasA && !hasB) {
+      break;
+    }
+    if (hasA && hasB && ea.line == eb.line && ea.hits == eb.hits) {
+      ++events;
+      hits += ea.hits.size();
+      if (context > 0) {
+        previous.push_back(ea.line);
+        if (previous.size() > context) {
+          previous.pop_front();
+        }
+      }
+      continue;
+    }
+
+    os << "First divergence after " << events << " matching events (" << hits << " hits)\n";
+    if (!previous.empty()) {
+      os << "Preceding matching events:\n";
+      for (const auto& line : previous) {
+        os << "    = " << line << "\n";
+      }
+    }
+    if (!hasA || !hasB) {
+      const auto& longer = hasA ? ea : eb;
+      os << "Digest " << (hasA ? "B" : "A") << " ends here, " << (hasA ? "A" : "B") << " continues with\n";
+      os << "    " << longer.line << "\n";
+      for (const auto& hit : longer.hits) {
+        os << "      " << hit << "\n";
+      }
+      return false;
+    }
+    os << "A: " << ea.line << "   (" << a.GetFileName() << ":" << ea.lineNumber << ")\n";
+    os << "B: " << eb.line << "   (" << b.GetFileName() << ":" << eb.lineNumber << ")\n";
+    PrintHitDiff(ea, eb, os);
+    if (context > 0) {
+      os << "Following events:\n";
+      for (unsigned int ii = 0; ii < context; ++ii) {
+        const bool nextA = a.Next(ea);
+        const bool nextB = b.Next(eb);
+        if (!nextA && !nextB) {
+          break;
+        }
+        os << "  A " << (nextA ? ea.line : "<end>") << "\n";
+        os << "  B " << (nextB ? eb.line : "<end>") << "\n";
+      }
+    }
+    return false;
+  }
+
+  if (a.GetTrailer().empty() || b.GetTrailer().empty()) {
+    os << "Warning: digest " << (a.GetTrailer().empty() ? "A" : "B") << " has no trailer, its conversion did not finish\n";
+  } else if (a.GetTrailer() != b.GetTrailer()) {
+    os << "Trailers differ although every event matched\n  A " << a.GetTrailer() << "\n  B " << b.GetTrailer() << "\n";
+    return false;
+  }
+  os << "Digests match: " << events << " events, " << hits << " hits";
+  if (!a.GetTrailer().empty()) {
+    const auto fields = Split(a.GetTrailer());
+    os << ", run hash " << (fields.size() > 3 ? fields[3] : "?");
+  }
+  os << "\n";
+  return true;
+}
+
+/// Run one conversion with its own output, digest and log files in the scratch directory
+std::string Convert(const CompareOptions& opts, const std::string& tag, const std::string& args) {
+  const std::filesystem::path stem = opts.scratch / tag;
+  const std::string digest = stem.string() + ".digest";
+  std::string cmd = "\"" + opts.ldf2root + "\"";
+  for (const auto& input : opts.input_files) {
+    cmd += " -i \"" + input + "\"";
+  }
+  cmd += " -c \"" + opts.config_file + "\" -o \"" + stem.string() + ".root\" --digest \"" + digest + "\" " + args;
+  cmd += " > \"" + stem.string() + ".out\" 2>&1";
+
+  std::cout << tag << ": " << cmd << std::endl;
+  const auto start = std::chrono::steady_clock::now();
+  const int rc = std::system(cmd.c_str());
+  const double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (rc != 0) {
+    throw std::runtime_error("Conversion " + tag + " failed with status " + std::to_string(rc) + ", see " + stem.string() + ".out");
+  }
+  std::cout << tag << ": converted in " << t << " s" << std::endl;
+  return digest;
+}
+
+void Cleanup(const CompareOptions& opts) {
+  for (const char* tag : {"a", "b"}) {
+    for (const char* ext : {".root", ".digest", ".out", ".log", ".err", ".dbg"}) {
+      std::error_code ec;
+      std::filesystem::remove(opts.scratch / (std::string(tag) + ext), ec);
+    }
+  }
+}
+
+} // namespace ldfcompare
+
+void PrintUsageString(std::ostream& os = std::cout) {
+  os << "Usage: ldf2root_compare -i <file.ldf> -c <config> --a \"<options>\" --b \"<options>\" [options]\n";
+  os << "       ldf2root_compare --digest-a <file> --digest-b <file> [options]\n";
+  os << "Options:\n";
+  os << "  --help, -h              Show this help message\n";
+  os << "  --input, -i <file>      LDF file to convert, may be given more than once\n";
+  os << "  --config, -c <file>     Crate configuration file\n";
+  os << "  --a <options>           ldf2root options of the first conversion, e.g. the reference path\n";
+  os << "  --b <options>           ldf2root options of the second conversion, e.g. the optimised path\n";
+  os << "  --digest-a <file>       Compare this existing digest instead of converting\n";
+  os << "  --digest-b <file>       Compare this existing digest instead of converting\n";
+  os << "  --context <n>           Matching events shown before and events shown after the divergence (default: 3)\n";
+  os << "  --ldf2root <path>       ldf2root executable (default: the one built alongside)\n";
+  os << "  --scratch <dir>         Directory for the outputs and digests of the conversions (default: <tmp>/ldf2root_compare)\n";
+  os << "  --keep                  Keep the outputs and digests of the conversions\n";
+}
+
+void parse_args(int argc, char* argv[], ldfcompare::CompareOptions& opts) {
+  if (argc < 2) {
+    PrintUsageString(std::cerr);
+    exit(2);
+  }
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") {
+      PrintUsageString();
+      exit(0);
+    } else if ((arg == "--input" || arg == "-i") && i + 1 < argc) {
+      opts.input_files.push_back(argv[++i]);
+    } else if ((arg == "--config" || arg == "-c") && i + 1 < argc) {
+      opts.config_file = argv[++i];
+    } else if (arg == "--a" && i + 1 < argc) {
+      opts.args_a = argv[++i];
+    } else if (arg == "--b" && i + 1 < argc) {
+      opts.args_b = argv[++i];
+    } else if (arg == "--digest-a" && i + 1 < argc) {
+      opts.digest_a = argv[++i];
+    } else if (arg == "--digest-b" && i + 1 < argc) {
+      opts.digest_b = argv[++i];
+    } else if (arg == "--context" && i + 1 < argc) {
+      opts.context = std::stoul(argv[++i]);
+    } else if (arg == "--ldf2root" && i + 1 < argc) {
+      opts.ldf2root = argv[++i];
+    } else if (arg == "--scratch" && i + 1 < argc) {
+      opts.scratch = argv[++i];
+    } else if (arg == "--keep") {
+      opts.keep = true;
+    } else {
+      std::cerr << "Unknown option: " << arg << std::endl << std::endl;
+      PrintUsageString(std::cerr);
+      exit(2);
+    }
+  }
+  const bool convert = opts.digest_a.empty() || opts.digest_b.empty();
+  if (convert && (opts.input_files.empty() || opts.config_file.empty())) {
+    std::cerr << "Either an input and config file or two digests (--digest-a and --digest-b) are needed." << std::endl;
+    PrintUsageString(std::cerr);
+    exit(2);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  ldfcompare::CompareOptions opts;
+  parse_args(argc, argv, opts);
+
+  try {
+    const bool convert = opts.digest_a.empty() || opts.digest_b.empty();
+    if (convert) {
+      std::filesystem::create_directories(opts.scratch);
+      if (opts.digest_a.empty()) {
+        opts.digest_a = ldfcompare::Convert(opts, "a", opts.args_a);
+      }
+      if (opts.digest_b.empty()) {
+        opts.digest_b = ldfcompare::Convert(opts, "b", opts.args_b);
+      }
+    }
+    ldfcompare::DigestReader a(opts.digest_a);
+    ldfcompare::DigestReader b(opts.digest_b);
+    const bool same = ldfcompare::Compare(a, b, opts.context, std::cout);
+    if (convert && !opts.keep && same) {
+      ldfcompare::Cleanup(opts);
+    } else if (convert) {
+      std::cout << "Conversion outputs kept in " << opts.scratch << std::endl;
+    }
+    return same ? 0 : 1;
+  } catch (std::exception const& e) {
+    std::cerr << e.what() << std::endl;
+    return 2;
+  }
+}
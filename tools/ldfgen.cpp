@@ -0,0 +1,155 @@
+/**
+  *@file ldfgen.cpp
+  *@brief Synthetic HRIBF LDF file generator for DDAS (Pixie-16) list mode data
+  *@details
+  * Writes a DIR and HEAD buffer, the spills as DATA chunks split across 8194 word buffers with a
+  * spill footer each, and the double EOF, laid out the way LDFPixieTranslator expects them.
+  * Hit rate, module MSPS mix, trace length and the optional QDC/energy sum/external timestamp
+  * words are configurable, as is a fraction of hits that arrive one spill late and a fraction of
+  * spills with injected corruption. The same seed always produces the same file.
+  * A matching crate configuration file for ldf2root is written next to the output.
+  *@param output_file Path to the LDF file to write
+  *@param config_out Path to the ldf2root configuration file to write (optional, defaults to <output>_config.txt)
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "LDFGenerator.h"
+
+void PrintUsageString(std::ostream& os = std::cout) {
+  os << "Usage: ldfgen [options]\n";
+  os << "Options:\n";
+  os << "  --help, -h              Show this help message\n";
+  os << "  --output, -o <file>     Path to the LDF file to write (Required)\n";
+  os << "  --config-out <file>     Path of the matching ldf2root config file (default: <output>_config.txt)\n";
+  os << "  --spills <n>            Number of spills (default: 100)\n";
+  os << "  --size <MB>             Keep writing spills until the file has this size, overrides --spills\n";
+  os << "  --rate <hits/s>         Mean hit rate of all modules together (default: 1e5)\n";
+  os << "  --spill-duration <s>    Length of a spill (default: 0.1)\n";
+  os << "  --modules <n>           Number of modules, slots 2 to n+1 (default: 4, max: 13)\n";
+  os << "  --crate <n>             Crate ID (default: 0)\n";
+  os << "  --msps <list>           Comma separated module MSPS, cycled over the modules (100/250/500; default: 250)\n";
+  os << "  --trace-length <n>      Trace length in samples, rounded down to even (default: 0)\n";
+  os << "  --energy-sums           Add the 4 energy sum words to every hit\n";
+  os << "  --qdc-sums              Add the 8 QDC sum words to every hit\n";
+  os << "  --ext-ts                Add the 2 external timestamp words to every hit\n";
+  os << "  --out-of-order <f>      Fraction of hits delivered one spill late (default: 0)\n";
+  os << "  --corrupt <f>           Fraction of spills with a dropped chunk, a bad footer or an unknown buffer (default: 0)\n";
+  os << "  --seed <n>              Random seed (default: 1)\n";
+  os << "  --run <n>               Run number (default: 1)\n";
+}
+
+void parse_args(int argc, char* argv[], ldfgen::GenOptions& opts) {
+  if (argc < 2) {
+    PrintUsageString(std::cerr);
+    exit(0);
+  }
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") {
+      PrintUsageString();
+      exit(0);
+    } else if ((arg == "--output" || arg == "-o") && i + 1 < argc) {
+      opts.output_file = argv[++i];
+    } else if (arg == "--config-out" && i + 1 < argc) {
+      opts.config_out = argv[++i];
+    } else if (arg == "--spills" && i + 1 < argc) {
+      opts.spills = std::stoull(argv[++i]);
+    } else if (arg == "--size" && i + 1 < argc) {
+      opts.max_size_mb = std::stod(argv[++i]);
+    } else if (arg == "--rate" && i + 1 < argc) {
+      opts.rate = std::stod(argv[++i]);
+    } else if (arg == "--spill-duration" && i + 1 < argc) {
+      opts.spill_duration = std::stod(argv[++i]);
+    } else if (arg == "--modules" && i + 1 < argc) {
+      opts.modules = std::stoul(argv[++i]);
+    } else if (arg == "--crate" && i + 1 < argc) {
+      opts.crate = std::stoul(argv[++i]);
+    } else if (arg == "--msps" && i + 1 < argc) {
+      opts.msps.clear();
+      std::stringstream ss(argv[++i]);
+      std::string item;
+      while (std::getline(ss, item, ',')) {
+        opts.msps.push_back(std::stoul(item));
+      }
+    } else if (arg == "--trace-length" && i + 1 < argc) {
+      opts.trace_length = std::stoul(argv[++i]) & ~1u;
+    } else if (arg == "--energy-sums") {
+      opts.energy_sums = true;
+    } else if (arg == "--qdc-sums") {
+      opts.qdc_sums = true;
+    } else if (arg == "--ext-ts") {
+      opts.ext_ts = true;
+    } else if (arg == "--out-of-order" && i + 1 < argc) {
+      opts.out_of_order = std::stod(argv[++i]);
+    } else if (arg == "--corrupt" && i + 1 < argc) {
+      opts.corrupt = std::stod(argv[++i]);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      opts.seed = std::stoull(argv[++i]);
+    } else if (arg == "--run" && i + 1 < argc) {
+      opts.run_num = std::stoul(argv[++i]);
+    } else {
+      std::cerr << "Unknown option: " << arg << std::endl << std::endl;
+      PrintUsageString(std::cerr);
+      exit(1);
+    }
+  }
+
+  if (opts.output_file.empty()) {
+    std::cerr << "No output file specified." << std::endl;
+    PrintUsageString(std::cerr);
+    exit(1);
+  }
+  if (opts.modules < 1 || opts.modules > 13) {
+    std::cerr << "Number of modules must be between 1 and 13." << std::endl;
+    exit(1);
+  }
+  if (opts.crate > 15) {
+    std::cerr << "Crate ID must be between 0 and 15." << std::endl;
+    exit(1);
+  }
+  if (opts.msps.empty()) {
+    std::cerr << "No module MSPS given." << std::endl;
+    exit(1);
+  }
+  for (auto msps : opts.msps) {
+    if (msps != 100 && msps != 250 && msps != 500) {
+      std::cerr << "Invalid MSPS " << msps << ". Must be 100, 250 or 500." << std::endl;
+      exit(1);
+    }
+  }
+  if (opts.trace_length > 0x7FFF) {
+    std::cerr << "Trace length must be less than 32768 samples." << std::endl;
+    exit(1);
+  }
+  if (opts.out_of_order < 0.0 || opts.out_of_order > 1.0 || opts.corrupt < 0.0 || opts.corrupt > 1.0) {
+    std::cerr << "--out-of-order and --corrupt are fractions between 0 and 1." << std::endl;
+    exit(1);
+  }
+  opts.config_out = ldfgen::ConfigFilePath(opts);
+}
+
+int main(int argc, char* argv[]) {
+  ldfgen::GenOptions opts;
+  parse_args(argc, argv, opts);
+
+  ldfgen::GenStats stats;
+  try {
+    stats = ldfgen::GenerateFile(opts);
+  } catch (std::runtime_error const& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  std::cout << "Wrote " << opts.output_file << " : " << stats.spills << " spills, " << stats.hits << " hits (" << stats.late_hits << " late), "
+            << stats.corrupt_spills << " corrupted spills, " << stats.buffers << " buffers, "
+            << stats.bytes << " bytes" << std::endl;
+  std::cout << "Config file : " << opts.config_out << std::endl;
+  return 0;
+}